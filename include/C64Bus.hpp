@@ -2,51 +2,105 @@
 
 #include <cstdint>
 #include <vector>
-#include <fstream>
+#include <memory>
 #include <cia1.hpp>
 #include <cia2.hpp>
 #include <vic.hpp>
 #include <input.hpp>
 #include <sid.hpp>
 #include <bus.hpp>
+#include <cartridge.hpp>
+#include <metrics.hpp>
 
 class VIC;
 class CIA1;
 class CIA2;
 class Input;
 
-class C64Bus : public Bus {
+// BASIC, KERNAL and character ROM. Read only once built, every bus with the same images shares
+// one copy.
+struct C64Roms {
+    uint8_t basic[0x2000];
+    uint8_t kernal[0x2000];
+    uint8_t character[0x1000];
+
+    // the images compiled in from kernal.h and chrom.h, built once
+    static std::shared_ptr<const C64Roms> getBuiltIn();
+};
+
+class C64Bus final : public Bus {
 public:
     C64Bus();
     ~C64Bus();
 
-    void write(uint16_t addr, uint8_t data) override;
-    uint8_t read(uint16_t addr) override;
+    // RAM that no ROM, I/O or cartridge can cover is handled here so the CPU core inlines it,
+    // everything else goes through the banking in C64Bus.cpp
+    void write(uint16_t addr, uint8_t data) override {
+#ifndef NO_MMIO
+        if(addr < 0x0002 || (addr >= 0xD000 && addr < 0xE000)) {
+            writeBanked(addr, data);
+            return;
+        }
+#endif
+        counters.writes[METRICS_RAM]++;
+        ram[addr] = data;
+    }
+    uint8_t read(uint16_t addr) override {
+#ifndef NO_MMIO
+        if(addr < 0x0002 || addr >= 0xA000 || (addr >= 0x8000 && cartridge)) {
+            return readBanked(addr);
+        }
+#endif
+        counters.reads[METRICS_RAM]++;
+        return ram[addr];
+    }
+    // I/O reads as open bus
+    uint8_t peek(uint16_t addr) override;
+
+    // the CIAs, VIC, SID and input for one cycle, called by CPUCore<C64Bus>
+    static constexpr bool ticksChips = true;
+    void tickChips();
+
+    // memcpy while the whole range is RAM for the access, byte by byte otherwise
+    void writeBytes(uint16_t addr, const uint8_t* data, uint16_t size) override;
+    void readBytes(uint16_t addr, uint8_t* data, uint16_t size) override;
 
     uint8_t readCharRom(uint16_t addr);
 
     uint8_t handleIoRead(uint16_t addr);
     void handleIoWrite(uint16_t addr, uint8_t data);
 
+    // the load functions give this bus its own copy of the ROMs with the file read into it
     void loadC64rom(const char *filename);
     void loadCharacterRom(const char *filename);
-    void loadCartridge(const char *filename);
+    void setRoms(std::shared_ptr<const C64Roms> roms) { this->roms = roms; }
+    std::shared_ptr<const C64Roms> getRoms() const { return roms; }
+    // replaces any cartridge in the expansion port, the C64 needs a reset to start it
+    bool loadCartridge(const char *filename);
+    void removeCartridge();
+
+    // RAM, colour RAM and the processor port, the ROMs and the cartridge image are not
+    // state and the same cartridge has to be inserted when loading
+    void saveState(StateWriter& state) const;
+    void loadState(StateReader& state);
 
     uint8_t dataDirectionRegister;
     uint8_t dataRegister = 0b00000111;
 
-    CIA1 *cia1;
-    CIA2 *cia2;
-    VIC *vic;
-    SID *sid;
-    Input *input;
+    CIA1 *cia1 = nullptr;
+    CIA2 *cia2 = nullptr;
+    VIC *vic = nullptr;
+    SID *sid = nullptr;
+    Input *input = nullptr;
+    // every read and write by region, peeks are not counted
+    BusCounters counters;
 // private:
-    std::ofstream ramFile;
-    uint8_t ram[0xFFFF];
-    uint8_t basicRom[0x2000];
-    uint8_t kernalRom[0x2000];
-    uint8_t charRom[0x1000];
+    void writeBanked(uint16_t addr, uint8_t data);
+    uint8_t readBanked(uint16_t addr);
+    bool isRam(uint16_t addr, uint16_t size, bool write) const;
+
+    uint8_t ram[0x10000];
     uint8_t colorRam[0x0400];
-    uint8_t cartridge[0x8000];
-    bool cartridgeLoaded = false;
+    std::shared_ptr<const C64Roms> roms;
+    Cartridge *cartridge = nullptr;
 };
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// the chips of a machine that live in a MachineArena, one region each
+#define ARENA_BUS 0
+#define ARENA_CPU 1
+#define ARENA_CIA1 2
+#define ARENA_CIA2 3
+#define ARENA_VIC 4
+#define ARENA_SID 5
+#define ARENA_INPUT 6
+#define ARENA_SERIAL_BUS 7
+#define ARENA_FLOPPY 8
+#define ARENA_REGIONS 9
+
+// slots start on a cache line so no two instances share one
+#define ARENA_ALIGNMENT 64
+
+// Memory for many machines in one allocation. Each region is an array with one slot per
+// instance, so RAM sits next to RAM and the CIAs of all instances next to each other. A System
+// built on an arena constructs its chips in its slots, the ROMs are shared and not in it. The
+// arena has to outlive its Systems.
+class MachineArena {
+public:
+    MachineArena(size_t instances);
+    ~MachineArena();
+
+    MachineArena(const MachineArena&) = delete;
+    MachineArena& operator=(const MachineArena&) = delete;
+
+    // uninitialised storage for the chip of one instance
+    void* get(int region, size_t instance) {
+        return memory + offsets[region] + instance * slotSizes[region];
+    }
+
+    size_t getInstances() const { return instances; }
+    size_t getBytes() const { return bytes; }
+
+private:
+    size_t instances;
+    size_t bytes = 0;
+    size_t offsets[ARENA_REGIONS];
+    size_t slotSizes[ARENA_REGIONS];
+    uint8_t* memory;
+};
@@ -8,15 +8,22 @@ public:
 
     }
     
-    ~Bus() {
+    virtual ~Bus() {
 
     }
 
     virtual void write(uint16_t addr, uint8_t data) = 0;
     virtual uint8_t read(uint16_t addr) = 0;
+    // a read without side effects on the chips, for tracing and debugging
+    virtual uint8_t peek(uint16_t addr) { return read(addr); }
 
     void writeWord(uint16_t addr, uint16_t data);
     uint16_t readWord(uint16_t addr);
 
-    void writeBytes(uint16_t addr, const uint8_t *data, uint16_t size);
+    // block copies, a bus can override them with a memcpy where the range is plain memory
+    virtual void writeBytes(uint16_t addr, const uint8_t *data, uint16_t size);
+    virtual void readBytes(uint16_t addr, uint8_t *data, uint16_t size);
+
+    // a bus type that sets this has a tickChips the CPU core calls on every cycle
+    static constexpr bool ticksChips = false;
 };
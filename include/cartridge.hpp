@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mapped_file.hpp>
+#include <state.hpp>
+#include <string>
+#include <vector>
+
+// CRT hardware types
+#define CRT_NORMAL 0
+#define CRT_OCEAN 5
+#define CRT_MAGIC_DESK 19
+#define CRT_EASYFLASH 32
+
+#define CRT_HEADER_SIGNATURE "C64 CARTRIDGE   "
+#define CRT_CHIP_SIGNATURE "CHIP"
+#define CRT_CHIP_HEADER_LENGTH 0x10
+
+#define CARTRIDGE_BANK_SIZE 0x2000
+
+// A cartridge on the expansion port. The ROM banks point straight into the
+// memory mapped CRT file, a bank switch only swaps the romL and romH
+// pointers. Mappers override the IO1 ($DE00) and IO2 ($DF00) handlers.
+class Cartridge {
+public:
+    // creates the mapper for the hardware type of the CRT, nullptr on error
+    static Cartridge* load(const std::string& path);
+
+    virtual ~Cartridge() {}
+
+    virtual void reset();
+
+    // the lines and the selected bank, the ROM comes from the CRT file
+    virtual void saveState(StateWriter& state) const;
+    virtual void loadState(StateReader& state);
+
+    virtual uint8_t readIO1(uint16_t addr) { return 0; }
+    virtual void writeIO1(uint16_t addr, uint8_t data) {}
+    virtual uint8_t readIO2(uint16_t addr) { return 0; }
+    virtual void writeIO2(uint16_t addr, uint8_t data) {}
+
+    // the ROM byte seen at $8000-$FFFF for the processor port LORAM/HIRAM bits, nullptr
+    // where the C64 sees its own memory
+    const uint8_t* map(uint16_t addr, uint8_t port) const {
+        if(gameActive && !exromActive) {
+            // ultimax, ROMH replaces the KERNAL whatever the processor port says
+            if(addr < 0xA000) {
+                return romL ? romL + (addr & 0x1FFF) : nullptr;
+            }
+            return addr >= 0xE000 && romH ? romH + (addr & 0x1FFF) : nullptr;
+        }
+        if(!exromActive || !(port & 0b010)) {
+            return nullptr;
+        }
+        if(addr < 0xA000) {
+            return (port & 0b001) && romL ? romL + (addr & 0x1FFF) : nullptr;
+        }
+        return addr < 0xC000 && gameActive && romH ? romH + (addr & 0x1FFF) : nullptr;
+    }
+
+    uint16_t getType() const { return type; }
+    const std::string& getName() const { return name; }
+    const std::string& getPath() const { return path; }
+    size_t getBankCount() const { return lowBanks.size(); }
+
+    // the EXROM and GAME lines, true while pulled low
+    bool exromActive = false;
+    bool gameActive = false;
+
+    // banks at $8000 and at $A000 or $E000
+    const uint8_t* romL = nullptr;
+    const uint8_t* romH = nullptr;
+    size_t bank = 0;
+
+protected:
+    bool open(const std::string& path);
+    virtual void selectBank(size_t bank);
+
+    uint16_t type = CRT_NORMAL;
+    std::string name;
+    std::string path;
+    // lines from the CRT header
+    bool initialExrom = false;
+    bool initialGame = false;
+
+    std::vector<const uint8_t*> lowBanks;
+    std::vector<const uint8_t*> highBanks;
+
+private:
+    MappedFile file;
+    // chips smaller than a bank are mirrored into their own copy
+    std::vector<std::unique_ptr<uint8_t[]>> mirroredChips;
+};
+
+// 8K, 16K and ultimax cartridges without bank switching
+class NormalCartridge : public Cartridge {};
+
+// $DE00 selects one of up to 64 banks for both ROM areas
+class OceanCartridge : public Cartridge {
+public:
+    void writeIO1(uint16_t addr, uint8_t data) override;
+
+protected:
+    void selectBank(size_t bank) override;
+};
+
+// $DE00 selects one of up to 128 8K banks, bit 7 disables the cartridge
+class MagicDeskCartridge : public Cartridge {
+public:
+    void writeIO1(uint16_t addr, uint8_t data) override;
+};
+
+// $DE00 selects the bank, $DE02 drives EXROM and GAME and $DF00-$DFFF is RAM.
+// The flash chips are read only.
+class EasyFlashCartridge : public Cartridge {
+public:
+    void reset() override;
+    void saveState(StateWriter& state) const override;
+    void loadState(StateReader& state) override;
+    uint8_t readIO2(uint16_t addr) override { return ram[addr & 0xFF]; }
+    void writeIO1(uint16_t addr, uint8_t data) override;
+    void writeIO2(uint16_t addr, uint8_t data) override { ram[addr & 0xFF] = data; }
+
+private:
+    void setControl(uint8_t data);
+
+    uint8_t ram[0x100];
+};
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cia_timer.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <state.hpp>
+
+#define PORTA 0
+#define PORTB 1
+#define DIRECTION_REGISTER_A 2
+#define DIRECTION_REGISTER_B 3
+#define TIMER_A_LOW 4
+#define TIMER_A_HIGH 5
+#define TIMER_B_LOW 6
+#define TIMER_B_HIGH 7
+#define TIME_OF_DAY_TENTHS 8
+#define TIME_OF_DAY_SECONDS 9
+#define TIME_OF_DAY_MINUTES 10
+#define TIME_OF_DAY_HOURS 11
+#define SERIAL_SHIFT_REGISTER 12
+#define INTERRUPT_CONTROL_REGISTER 13
+#define TIMER_A_CONTROL_REGISTER 14
+#define TIMER_B_CONTROL_REGISTER 15
+
+// interrupt control register bits
+#define CIA_INTERRUPT_TIMER_A 0x01
+#define CIA_INTERRUPT_TIMER_B 0x02
+#define CIA_INTERRUPT_ALARM 0x04
+#define CIA_INTERRUPT_SERIAL 0x08
+#define CIA_INTERRUPT_FLAG 0x10
+
+class CPU;
+
+// time of day values are kept in BCD like the registers
+struct CIATimeOfDay {
+    uint8_t tenths;
+    uint8_t seconds;
+    uint8_t minutes;
+    uint8_t hours; // bit 7 is PM
+};
+
+// MOS 6526 core shared by CIA1 and CIA2. The subclasses connect the ports and
+// the interrupt output to the rest of the machine.
+class CIA {
+public:
+    CIA();
+    virtual ~CIA();
+
+    void write(uint16_t addr, uint8_t data);
+    uint8_t read(uint16_t addr);
+
+    void setCpu(CPU* cpu) { this->cpu = cpu; }
+
+    void tick();
+
+    void saveState(StateWriter& state) const;
+    void loadState(StateReader& state);
+
+    // an external device clocks a bit into the serial port on a rising CNT edge
+    void serialInput(bool bit);
+    // negative edge on the FLAG pin
+    void triggerFlag();
+
+protected:
+    virtual uint8_t portAInput() { return 0xFF; }
+    virtual uint8_t portBInput() { return 0xFF; }
+    virtual void portAChanged(uint8_t pins) {}
+    virtual void portBChanged(uint8_t pins) {}
+    virtual void serialOutput(bool bit) {}
+    // the interrupt output, asserted when an unmasked source fires and released when the
+    // interrupt control register is read
+    virtual void interruptOutput(bool asserted) = 0;
+
+    uint8_t portAPins() const { return registers[PORTA] | ~registers[DIRECTION_REGISTER_A]; }
+    uint8_t portBPins() const { return registers[PORTB] | ~registers[DIRECTION_REGISTER_B]; }
+
+    CPU* cpu = nullptr;
+    uint8_t registers[0x10];
+
+private:
+    void handleEvents(size_t cycle);
+    void updateNextEvent();
+    void writeControlA(uint8_t data, size_t cycle);
+    void writeControlB(uint8_t data, size_t cycle);
+    void timerAUnderflow();
+    void timerBUnderflow();
+    void shiftSerialOut();
+    void setInterrupt(uint8_t source);
+    void advanceTimeOfDay();
+    void checkAlarm();
+    size_t todPeriod() const;
+
+    CIATimer timerA;
+    CIATimer timerB;
+    bool pb6Toggle = false;
+    bool pb7Toggle = false;
+
+    uint8_t interruptData = 0;
+    uint8_t interruptMask = 0;
+
+    CIATimeOfDay tod = {0, 0, 0, 0x01};
+    CIATimeOfDay alarm = {0, 0, 0, 0};
+    CIATimeOfDay todLatch = {};
+    bool todLatched = false;
+    bool todHalted = false;
+    size_t nextTodCycle;
+
+    uint8_t shiftRegister = 0;
+    uint8_t shiftCount = 0; // remaining CNT half periods while shifting out, bits while shifting in
+    bool serialPending = false;
+    bool cntLevel = true;
+
+    size_t nextEventCycle;
+};
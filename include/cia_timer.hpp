@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#define CIA_NEVER SIZE_MAX
+
+// the TOD pin is fed from the 50Hz mains, one pulse per PAL frame
+#define CIA_TOD_PULSE_CYCLES (63 * 312)
+
+// A CIA interval timer that is not decremented every cycle. It remembers the
+// counter value at baseCycle and computes the current count and the next
+// underflow from the cycle counter when they are needed.
+struct CIATimer {
+    uint16_t latch = 0xFFFF;
+    uint16_t counter = 0xFFFF; // counter value at baseCycle
+    size_t baseCycle = 0;
+    bool running = false;
+    bool oneShot = false;
+    // false when the timer counts CNT edges or timer A underflows instead of cycles
+    bool countsCycles = true;
+
+    uint16_t read(size_t cycle) const {
+        if(!running || !countsCycles || cycle <= baseCycle) return counter;
+        size_t elapsed = cycle - baseCycle;
+        if(elapsed <= counter) return counter - elapsed;
+        if(oneShot) return latch;
+        elapsed -= counter + 1;
+        return latch - (elapsed % (static_cast<size_t>(latch) + 1));
+    }
+
+    // the counter counts down to zero and underflows on the following cycle
+    size_t nextUnderflow() const {
+        return running && countsCycles ? baseCycle + counter + 1 : CIA_NEVER;
+    }
+
+    // counts one external pulse, returns true when the timer underflowed
+    bool countPulse() {
+        if(!running) return false;
+        if(counter == 0) {
+            counter = latch;
+            if(oneShot) {
+                running = false;
+            }
+            return true;
+        }
+        counter--;
+        return false;
+    }
+
+    void load(size_t cycle) {
+        counter = latch;
+        baseCycle = cycle;
+    }
+
+    void start(size_t cycle) {
+        if(running) return;
+        baseCycle = cycle;
+        running = true;
+    }
+
+    void stop(size_t cycle) {
+        if(!running) return;
+        counter = read(cycle);
+        baseCycle = cycle;
+        running = false;
+    }
+
+    void underflow(size_t cycle) {
+        load(cycle);
+        if(oneShot) {
+            running = false;
+        }
+    }
+};
@@ -3,9 +3,13 @@
 #include <cstdint>
 #include <cstddef>
 #include <bus.hpp>
+#include <profiler.hpp>
+#include <state.hpp>
+#include <string>
+#include <trace.hpp>
 #include <array>
 #include <functional>
-#include <tuple>
+#include <unordered_map>
 // https://www.nesdev.org/6502_cpu.txt
 // https://www.oxyron.de/html/opcodes02.html
 // https://www.nesdev.org/wiki/Instruction_reference
@@ -43,15 +47,43 @@ enum class AddressingMode {
 #define OVERFLOW_FLAG 0b01000000
 #define NEGATIVE_FLAG 0b10000000
 
+// sources on the wired-OR interrupt lines, each drives its own bit
+#define IRQ_CIA1 0x01
+#define IRQ_VIC 0x02
+#define IRQ_CARTRIDGE 0x04
+#define IRQ_VIA1 0x08
+#define IRQ_VIA2 0x10
+#define NMI_CIA2 0x01
+#define NMI_RESTORE 0x02
+#define NMI_CARTRIDGE 0x04
+
+// The registers, interrupt lines and everything around the instructions. The instructions
+// themselves are in CPUCore, which knows the concrete type of the bus.
 class CPU {
 public:
     CPU(Bus* bus);
-    ~CPU();
-    
+    virtual ~CPU();
+
     void powerOn();
     void reset();
 
-    void executeOnce();
+    // registers, the cycle counter and the interrupt lines, traps and callbacks are not state
+    void saveState(StateWriter& state) const;
+    void loadState(StateReader& state);
+
+    // runs one instruction, or in the cycle stepped core the bus cycles up to the next
+    // instruction boundary
+    virtual void executeOnce() = 0;
+
+    // executes every instruction as a sequence of single bus cycles instead of all at once,
+    // slower but every read and write lands on its exact cycle. only switch between instructions
+    void setCycleStepped(bool enabled);
+    bool isCycleStepped() const { return cycleStepped; }
+    // advances the cycle stepped core by one bus cycle
+    virtual void tick() = 0;
+    // the RDY line, while it is low the cycle stepped core stalls on read cycles. the instruction
+    // stepped core ignores it
+    void setReady(bool ready) { this->ready = ready; }
 
     Bus* bus;
 
@@ -63,39 +95,145 @@ public:
 
     uint16_t PC;
 
-    size_t cycles;
-
-    uint8_t fetch();
-    uint16_t fetchWord();
-    uint16_t getAddress(AddressingMode mode, bool alwaysCrossPage = false);
+    size_t cycles = 0;
+    // for metrics, not machine state
+    uint64_t instructionCount = 0;
+    uint64_t irqCount = 0;
+    uint64_t nmiCount = 0;
 
     uint8_t getCurrentOpcode() const {
         return currentOpcode;
     }
 
-    void pushByte(uint8_t data);
-    void pushWord(uint16_t data);
-
-    void triggerIRQ();
-    void triggerNMI();
+    // IRQ is level triggered and taken while any source holds it and the I flag is clear. NMI
+    // is edge triggered, it fires once when the first source pulls the line
+    void setIRQ(uint8_t source, bool asserted) {
+        irqLines = asserted ? irqLines | source : irqLines & ~source;
+    }
+    void setNMI(uint8_t source, bool asserted) {
+        uint8_t lines = asserted ? nmiLines | source : nmiLines & ~source;
+        if(lines && !nmiLines) {
+            nmiPending = true;
+        }
+        nmiLines = lines;
+    }
+    // the SO pin, the 1541 uses it to signal that a byte was read from the disk
+    void setOverflow() {
+        P |= OVERFLOW_FLAG;
+    }
 
-    uint8_t popByte();
-    uint16_t popWord();
-    void stepCycles(size_t cycles);
+    // advances the cycle counter one cycle at a time so the chips see every cycle
+    virtual void stepCycles(size_t cycles) = 0;
     void stallCycles(size_t cycles);
 
+    static const char* getInstructionName(uint8_t opcode);
+
+    // records every instruction to a binary trace file, see trace.hpp
+    bool startTrace(const std::string& path);
+    void stopTrace();
+
+    // counts cycles per PC and call stack while set, the profiler is not owned
+    void setProfiler(Profiler* profiler) { this->profiler = profiler; }
+
+    // runs on every cycle, instead of the chips a C64Bus ticks itself while none is set
     void setCycleCallback(std::function<void()> callback) {
         cycleCallback = callback;
     }
 
-private:
+    // runs the handler instead of the instruction at addr, a handler that returns false lets
+    // the instruction execute normally
+    void setTrap(uint16_t addr, std::function<bool()> handler) {
+        traps[addr] = handler;
+    }
+    void clearTrap(uint16_t addr) {
+        traps.erase(addr);
+    }
+
+protected:
     size_t lastCycles;
     uint8_t currentOpcode;
 
-    std::array<std::tuple<std::function<void(CPU *, AddressingMode)>, AddressingMode>, 256> instructions;
+    // 256 entries, shared by every instance
+    const AddressingMode* addressingModes;
 
     std::function<void()> cycleCallback;
+    std::unordered_map<uint16_t, std::function<bool()>> traps;
+    TraceWriter* trace = nullptr;
+    Profiler* profiler = nullptr;
 
-    bool irqPending = false;
+    uint8_t irqLines = 0;
+    uint8_t nmiLines = 0;
+    // the NMI edge, latched until the interrupt is taken
     bool nmiPending = false;
+
+    // cycle stepped core, see cpu_cycle.cpp
+    void finishInstruction();
+    bool cycleStepped = false;
+    bool ready = true;
+    // micro ops of the current instruction, null between instructions
+    const uint8_t* microOps = nullptr;
+    uint8_t operation;
+    uint16_t address;
+    uint8_t pointer;
+    uint8_t data;
+    bool pageCrossed;
+    bool nmiSampled = false;
+    bool irqSampled = false;
+    // set while the micro ops are an interrupt sequence instead of an instruction
+    bool interrupting = false;
+    bool interruptIsNmi;
+    // where the current instruction started, for the profiler in both cores
+    uint16_t instructionPc;
+    uint8_t instructionSp;
+    size_t instructionStart;
 };
+
+// The instructions for one bus type. Every access goes straight to BusType, so on a final bus
+// like C64Bus they are not virtual calls and the common cases inline. CPUCore<Bus> is for any
+// other bus, built for Bus, C64Bus and FlatBus in cpu.cpp.
+template<typename BusType>
+class CPUCore final : public CPU {
+public:
+    using Instruction = void (*)(CPUCore*, AddressingMode);
+
+    CPUCore(BusType* bus);
+
+    void executeOnce() override;
+    void tick() override;
+    void stepCycles(size_t cycles) override;
+
+    // CPU::bus as its concrete type
+    BusType* typedBus;
+
+    uint8_t fetch();
+    uint16_t fetchWord();
+    uint16_t getAddress(AddressingMode mode, bool alwaysCrossPage = false);
+
+    void pushByte(uint8_t data);
+    void pushWord(uint16_t data);
+    uint8_t popByte();
+    uint16_t popWord();
+
+private:
+    void startInstruction();
+
+    // 256 entries, shared by every instance
+    const Instruction* instructions;
+};
+
+template<typename BusType>
+inline void CPUCore<BusType>::stepCycles(size_t cycles) {
+    for(size_t i = 0; i < cycles; i++) {
+        this->cycles++;
+        // a bus that knows its chips calls them directly unless the callback takes over
+        if constexpr(BusType::ticksChips) {
+            if(!cycleCallback) {
+                typedBus->tickChips();
+                continue;
+            }
+        }
+        if(cycleCallback) {
+            cycleCallback();
+        }
+    }
+}
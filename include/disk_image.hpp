@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mapped_file.hpp>
+#include <string>
+#include <vector>
+
+#define D64_SECTOR_SIZE 256
+#define D64_SIZE 174848 // 35 tracks
+#define D64_SIZE_ERRORS 175531 // 35 tracks with one error byte per sector
+#define D64_40_TRACK_SIZE 196608
+#define D64_40_TRACK_SIZE_ERRORS 197376
+#define D64_MAX_TRACKS 42
+#define DISK_HALF_TRACKS (D64_MAX_TRACKS * 2)
+
+// A D64 or G64 disk image. D64 images are GCR encoded one track at a time
+// when the drive head first reaches them, G64 images are used as they are. Every drive opens
+// its own instance, only the untouched pages of the mapped file are shared between them.
+class DiskImage {
+public:
+    DiskImage();
+    ~DiskImage();
+
+    bool open(const std::string& path);
+    // writes the image including all sector writes back to a file
+    bool save(const std::string& path) const;
+
+    bool isG64() const { return g64; }
+    int getTrackCount() const { return tracks; }
+
+    // the 1541 packs more sectors on the longer outer tracks
+    static int sectorsPerTrack(int track);
+    // speed zone 3 is the outermost and fastest, 0 the innermost
+    static int speedZone(int track);
+
+    bool readSector(int track, int sector, uint8_t* data);
+    bool writeSector(int track, int sector, const uint8_t* data);
+
+    // GCR bytes passing under the head on a half track, track 1 is half track 2. Returns
+    // nullptr for an unformatted half track. The pointer stays valid while the image is open.
+    const uint8_t* getTrack(int halfTrack, size_t& length);
+
+private:
+    size_t sectorOffset(int track, int sector) const;
+    void encodeTrack(int track);
+
+    MappedFile file;
+    bool g64 = false;
+    int tracks = 0;
+
+    // D64 only, filled on demand, up to 7.7K per track the head has reached
+    std::vector<uint8_t> gcrTracks[D64_MAX_TRACKS];
+};
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <bus.hpp>
+#include <cpu.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <disk_image.hpp>
+#include <serial_device.hpp>
+#include <string>
+#include <via.hpp>
+
+// the drive keeps running this long after the last bus activity before it is
+// put to sleep, long enough for DOS to finish its reset and any command
+#define DRIVE_IDLE_CYCLES 2000000
+
+class Drive1541;
+
+// VIA1 at $1800 connects the IEC bus
+class DriveVIA1 : public VIA {
+public:
+    DriveVIA1(Drive1541* drive) : drive(drive) {}
+
+protected:
+    uint8_t portBInput() override;
+    void portBChanged(uint8_t pins) override;
+
+private:
+    Drive1541* drive;
+};
+
+// VIA2 at $1C00 controls the head, the stepper motor and the spindle
+class DriveVIA2 : public VIA {
+public:
+    DriveVIA2(Drive1541* drive) : drive(drive) {}
+
+protected:
+    uint8_t portAInput() override;
+    uint8_t portBInput() override;
+    void portBChanged(uint8_t pins) override;
+
+private:
+    Drive1541* drive;
+};
+
+class DriveBus : public Bus {
+public:
+    DriveBus(Drive1541* drive);
+
+    void write(uint16_t addr, uint8_t data) override;
+    uint8_t read(uint16_t addr) override;
+
+    uint8_t ram[0x800];
+    uint8_t rom[0x4000];
+
+private:
+    Drive1541* drive;
+};
+
+// A 1541 running its own DOS on a second CPU. The drive is clocked from the
+// C64 cycle callback and only executes while it has something to do.
+class Drive1541 : public SerialDevice {
+public:
+    Drive1541(SerialBus* bus);
+    ~Drive1541();
+
+    // loads an 8K half of the ROM at $C000 or $E000, or the whole 16K at $C000. The 1541 ROM is
+    // 325302-01 at $C000 and 901229-05 at $E000, VICE ships both together as dos1541.
+    bool loadRom(const std::string& path, uint16_t address = 0xC000);
+    bool loadRom(const uint8_t* data, size_t size, uint16_t address = 0xC000);
+    bool isRomComplete() const { return romHalves == 0b11; }
+
+    void powerOn();
+    void reset();
+
+    // the image is not owned by the drive and can be shared between drives
+    void insertDisk(DiskImage* disk);
+    void ejectDisk();
+    DiskImage* getDisk() const { return disk; }
+
+    // called once per C64 cycle
+    void clock();
+    bool isActive() const;
+
+    SerialPortState getIndividualState() override;
+    void tick() override;
+
+    // the drive CPU, RAM and VIAs and the head position, the disk contents are not state
+    void saveState(StateWriter& state) const override;
+    void loadState(StateReader& state) override;
+
+    bool isMotorOn() const { return motorOn; }
+    bool isLedOn() const { return ledOn; }
+    // half track position of the head, track 18 is 36
+    uint8_t getHalfTrack() const { return halfTrack; }
+
+    CPU* cpu;
+    DriveBus* driveBus;
+    DriveVIA1* via1;
+    DriveVIA2* via2;
+
+private:
+    friend class DriveVIA1;
+    friend class DriveVIA2;
+
+    void updateIec(uint8_t pins);
+    void updateDiskController(uint8_t pins);
+    void loadTrack();
+    void rotateDisk();
+
+    uint8_t romHalves = 0;
+
+    size_t cycle = 0;
+    size_t idleCycles = 0;
+
+    bool atnAsserted = false;
+    bool atnAcknowledge = false;
+    bool dataOut = false;
+    bool clockOut = false;
+
+    bool motorOn = false;
+    bool ledOn = false;
+    uint8_t stepperPhase = 0;
+    uint8_t halfTrack = 36;
+    uint8_t density = 0;
+
+    DiskImage* disk = nullptr;
+    const uint8_t* trackData = nullptr;
+    size_t trackLength = 0;
+    size_t headPosition = 0;
+    int byteCycles = 0;
+    uint8_t lastByte = 0;
+    uint8_t readLatch = 0;
+    bool sync = false;
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <bus.hpp>
+#include <cstdint>
+#include <cstring>
+
+// 64K of RAM and nothing else, for running the CPU on its own in tests and benchmarks
+class FlatBus final : public Bus {
+public:
+    void write(uint16_t addr, uint8_t data) override { ram[addr] = data; }
+    uint8_t read(uint16_t addr) override { return ram[addr]; }
+
+    void writeBytes(uint16_t addr, const uint8_t* data, uint16_t size) override {
+        if(addr + size > 0x10000) {
+            Bus::writeBytes(addr, data, size);
+            return;
+        }
+        memcpy(ram + addr, data, size);
+    }
+    void readBytes(uint16_t addr, uint8_t* data, uint16_t size) override {
+        if(addr + size > 0x10000) {
+            Bus::readBytes(addr, data, size);
+            return;
+        }
+        memcpy(data, ram + addr, size);
+    }
+
+    uint8_t ram[0x10000] = {};
+};
@@ -3,7 +3,6 @@
 #include <cstdint>
 #include <serial_device.hpp>
 #include <chrono>
-#include <fstream>
 
 class Floppy : public SerialDevice {
 public:
@@ -12,14 +11,15 @@ public:
     SerialPortState getIndividualState() override;
 
     void tick() override;
+
+    void saveState(StateWriter& state) const override;
+    void loadState(StateReader& state) override;
 private:
     bool byteTransferInitiated = false;
     bool byteTransferComplete = false;
     bool lastClockLine = false;
     uint8_t bitTransfered = 0;
 
-    std::ofstream loggingFile;
-
     void shiftBit(bool bit);
     // chrono time point
     // std::chrono::time_point<std::chrono::high_resolution_clock> startTime;
@@ -1,17 +1,21 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
 #include <cstddef>
+#include <deque>
+#include <functional>
+#include <map>
 #include <string>
 #include <vector>
-#include <unordered_map>
-#include <unordered_set>
 #include <C64Bus.hpp>
-#include <thread>
 #include <mutex>
+#include <state.hpp>
 
 class C64Bus;
+class CPU;
 
+// key names in the order of the Key enum
 const std::vector<std::string> keys = {
     "STOP", "Q", "C=", "SPACE", "2", "CTRL", "<-", "1",
     "/", "^", "=", "RSHIFT", "HOME", ";", "*", "£",
@@ -20,28 +24,148 @@ const std::vector<std::string> keys = {
     "V", "U", "H", "B", "8", "G", "Y", "7",
     "X", "T", "F", "C", "6", "D", "R", "5",
     "LSHIFT", "E", "S", "Z", "4", "A", "W", "3",
-    "DOWN", "F5", "F3", "F1", "F7", "RIGHT", "RETURN", "DELETE"
+    "DOWN", "F5", "F3", "F1", "F7", "RIGHT", "RETURN", "DELETE",
+    "RESTORE"
 };
 
-// Only supports the keyboard right now
+// Keys numbered like the names above. The matrix position of key k is row
+// 7 - k / 8 (the CIA1 port A line) and column 7 - k % 8 (the port B line).
+// RESTORE is not in the matrix, it pulls NMI.
+enum class Key : uint8_t {
+    STOP, Q, COMMODORE, SPACE, NUM_2, CTRL, LEFT_ARROW, NUM_1,
+    SLASH, UP_ARROW, EQUALS, RSHIFT, HOME, SEMICOLON, ASTERISK, POUND,
+    COMMA, AT, COLON, PERIOD, MINUS, L, P, PLUS,
+    N, O, K, M, NUM_0, J, I, NUM_9,
+    V, U, H, B, NUM_8, G, Y, NUM_7,
+    X, T, F, C, NUM_6, D, R, NUM_5,
+    LSHIFT, E, S, Z, NUM_4, A, W, NUM_3,
+    DOWN, F5, F3, F1, F7, RIGHT, RETURN, DELETE,
+    RESTORE,
+    COUNT
+};
+
+// KERNAL keyboard buffer, its length and its size
+#define KEYBOARD_BUFFER 631
+#define KEYBOARD_BUFFER_LENGTH 198
+#define KEYBOARD_BUFFER_SIZE 10
+
+// how often queued text checks whether the KERNAL emptied the keyboard buffer
+#define INPUT_TEXT_POLL_CYCLES 1000
+
+// events without a cycle are applied on the next cycle after they are received
+#define INPUT_IMMEDIATE 0
+
+// joystick lines, the 1351 mouse puts its buttons on FIRE (left) and UP (right) and
+// paddles put theirs on LEFT (paddle X) and RIGHT (paddle Y)
+#define JOYSTICK_UP 0x01
+#define JOYSTICK_DOWN 0x02
+#define JOYSTICK_LEFT 0x04
+#define JOYSTICK_RIGHT 0x08
+#define JOYSTICK_FIRE 0x10
+
+#define NO_MOUSE 0
+
+enum class InputEventType {
+    KEY_DOWN,
+    KEY_UP,
+    TEXT,
+    JOYSTICK,
+    PADDLE,
+    MOUSE_MOVE
+};
+
+struct InputEvent {
+    size_t cycle;
+    InputEventType type;
+    Key key;
+    std::string text;
+    // control port 1 or 2, the joystick bits held down, or the paddle and its position
+    uint8_t port = 0;
+    uint8_t value = 0;
+    uint8_t paddle = 0;
+    // mouse movement
+    int16_t dx = 0;
+    int16_t dy = 0;
+};
+
+// Keyboard and control port input as a queue of events stamped with the emulated cycle they
+// happen on. Any thread may post events, they are only applied by the
+// emulation thread, so a run with the same events is reproducible.
 class Input {
 public:
     Input(C64Bus* bus);
     ~Input();
 
+    void setCpu(CPU* cpu) { this->cpu = cpu; }
+
+    void keyDown(Key key, size_t cycle = INPUT_IMMEDIATE);
+    void keyUp(Key key, size_t cycle = INPUT_IMMEDIATE);
+    void keyDown(const std::string& key, size_t cycle = INPUT_IMMEDIATE);
+    void keyUp(const std::string& key, size_t cycle = INPUT_IMMEDIATE);
+    // typed through the keyboard buffer whenever the KERNAL has emptied it
+    void typeText(const std::string& text, size_t cycle = INPUT_IMMEDIATE);
+    // all JOYSTICK_ bits that are held down on the port
+    void setJoystick(uint8_t port, uint8_t bits, size_t cycle = INPUT_IMMEDIATE);
+    // paddle 0 reads as POTX and paddle 1 as POTY
+    void setPaddle(uint8_t port, uint8_t paddle, uint8_t position, size_t cycle = INPUT_IMMEDIATE);
+    void moveMouse(int16_t dx, int16_t dy, size_t cycle = INPUT_IMMEDIATE);
+    // port of the 1351 mouse or NO_MOUSE, the mouse replaces the paddles on that port
+    void connectMouse(uint8_t port) { mousePort = port; }
+    void post(const InputEvent& event);
+
     void setKeyPressed(std::string key, bool pressed);
     void writeString(std::string str);
 
-    uint8_t readKeyMatrix(uint8_t row);
+    // called every cycle from the emulation thread
+    void tick();
+
+    // called for every event when it is applied, with the cycle it was applied on
+    void setEventCallback(std::function<void(const InputEvent&)> callback) {
+        eventCallback = callback;
+    }
+
+    // what is held down and text still waiting for the keyboard buffer. Events that were
+    // posted but not applied yet are not state, loading drops them.
+    void saveState(StateWriter& state) const;
+    void loadState(StateReader& state);
+
+    // port B value for the rows selected low in port A
+    uint8_t readKeyMatrix(uint8_t row) const { return matrixCache[row]; }
+    // active low like the port lines
+    uint8_t readJoystick(uint8_t port) const { return ~joysticks[(port - 1) & 1]; }
+    void selectPotPort(uint8_t select) { potSelect = select & 0x03; }
+    uint8_t readPot(uint8_t axis) const;
 
 private:
+    void handleEvents(size_t cycle);
+    void drainInbox(size_t cycle);
+    void updateNextEvent(size_t cycle);
+    void typeBufferedText();
+    void setKey(Key key, bool pressed);
+    void updateMatrixCache();
+
     C64Bus* bus;
-    uint8_t keyMatrix[8];
-    std::thread writeThread;
-    std::mutex writeMutex;
-    bool stopThread = false;
-    void writeStringInternal(std::string str);
-    void startWriteStringThread(std::string str);
-    void stopWriteStringThread();
-    std::unordered_set<std::string> pressedKeys;
+    CPU* cpu = nullptr;
+    std::function<void(const InputEvent&)> eventCallback;
+
+    // filled by other threads
+    std::vector<InputEvent> inbox;
+    std::mutex inboxMutex;
+    std::atomic<bool> inboxPending{false};
+
+    // ordered by cycle, events on the same cycle keep the order they were posted in
+    std::multimap<size_t, InputEvent> events;
+    std::deque<uint8_t> pendingText;
+    size_t nextEventCycle = SIZE_MAX;
+
+    // bit row * 8 + column is set while the key is down
+    uint64_t keyMatrix = 0;
+    uint8_t matrixCache[256];
+
+    uint8_t joysticks[2] = {0, 0};
+    uint8_t paddles[2][2] = {{0xFF, 0xFF}, {0xFF, 0xFF}};
+    uint8_t mousePort = NO_MOUSE;
+    uint16_t mouseX = 0;
+    uint16_t mouseY = 0;
+    uint8_t potSelect = 0;
 };
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define LZ4_MIN_MATCH 4
+#define LZ4_MAX_DISTANCE 0xFFFF
+#define LZ4_HASH_BITS 12
+
+// LZ4 style block compression: sequences of a token, literals, a 16-bit match offset and
+// the match length, without the LZ4 frame format around them. Fast enough to run on a
+// snapshot every frame, and long runs of equal bytes become a handful of bytes.
+namespace lz4 {
+
+// appends the compressed block to output
+void compress(const uint8_t* input, size_t size, std::vector<uint8_t>& output);
+
+// false when the block is corrupt or does not decompress to exactly size bytes
+bool decompress(const uint8_t* input, size_t inputSize, uint8_t* output, size_t size);
+
+} // namespace lz4
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// A file mapped into memory copy-on-write. Writes through data() only touch
+// this process' copy of a page and never reach the file, so many instances
+// can share the untouched pages of one image.
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const { return mapping != nullptr; }
+    size_t size() const { return length; }
+    const uint8_t* data() const { return mapping; }
+    uint8_t* data() { return mapping; }
+
+private:
+    uint8_t* mapping = nullptr;
+    size_t length = 0;
+};
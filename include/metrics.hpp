@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+
+// bus regions counted separately, the processor port counts as I/O
+#define METRICS_RAM 0
+#define METRICS_ROM 1
+#define METRICS_IO 2
+#define METRICS_COLOR_RAM 3
+#define METRICS_REGIONS 4
+
+// accesses by region, kept by the bus all the time since a counter is cheaper than a check
+struct BusCounters {
+    uint64_t reads[METRICS_REGIONS] = {};
+    uint64_t writes[METRICS_REGIONS] = {};
+};
+
+// What the emulator has done and what it cost on the host. Cycles and frames are the
+// machine's own counters and follow snapshot loads, the rest keeps counting across them.
+struct Metrics {
+    // host seconds since the system was created
+    double time = 0;
+    uint64_t instructions = 0;
+    uint64_t cycles = 0;
+    uint64_t frames = 0;
+    uint64_t irqs = 0;
+    uint64_t nmis = 0;
+    BusCounters bus;
+    // emulated cycles per host second over the last second
+    uint64_t clockSpeed = 0;
+    // host time of the last complete frame
+    uint64_t frameNanoseconds = 0;
+    // host time spent drawing scanlines and in the SID, only measured while timing is on and
+    // the SID time is sampled
+    uint64_t renderNanoseconds = 0;
+    uint64_t sidNanoseconds = 0;
+
+    // one line of JSON without the newline
+    void writeJson(std::ostream& out) const;
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define OPCODE_JSR 0x20
+#define OPCODE_RTI 0x40
+#define OPCODE_RTS 0x60
+
+// fixed nodes of the call tree, interrupt handlers hang below their own roots instead of
+// whatever code they interrupted
+#define PROFILE_MAIN 0
+#define PROFILE_IRQ 1
+#define PROFILE_NMI 2
+
+struct ProfileNode {
+    uint32_t parent;
+    uint16_t routine; // entry address
+    uint64_t calls;
+    uint64_t exclusive; // cycles spent in the routine itself
+};
+
+struct ProfileRoutine {
+    uint16_t routine;
+    uint64_t calls;
+    uint64_t exclusive;
+    uint64_t inclusive; // including everything it called
+};
+
+// Counts the cycles of every instruction per PC and per call stack. Calls are followed
+// through JSR, RTS and RTI and the stack pointer, so code that pops return addresses or
+// jumps through RTS unwinds the right frames. Cheap enough to leave on.
+class Profiler {
+public:
+    Profiler();
+
+    void reset();
+
+    // called by the CPU after every instruction with the stack pointer before and after it
+    void instruction(uint16_t pc, uint8_t opcode, uint16_t nextPc, uint8_t spBefore,
+                     uint8_t spAfter, uint32_t cycles) {
+        pcCycles[pc] += cycles;
+        nodes[current].exclusive += cycles;
+        switch(opcode) {
+        case OPCODE_JSR:
+            unwind(spBefore);
+            call(nextPc, spBefore, current);
+            break;
+        case OPCODE_RTS:
+        case OPCODE_RTI:
+            unwind(spAfter);
+            break;
+        }
+    }
+
+    // called when the CPU takes an interrupt, before the handler runs
+    void interrupt(bool nmi, uint16_t handler, uint8_t spBefore, uint32_t cycles) {
+        unwind(spBefore);
+        call(handler, spBefore, nmi ? PROFILE_NMI : PROFILE_IRQ);
+        nodes[current].exclusive += cycles;
+    }
+
+    uint64_t getCycles(uint16_t pc) const { return pcCycles[pc]; }
+    const uint64_t* getPcCycles() const { return pcCycles.data(); }
+    uint64_t getInterruptCycles() const;
+
+    // every routine with its cycles summed over all call stacks, most inclusive first
+    std::vector<ProfileRoutine> getRoutines() const;
+
+    // "main;$E5CD;$FFD2 1234" lines for flamegraph.pl and compatible viewers
+    bool writeCollapsedStacks(const std::string& path) const;
+
+private:
+    struct Frame {
+        uint32_t node;
+        uint8_t sp; // stack pointer the caller returns to
+    };
+
+    void call(uint16_t routine, uint8_t sp, uint32_t parent);
+    // drops the frames whose return address is no longer on the stack
+    void unwind(uint8_t sp);
+    std::vector<uint64_t> getTotals() const;
+    std::string getStack(uint32_t node) const;
+
+    std::vector<uint64_t> pcCycles;
+    std::vector<ProfileNode> nodes;
+    // (parent << 16) | routine to the child node
+    std::unordered_map<uint64_t, uint32_t> children;
+    std::vector<Frame> stack;
+    uint32_t current = PROFILE_MAIN;
+};
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <input.hpp>
+#include <string>
+#include <vector>
+
+class System;
+
+// a keyframe every five seconds, seeking replays at most that much
+#define REPLAY_KEYFRAME_FRAMES 250
+
+#define REPLAY_MAGIC 0x52343643 // "C64R"
+#define REPLAY_VERSION 2
+
+enum class ReplayEventType : uint8_t {
+    INPUT,
+    PRG,
+    CARTRIDGE,
+    VIRTUAL_DRIVE
+};
+
+struct ReplayEvent {
+    size_t cycle;
+    ReplayEventType type;
+    InputEvent input;
+    // media events
+    std::string path;
+    // FNV-1a of the file when it was recorded, 0 for a directory, playback stops when the
+    // file at path no longer matches
+    uint64_t hash = 0;
+    uint8_t argument = 0; // autostart for a PRG, the device for a virtual drive
+};
+
+struct ReplayKeyframe {
+    size_t cycle;
+    // events before this one are part of the snapshot
+    size_t nextEvent;
+    std::vector<uint8_t> state;
+};
+
+// A recorded run: snapshots of the machine, the first one taken when recording started,
+// and everything that was fed to it stamped with the cycle it happened on.
+struct Replay {
+    uint32_t keyframeFrames = REPLAY_KEYFRAME_FRAMES;
+    size_t endCycle = 0;
+    std::vector<ReplayEvent> events;
+    std::vector<ReplayKeyframe> keyframes;
+
+    bool save(const std::string& path) const;
+    bool load(const std::string& path);
+};
+
+// Records input and media changes of a system and takes a keyframe every keyframeFrames
+// frames, the cartridge and virtual drive already in are recorded before the first one.
+// System::step drives it, a loop that calls CPU::executeOnce itself has to call update
+// between instructions.
+class ReplayRecorder {
+public:
+    ReplayRecorder(System* system, uint32_t keyframeFrames = REPLAY_KEYFRAME_FRAMES);
+    ~ReplayRecorder();
+
+    void update();
+    void recordMedia(ReplayEventType type, const std::string& path, uint8_t argument = 0);
+
+    // the recording up to now
+    const Replay& getReplay();
+    bool save(const std::string& path);
+
+private:
+    void addKeyframe();
+
+    System* system;
+    Replay replay;
+    uint32_t nextKeyframeFrame;
+};
+
+// Plays a replay back on a system set up with the same ROMs and true drive as the recording.
+// The cartridge and virtual drive are put in from the media events.
+class ReplayPlayer {
+public:
+    ReplayPlayer(System* system, const Replay& replay);
+
+    // continues from the closest keyframe unless the system is already on the way there,
+    // false when the keyframe does not fit the system or a media file changed
+    bool seek(size_t cycle);
+    // runs forward, inserting media on the cycle it was inserted on, false when a media file
+    // changed since the recording
+    bool runUntil(size_t cycle);
+
+    bool isFinished() const;
+
+private:
+    // puts in the cartridge and virtual drive the recording had before the event
+    bool restoreMedia(size_t event);
+    bool checkMedia(const ReplayEvent& event) const;
+
+    System* system;
+    const Replay& replay;
+    size_t nextEvent = 0;
+    bool started = false;
+    // the events whose cartridge and virtual drive are in, SIZE_MAX until the player puts
+    // one in
+    size_t cartridgeEvent = SIZE_MAX;
+    size_t driveEvent = SIZE_MAX;
+};
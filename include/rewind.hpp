@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+class System;
+
+// a minute of PAL frames
+#define REWIND_FRAMES (60 * 50)
+#define REWIND_KEYFRAME_FRAMES 100
+
+struct RewindFrame {
+    size_t cycle;
+    // frames since the keyframe, 0 for a keyframe
+    uint32_t distance;
+    // uncompressed snapshot size
+    size_t size;
+    // a keyframe is the compressed snapshot, other frames the compressed XOR with their
+    // keyframe, which is mostly zeros
+    std::vector<uint8_t> data;
+};
+
+// Keeps a snapshot of every frame for stepping backwards. Frames are compressed deltas
+// against the last keyframe, so a minute at the READY prompt costs about 2.5 MB and restoring
+// one frame is a decompress and an XOR, see rewindtest. System::step drives it like a replay
+// recorder.
+class RewindBuffer {
+public:
+    RewindBuffer(System* system, size_t frames = REWIND_FRAMES,
+                 size_t keyframeFrames = REWIND_KEYFRAME_FRAMES);
+    ~RewindBuffer();
+
+    // captures a frame when a new one has started, called between instructions
+    void update();
+    // restores the previous frame, false when there is nothing older
+    bool stepBack();
+    void clear();
+
+    size_t getFrameCount() const { return frames.size(); }
+    size_t getMemoryUsage() const;
+
+private:
+    void capture();
+    bool restore(size_t index);
+    const std::vector<uint8_t>& getKeyframe(size_t index);
+
+    System* system;
+    size_t capacity;
+    size_t keyframeFrames;
+    uint32_t lastFrame;
+
+    std::deque<RewindFrame> frames;
+
+    // the decompressed keyframe most frames are relative to
+    std::vector<uint8_t> keyframe;
+    size_t keyframeCycle = SIZE_MAX;
+
+    // reused so capturing a frame does not allocate
+    std::vector<uint8_t> state;
+    std::vector<uint8_t> delta;
+};
@@ -2,6 +2,7 @@
 
 struct SerialPortState;
 
+#include <state.hpp>
 #include <serial_device.hpp>
 #include <vector>
 
@@ -23,6 +24,10 @@ public:
 
     void printState();
 
+    // the line levels and every device on the bus
+    void saveState(StateWriter& state) const;
+    void loadState(StateReader& state);
+
     std::vector<SerialDevice*> devices;
 
 private:
@@ -1,15 +1,20 @@
 #pragma once
 #include <serial_bus.hpp>
+#include <state.hpp>
 
 class SerialBus;
 
 class SerialDevice {
 public:
     SerialDevice(SerialBus* bus) : bus(bus) {}
+    virtual ~SerialDevice() {}
 
     virtual SerialPortState getIndividualState() = 0;
 
     virtual void tick() = 0;
+
+    virtual void saveState(StateWriter& state) const {}
+    virtual void loadState(StateReader& state) {}
 protected:
     SerialBus* bus;
 };
@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <functional>
+#include <state.hpp>
 
 #define SID_CLOCK_SPEED 985000
 #define SAMPLE_RATE 44100
@@ -111,6 +112,9 @@ public:
     void write(uint16_t addr, uint8_t value);
     uint8_t read(uint16_t addr);
 
+    void saveState(StateWriter& state) const;
+    void loadState(StateReader& state);
+
     SidState getState() const {
         SidState state;
         state.v1Frequency = voice1.frequency;
@@ -175,8 +179,14 @@ public:
         writeCallback = callback;
     }
 
+    // POTX (axis 0) and POTY (axis 1) come from the paddles or mouse on the control ports
+    void setPotCallback(std::function<uint8_t(uint8_t)> callback) {
+        potCallback = callback;
+    }
+
 private:
     std::function<void()> writeCallback;
+    std::function<uint8_t(uint8_t)> potCallback;
 
     Voice voice1;
     Voice voice2;
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <system.hpp>
+#include <vector>
+
+// https://www.hvsc.c64.org/download/C64Music/DOCUMENTS/SID_file_format.txt
+
+#define SID_SPEED_VBI 0
+#define SID_SPEED_CIA 1
+
+struct SidHeader {
+    bool rsid;
+    uint16_t version;
+    uint16_t dataOffset;
+    uint16_t loadAddress;
+    uint16_t initAddress;
+    uint16_t playAddress;
+    uint16_t songs;
+    uint16_t startSong;
+    uint32_t speed;
+    std::string name;
+    std::string author;
+    std::string released;
+    uint16_t flags;
+    uint8_t startPage;
+    uint8_t pageLength;
+};
+
+// Plays PSID/RSID tunes on a System without rendering any video.
+// The player boots the KERNAL, copies the tune into RAM and installs a small
+// driver that calls init once and then play from CIA1 timer A or the VIC raster IRQ.
+class SidPlayer {
+public:
+    SidPlayer(System* system);
+
+    bool load(const std::string& filename);
+
+    // song is 1-based, 0 selects the tune's default song
+    void start(uint16_t song = 0);
+    void run(size_t cycles);
+
+    const SidHeader& getHeader() const { return header; }
+    uint16_t getCurrentSong() const { return currentSong; }
+
+private:
+    void bootKernal();
+    void installDriver(uint16_t song);
+    uint16_t findDriverAddress(uint16_t driverSize);
+    uint8_t bankFor(uint16_t addr) const;
+    uint8_t speedFor(uint16_t song) const;
+
+    System* system;
+    SidHeader header = {};
+    std::vector<uint8_t> data;
+    uint16_t currentSong = 0;
+    bool loaded = false;
+};
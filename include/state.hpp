@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Serialises component state for snapshots. Values are stored as raw host bytes, so a
+// snapshot is only meant to be loaded by the same build on the same kind of machine.
+class StateWriter {
+public:
+    StateWriter(std::vector<uint8_t>& data) : data(data) {}
+
+    template <typename T>
+    void write(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "state must be plain data");
+        writeBytes(&value, sizeof(T));
+    }
+
+    void writeBytes(const void* bytes, size_t length) {
+        const uint8_t* begin = static_cast<const uint8_t*>(bytes);
+        data.insert(data.end(), begin, begin + length);
+    }
+
+    void writeString(const std::string& value) {
+        write<uint32_t>(value.size());
+        writeBytes(value.data(), value.size());
+    }
+
+private:
+    std::vector<uint8_t>& data;
+};
+
+// Reads what a StateWriter wrote. Reading past the end leaves the values zeroed and marks
+// the reader invalid instead of failing on every call.
+class StateReader {
+public:
+    StateReader(const uint8_t* data, size_t size) : data(data), size(size) {}
+    StateReader(const std::vector<uint8_t>& data) : data(data.data()), size(data.size()) {}
+
+    template <typename T>
+    void read(T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "state must be plain data");
+        readBytes(&value, sizeof(T));
+    }
+
+    template <typename T>
+    T read() {
+        T value;
+        read(value);
+        return value;
+    }
+
+    void readBytes(void* bytes, size_t length) {
+        if(!valid || length > size - position) {
+            valid = false;
+            memset(bytes, 0, length);
+            return;
+        }
+        memcpy(bytes, data + position, length);
+        position += length;
+    }
+
+    std::string readString() {
+        uint32_t length = read<uint32_t>();
+        if(!valid || length > size - position) {
+            valid = false;
+            return "";
+        }
+        std::string value(reinterpret_cast<const char*>(data + position), length);
+        position += length;
+        return value;
+    }
+
+    bool isValid() const { return valid; }
+    bool atEnd() const { return position == size; }
+    size_t getPosition() const { return position; }
+
+private:
+    const uint8_t* data;
+    size_t size;
+    size_t position = 0;
+    bool valid = true;
+};
@@ -1,27 +1,92 @@
 #pragma once
 
 #include <C64Bus.hpp>
+#include <arena.hpp>
 #include <cpu.hpp>
 #include <cia1.hpp>
 #include <cia2.hpp>
+#include <drive1541.hpp>
+#include <floppy.hpp>
 #include <vic.hpp>
 #include <sid.hpp>
 #include <input.hpp>
 #include <serial_bus.hpp>
+#include <virtual_drive.hpp>
 #include <chrono>
+#include <fstream>
+#include <metrics.hpp>
+#include <string>
+#include <utility>
+#include <vector>
+
+// READY prompt keyboard wait loop in the KERNAL
+#define KERNAL_READY_LOOP 0xE5CD
+
+#define SNAPSHOT_MAGIC 0x53343643 // "C64S"
+#define SNAPSHOT_VERSION 2
+
+// one SID tick in this many is timed and counted this many times. A tick is a few ns and
+// reading the clock several times that, so its average cost is measured and subtracted.
+#define METRICS_SID_SAMPLE 64
+#define METRICS_CLOCK_CALIBRATION 10000
+
+class ReplayRecorder;
+class RewindBuffer;
 
 class System {
 public:
     System();
+    // builds the chips in the instance's slots of the arena instead of on the heap
+    System(MachineArena* arena, size_t instance);
     ~System();
 
     void loadRoms(const std::string& kernalAndBasicRom, const std::string& characterRom);
+    // shares ROMs already loaded by another instance instead of reading them again
+    void setRoms(std::shared_ptr<const C64Roms> roms) { bus->setRoms(roms); }
+
+    // replaces the IEC stub with a true 1541 running the given ROM, either one 16K image or
+    // the $C000 and $E000 halves
+    bool enableTrueDrive(const std::string& rom, const std::string& upperRom = "");
+    // services LOAD and SAVE on the device from a host directory or disk image without the
+    // serial bus
+    bool enableVirtualDrive(const std::string& path, uint8_t device = 8);
+    void disableVirtualDrive();
+
+    // plugs a CRT into the expansion port and resets into it
+    bool insertCartridge(const std::string& path);
 
     void powerOn();
     void reset();
 
+    // logic only mode keeps the raster and its interrupts but draws nothing, the switch
+    // happens at the next frame boundary
+    void setRenderingEnabled(bool enabled) { vic->requestRendering(enabled); }
+
+    // runs the CPU one bus cycle at a time so bad lines steal their exact cycles, see
+    // CPU::setCycleStepped
+    void setCycleStepped(bool enabled) { cpu->setCycleStepped(enabled); }
+
     void step();
 
+    // the whole machine between two instructions. Loading needs the same ROMs, cartridge
+    // and drive setup the snapshot was taken with.
+    void saveState(std::vector<uint8_t>& state) const;
+    bool loadState(const std::vector<uint8_t>& state);
+
+    // runs until the KERNAL waits for input at the READY prompt, false on timeout
+    bool runUntilReady(size_t timeout = 5000000);
+    // copies a PRG to its load address like LOAD does and optionally types RUN, or SYS for
+    // machine code, into the keyboard buffer
+    bool loadPrg(const std::string& path, bool autostart = true);
+
+    // counters for sizing and spotting regressions, see metrics.hpp
+    Metrics getMetrics() const;
+    // also times scanline rendering and the SID, which costs a few percent
+    void setMetricsTiming(bool enabled);
+    // appends the metrics as a JSON line every host second instead of printing the clock
+    // speed, an empty path stops logging
+    bool setMetricsLog(const std::string& path);
+
     int clockSpeed;
 
     CPU* cpu;
@@ -32,10 +97,47 @@ public:
     SID* sid;
     Input* input;
     SerialBus* serialBus;
+    Floppy* floppy;
+    Drive1541* drive = nullptr;
+    VirtualDrive* virtualDrive = nullptr;
+    // set while a replay is being recorded
+    ReplayRecorder* recorder = nullptr;
+    // set while frames are kept for rewinding
+    RewindBuffer* rewind = nullptr;
 
 private:
+    template<typename T, typename... Args>
+    T* create(int region, Args&&... args) {
+        if(!arena) {
+            return new T(std::forward<Args>(args)...);
+        }
+        return new(arena->get(region, instance)) T(std::forward<Args>(args)...);
+    }
+    template<typename T>
+    void destroy(T* chip) {
+        if(!arena) {
+            delete chip;
+        } else if(chip) {
+            chip->~T();
+        }
+    }
+
+    void updateCycleCallback();
+
+    MachineArena* arena = nullptr;
+    size_t instance = 0;
+
     std::chrono::time_point<std::chrono::high_resolution_clock> lastTime;
     std::chrono::duration<double> accumulatedTime;
     std::chrono::duration<double> timeThreshold;
     size_t cycles;
+
+    std::chrono::time_point<std::chrono::high_resolution_clock> startTime;
+    std::chrono::time_point<std::chrono::high_resolution_clock> frameStart;
+    uint32_t lastFrame = 0;
+    uint64_t frameNanoseconds = 0;
+    bool metricsTiming = false;
+    int64_t sidNanoseconds = 0;
+    int64_t clockNanoseconds = 0;
+    std::ofstream metricsLog;
 };
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <mapped_file.hpp>
+#include <string>
+#include <vector>
+
+#define TRACE_MAGIC 0x54343643 // "C64T"
+#define TRACE_VERSION 1
+
+// record flags, set for the fields that follow the flags byte
+#define TRACE_PC 0x01 // the instruction does not follow the previous one
+#define TRACE_A 0x02
+#define TRACE_X 0x04
+#define TRACE_Y 0x08
+#define TRACE_SP 0x10
+#define TRACE_P 0x20
+
+// flags, PC, opcode, two operands, five registers and a 64-bit cycle delta
+#define TRACE_MAX_RECORD (1 + 2 + 3 + 5 + 10)
+#define TRACE_BUFFER_SIZE (4 * 1024 * 1024)
+
+// the machine before an instruction
+struct TraceRecord {
+    uint64_t cycle;
+    uint16_t pc;
+    uint8_t opcode;
+    uint8_t operands[2];
+    uint8_t a;
+    uint8_t x;
+    uint8_t y;
+    uint8_t sp;
+    uint8_t p;
+};
+
+// Operand lengths and mnemonics of all opcodes, stored in the trace header so a trace can
+// be decoded without the CPU that wrote it.
+struct TraceOpcodes {
+    uint8_t operandLengths[256];
+    char names[256][4];
+};
+
+// Writes one record per instruction. A record is a flags byte, the PC only when the
+// instruction does not follow the previous one, the opcode and its operands, the registers
+// that changed and the cycles since the previous instruction as a varint. Most records
+// take four to six bytes.
+class TraceWriter {
+public:
+    ~TraceWriter();
+
+    bool open(const std::string& path, const TraceOpcodes& opcodes, const TraceRecord& start);
+    void close();
+
+    void record(const TraceRecord& record) {
+        if(bufferEnd - position < TRACE_MAX_RECORD) {
+            flush();
+        }
+        uint8_t* out = position;
+        uint8_t& flags = *out++;
+        flags = 0;
+        if(record.pc != nextPc) {
+            flags |= TRACE_PC;
+            *out++ = record.pc & 0xFF;
+            *out++ = record.pc >> 8;
+        }
+        *out++ = record.opcode;
+        uint8_t length = opcodes.operandLengths[record.opcode];
+        for(uint8_t i = 0; i < length; i++) {
+            *out++ = record.operands[i];
+        }
+        writeRegister(flags, out, TRACE_A, record.a, last.a);
+        writeRegister(flags, out, TRACE_X, record.x, last.x);
+        writeRegister(flags, out, TRACE_Y, record.y, last.y);
+        writeRegister(flags, out, TRACE_SP, record.sp, last.sp);
+        writeRegister(flags, out, TRACE_P, record.p, last.p);
+        uint64_t delta = record.cycle - last.cycle;
+        while(delta >= 0x80) {
+            *out++ = delta | 0x80;
+            delta >>= 7;
+        }
+        *out++ = delta;
+
+        position = out;
+        last = record;
+        nextPc = record.pc + 1 + length;
+    }
+
+private:
+    static void writeRegister(uint8_t& flags, uint8_t*& out, uint8_t flag, uint8_t value,
+                              uint8_t last) {
+        if(value != last) {
+            flags |= flag;
+            *out++ = value;
+        }
+    }
+
+    void flush();
+
+    std::ofstream file;
+    TraceOpcodes opcodes;
+    TraceRecord last;
+    uint32_t nextPc;
+
+    std::vector<uint8_t> buffer;
+    uint8_t* position = nullptr;
+    uint8_t* bufferEnd = nullptr;
+};
+
+// Reads a trace back, memory mapped so long traces are not loaded at once.
+class TraceReader {
+public:
+    bool open(const std::string& path);
+
+    // false at the end of the trace or when it is truncated
+    bool next(TraceRecord& record);
+
+    const char* getName(uint8_t opcode) const { return opcodes.names[opcode]; }
+    uint8_t getOperandLength(uint8_t opcode) const { return opcodes.operandLengths[opcode]; }
+
+private:
+    MappedFile file;
+    TraceOpcodes opcodes;
+    TraceRecord last;
+    uint32_t nextPc;
+    size_t position = 0;
+};
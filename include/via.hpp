@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <state.hpp>
+
+#define VIA_PORTB 0
+#define VIA_PORTA 1
+#define VIA_DIRECTION_REGISTER_B 2
+#define VIA_DIRECTION_REGISTER_A 3
+#define VIA_TIMER_1_LOW 4
+#define VIA_TIMER_1_HIGH 5
+#define VIA_TIMER_1_LATCH_LOW 6
+#define VIA_TIMER_1_LATCH_HIGH 7
+#define VIA_TIMER_2_LOW 8
+#define VIA_TIMER_2_HIGH 9
+#define VIA_SHIFT_REGISTER 10
+#define VIA_AUXILIARY_CONTROL_REGISTER 11
+#define VIA_PERIPHERAL_CONTROL_REGISTER 12
+#define VIA_INTERRUPT_FLAG_REGISTER 13
+#define VIA_INTERRUPT_ENABLE_REGISTER 14
+#define VIA_PORTA_NO_HANDSHAKE 15
+
+// interrupt flag register bits
+#define VIA_INTERRUPT_CA2 0x01
+#define VIA_INTERRUPT_CA1 0x02
+#define VIA_INTERRUPT_SHIFT 0x04
+#define VIA_INTERRUPT_CB2 0x08
+#define VIA_INTERRUPT_CB1 0x10
+#define VIA_INTERRUPT_TIMER_2 0x20
+#define VIA_INTERRUPT_TIMER_1 0x40
+
+// MOS 6522 Versatile Interface Adapter as used in the 1541. Like the CIA the
+// subclasses connect the ports to the hardware around it.
+class VIA {
+public:
+    VIA();
+    virtual ~VIA();
+
+    void write(uint16_t addr, uint8_t data);
+    uint8_t read(uint16_t addr);
+
+    void tick();
+    // advances the timers like that many calls to tick, for a drive that skipped them
+    void skip(size_t cycles);
+    void reset();
+
+    void saveState(StateWriter& state) const;
+    void loadState(StateReader& state);
+
+    void setCA1(bool level);
+    void setCB1(bool level);
+
+    bool irqAsserted() const { return interruptFlags & interruptEnable & 0x7F; }
+    // CA2/CB2 in manual output mode
+    bool ca2Output() const { return (registers[VIA_PERIPHERAL_CONTROL_REGISTER] & 0x0E) == 0x0E; }
+    bool cb2Output() const { return (registers[VIA_PERIPHERAL_CONTROL_REGISTER] & 0xE0) == 0xE0; }
+
+    uint8_t portAPins() const {
+        return registers[VIA_PORTA] | ~registers[VIA_DIRECTION_REGISTER_A];
+    }
+    uint8_t portBPins() const {
+        return registers[VIA_PORTB] | ~registers[VIA_DIRECTION_REGISTER_B];
+    }
+
+protected:
+    virtual uint8_t portAInput() { return 0xFF; }
+    virtual uint8_t portBInput() { return 0xFF; }
+    virtual void portAChanged(uint8_t pins) {}
+    virtual void portBChanged(uint8_t pins) {}
+
+    uint8_t registers[0x10];
+
+private:
+    void tickTimer1();
+
+    uint16_t timer1Counter = 0xFFFF;
+    uint16_t timer1Latch = 0xFFFF;
+    bool timer1Armed = false;
+    bool timer1Reload = false;
+    bool pb7Output = true;
+    uint16_t timer2Counter = 0xFFFF;
+    uint8_t timer2LatchLow = 0xFF;
+    bool timer2Armed = false;
+
+    uint8_t interruptFlags = 0;
+    uint8_t interruptEnable = 0;
+
+    bool ca1Level = false;
+    bool cb1Level = false;
+};
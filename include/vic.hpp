@@ -3,8 +3,10 @@
 #include <cstdint>
 #include <cstddef>
 #include <functional>
+#include <memory>
 #include <C64Bus.hpp>
 #include <cpu.hpp>
+#include <state.hpp>
 
 #define PAL 1
 
@@ -31,18 +33,37 @@ public:
 
     void setCpu(CPU* cpu);
 
+    // the raster position and registers, the picture is redrawn by the next frame
+    void saveState(StateWriter& state) const;
+    void loadState(StateReader& state);
+
+    // when disabled the raster and interrupt timing keeps running but no pixels are produced
+    void setRenderingEnabled(bool enabled) { renderingEnabled = requestedRendering = enabled; }
+    // switches when the next frame starts, so no frame is left half drawn
+    void requestRendering(bool enabled) { requestedRendering = enabled; }
+    bool isRenderingEnabled() const { return renderingEnabled; }
+
     bool needsRender = false;
 
-    std::array<uint32_t, 40 * 25 * 8 * 8> screen = {};
+    // allocated with the first drawn line, machines that never render don't carry a picture
+    std::unique_ptr<std::array<uint32_t, 40 * 25 * 8 * 8>> screen;
 
     uint16_t bankAddress = 0x0000;
 
     uint32_t frameCount = 0;
 
+    // host time spent in renderScanline, only measured while timeRendering is set
+    bool timeRendering = false;
+    uint64_t renderNanoseconds = 0;
+
 private:
     void handleRasterInterrupts();
     void handleDMASteal();
     void renderScanline();
+    // the VIC's own view of memory, RAM and colour RAM without the CPU's banking, and not
+    // counted as bus accesses
+    uint8_t fetch(uint16_t addr) const;
+    uint8_t fetchColor(uint16_t addr) const;
     CPU* cpu;
     C64Bus* bus;
     std::function<void(std::array<uint32_t, 40 * 25 * 8 * 8>&)> framebufferCallback;
@@ -50,6 +71,9 @@ private:
     size_t rasterCycle = 0; // current raster cycle
     size_t cycleCounter = 0; // cycle counter
 
+    bool renderingEnabled = true;
+    bool requestedRendering = true;
+
     bool bitmapMode = false;
     bool multiColorMode = false;
 
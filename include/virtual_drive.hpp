@@ -0,0 +1,81 @@
+#pragma once
+
+#include <C64Bus.hpp>
+#include <cpu.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <disk_image.hpp>
+#include <string>
+#include <vector>
+
+// KERNAL routines behind the ILOAD ($0330) and ISAVE ($0332) vectors
+#define KERNAL_LOAD_ENTRY 0xF4A5
+#define KERNAL_SAVE_ENTRY 0xF5ED
+
+// KERNAL zero page
+#define ZP_STATUS 0x90
+#define ZP_END_ADDRESS 0xAE
+#define ZP_FILENAME_LENGTH 0xB7
+#define ZP_SECONDARY_ADDRESS 0xB9
+#define ZP_DEVICE 0xBA
+#define ZP_FILENAME 0xBB
+#define ZP_SAVE_START 0xC1
+#define ZP_LOAD_ADDRESS 0xC3
+
+// KERNAL error codes returned in A with carry set
+#define KERNAL_ERROR_FILE_NOT_FOUND 4
+#define KERNAL_ERROR_DEVICE_NOT_PRESENT 5
+#define KERNAL_ERROR_MISSING_FILENAME 8
+
+struct VirtualDriveEntry {
+    std::string name; // PETSCII
+    uint8_t type; // directory entry file type, 0x82 is PRG
+    uint16_t blocks;
+    std::string path; // host files only
+    // disk files only, first sector of the file
+    uint8_t track;
+    uint8_t sector;
+};
+
+// Services KERNAL LOAD and SAVE for one device number directly from a host
+// directory of PRG files or a disk image, without going through the serial
+// bus. Programs that replace the vectors with their own loader bypass it.
+class VirtualDrive {
+public:
+    VirtualDrive(CPU* cpu, C64Bus* bus, uint8_t device = 8);
+    ~VirtualDrive();
+
+    // a host directory or a D64/G64 image
+    bool attach(const std::string& path);
+    // an image owned elsewhere, for instances sharing one disk
+    void attachDisk(DiskImage* disk);
+    void detach();
+
+    uint8_t getDevice() const { return device; }
+    // what attach was given, empty for a shared image
+    const std::string& getPath() const { return path; }
+
+private:
+    bool load();
+    bool save();
+    void returnFromTrap(uint8_t error);
+
+    std::string getFilename();
+    std::vector<VirtualDriveEntry> listFiles();
+    bool readFile(const std::string& pattern, std::vector<uint8_t>& data);
+    bool writeFile(const std::string& name, const std::vector<uint8_t>& data);
+    std::vector<uint8_t> buildDirectory();
+
+    bool readDiskFile(const VirtualDriveEntry& entry, std::vector<uint8_t>& data);
+    bool writeDiskFile(const std::string& name, const std::vector<uint8_t>& data);
+    bool allocateSector(uint8_t* bam, uint8_t& track, uint8_t& sector);
+
+    CPU* cpu;
+    C64Bus* bus;
+    uint8_t device;
+
+    std::string path;
+    std::string hostDirectory;
+    DiskImage* disk = nullptr;
+    bool ownsDisk = false;
+};
@@ -1,24 +1,28 @@
 #include "chrom.h"
 #include "kernal.h"
 
-#include <arpa/inet.h> // For ntohl
 #include <C64Bus.hpp>
 #include <cstdint>
+#include <cstring>
 #include <fstream>
-#include <iomanip>
 #include <iostream>
 #include <vector>
 
-C64Bus::C64Bus() {
-    for(int i = 0; i < c64_chrom_bin_len; i++) {
-        charRom[i] = c64_chrom_bin[i];
-    }
-
-    for(int i = 0; i < c64_kernal_bin_len; i++) {
-        basicRom[i] = c64_kernal_bin[i];
-    }
+std::shared_ptr<const C64Roms> C64Roms::getBuiltIn() {
+    static const std::shared_ptr<const C64Roms> builtIn = []() {
+        auto roms = std::make_shared<C64Roms>();
+        // kernal.h is BASIC followed by the KERNAL
+        memcpy(roms->basic, c64_kernal_bin, sizeof(roms->basic));
+        memcpy(roms->kernal, c64_kernal_bin + sizeof(roms->basic), sizeof(roms->kernal));
+        memcpy(roms->character, c64_chrom_bin, sizeof(roms->character));
+        return roms;
+    }();
+    return builtIn;
+}
 
-    for(int i = 0; i < 0xFFFF; i++) {
+C64Bus::C64Bus() {
+    roms = C64Roms::getBuiltIn();
+    for(int i = 0; i < 0x10000; i++) {
         ram[i] = 0x00;
     }
     dataDirectionRegister = 0b11111000;
@@ -26,105 +30,31 @@ C64Bus::C64Bus() {
 }
 
 C64Bus::~C64Bus() {
+    delete cartridge;
 }
 
-struct CRTHeader {
-    char signature[16];
-    uint32_t headerLength;
-    uint16_t version;
-    uint16_t cartridgeType;
-    uint8_t exromLine;
-    uint8_t gameLine;
-    uint8_t reserved[7];
-    char name[32];
-};
-
-struct CHIPPacket {
-    char signature[4];
-    uint32_t length;
-    uint16_t type;
-    uint16_t bank;
-    uint16_t loadAddress;
-    uint16_t dataLength;
-    uint8_t* data;
-};
-
-void C64Bus::loadCartridge(const char* filename) {
-    std::ifstream file(filename, std::ios::binary | std::ios::in);
-    if(!file.is_open()) {
-        std::cerr << "Failed to open file: " << filename << "\n";
-        return;
-    }
-
-    size_t size = 0;
-    file.seekg(0, std::ios::end);
-    size = file.tellg();
-    file.seekg(0, std::ios::beg);
-
-    CRTHeader header;
-    file.read(reinterpret_cast<char*>(&header), sizeof(CRTHeader));
-
-    header.headerLength = ntohl(header.headerLength);
-
-    std::cout << "Raw header bytes: ";
-    for(size_t i = 0; i < sizeof(CRTHeader); ++i) {
-        std::cout << std::hex << std::setw(2) << std::setfill('0')
-                  << (int)((unsigned char*)&header)[i] << " ";
-    }
-    std::cout << std::dec << std::endl;
-
-    if(std::string(header.signature, 16) != "C64 CARTRIDGE   ") {
-        std::cerr << "Invalid CRT file" << std::endl;
-        return;
-    }
-
-    file.seekg(header.headerLength - sizeof(CRTHeader), std::ios::cur);
-
-    std::vector<CHIPPacket> packets;
-    while(file.tellg() < size) {
-        CHIPPacket packet;
-        file.read(reinterpret_cast<char*>(&packet), sizeof(CHIPPacket));
-        packet.length = ntohl(packet.length);
-        packet.bank = ntohs(packet.bank);
-        packet.loadAddress = ntohs(packet.loadAddress);
-        packet.dataLength = ntohs(packet.dataLength);
-        packet.data = new uint8_t[packet.dataLength];
-        file.read(reinterpret_cast<char*>(packet.data), packet.dataLength);
-        packets.push_back(packet);
-    }
-
-    for(CHIPPacket packet : packets) {
-        if(std::string(packet.signature, 4) == "CHIP") {
-            std::cout << "CHIP packet" << std::endl;
-            // print the data
-            for(size_t i = 0; i < packet.dataLength; ++i) {
-                std::cout << std::hex << std::setw(2) << std::setfill('0') << (int)packet.data[i]
-                          << " ";
-            }
-            std::cout << std::dec << std::endl;
-            // write the header manually
-            // write CBM80
-
-            // writeBytes(packet.loadAddress, packet.data, packet.dataLength);
-        }
+bool C64Bus::loadCartridge(const char* filename) {
+    Cartridge* loaded = Cartridge::load(filename);
+    if(!loaded) {
+        return false;
     }
+    delete cartridge;
+    cartridge = loaded;
+    return true;
+}
 
-    cartridgeLoaded = true;
+void C64Bus::removeCartridge() {
+    delete cartridge;
+    cartridge = nullptr;
 }
 
-void C64Bus::write(uint16_t addr, uint8_t data) {
+void C64Bus::writeBanked(uint16_t addr, uint8_t data) {
 #ifndef NO_MMIO
     if(addr == 0x0000) dataDirectionRegister = data;
     if(addr == 0x0001) dataRegister = data;
 
-    if(addr >= 0x8000 && addr <= 0x9FFF) {
-        if(cartridgeLoaded) {
-            // std::cerr << "Attempted to write to cartridge ROM" << std::endl;
-            return;
-        }
-    }
-
     if((dataRegister & 0b011) == 0b00) {
+        counters.writes[addr < 0x0002 ? METRICS_IO : METRICS_RAM]++;
         ram[addr] = data;
         return;
     }
@@ -145,61 +75,157 @@ void C64Bus::write(uint16_t addr, uint8_t data) {
     }
     if(addr >= 0xD000 && addr <= 0xDFFF) {
         if((dataRegister & 0b100) == 0b100) {
+            counters.writes[addr >= 0xD800 && addr < 0xDC00 ? METRICS_COLOR_RAM : METRICS_IO]++;
             handleIoWrite(addr, data);
         } else {
+            counters.writes[METRICS_RAM]++;
             // std::cerr << "Attempted to write to ROM" << std::endl;
         }
+    } else {
+        // writes under a ROM land in RAM
+        counters.writes[addr < 0x0002 ? METRICS_IO : METRICS_RAM]++;
     }
+#else
+    counters.writes[METRICS_RAM]++;
 #endif
     ram[addr] = data;
 }
 
-uint8_t C64Bus::read(uint16_t addr) {
+uint8_t C64Bus::readBanked(uint16_t addr) {
 #ifndef NO_MMIO
-    if(addr == 0x0000) return dataDirectionRegister;
-    if(addr == 0x0001) return dataRegister;
+    if(addr == 0x0000) {
+        counters.reads[METRICS_IO]++;
+        return dataDirectionRegister;
+    }
+    if(addr == 0x0001) {
+        counters.reads[METRICS_IO]++;
+        return dataRegister;
+    }
 
-    if(addr >= 0x8000 && addr <= 0x9FFF) {
-        if(cartridgeLoaded) {
-            return cartridge[addr - 0x8000];
+    if(cartridge && addr >= 0x8000) {
+        const uint8_t* rom = cartridge->map(addr, dataRegister);
+        if(rom) {
+            counters.reads[METRICS_ROM]++;
+            return *rom;
         }
     }
 
     if((dataRegister & 0b011) == 0b00) {
+        counters.reads[METRICS_RAM]++;
         return ram[addr];
     }
 
     if(addr >= 0xA000 && addr <= 0xBFFF) {
         if((dataRegister & 0b011) == 0b01 || (dataRegister & 0b011) == 0b10) {
+            counters.reads[METRICS_RAM]++;
             return ram[addr];
         } else {
-            return basicRom[addr - 0xA000];
+            counters.reads[METRICS_ROM]++;
+            return roms->basic[addr - 0xA000];
         }
     }
     if(addr >= 0xE000 && addr <= 0xFFFF) {
         if((dataRegister & 0b011) == 0b01) {
+            counters.reads[METRICS_RAM]++;
             return ram[addr];
         } else {
-            return kernalRom[addr - 0xE000];
+            counters.reads[METRICS_ROM]++;
+            return roms->kernal[addr - 0xE000];
         }
     }
     if(addr >= 0xD000 && addr <= 0xDFFF) {
         if((dataRegister & 0b100) == 0b100) {
+            counters.reads[addr >= 0xD800 && addr < 0xDC00 ? METRICS_COLOR_RAM : METRICS_IO]++;
             return handleIoRead(addr);
         } else {
-            return charRom[addr - 0xD000];
+            counters.reads[METRICS_ROM]++;
+            return roms->character[addr - 0xD000];
         }
     }
 #endif
+    counters.reads[METRICS_RAM]++;
     return ram[addr];
 }
 
+bool C64Bus::isRam(uint16_t addr, uint16_t size, bool write) const {
+    uint32_t end = addr + size;
+    if(addr < 0x0002 || end > 0x10000) {
+        return false;
+    }
+#ifndef NO_MMIO
+    auto overlaps = [&](uint32_t first, uint32_t last) { return addr < last && end > first; };
+    uint8_t bank = dataRegister & 0b011;
+    if(write) {
+        // only I/O takes writes away from RAM, ROMs let them through
+        return !(bank && (dataRegister & 0b100) && overlaps(0xD000, 0xE000));
+    }
+    if(cartridge && end > 0x8000) {
+        return false;
+    }
+    if(bank == 0b00) {
+        return true;
+    }
+    if(bank == 0b11 && overlaps(0xA000, 0xC000)) {
+        return false;
+    }
+    if(overlaps(0xD000, 0xE000) || (bank != 0b01 && overlaps(0xE000, 0x10000))) {
+        return false;
+    }
+#endif
+    return true;
+}
+
+void C64Bus::writeBytes(uint16_t addr, const uint8_t* data, uint16_t size) {
+    if(!isRam(addr, size, true)) {
+        Bus::writeBytes(addr, data, size);
+        return;
+    }
+    memcpy(ram + addr, data, size);
+    counters.writes[METRICS_RAM] += size;
+}
+
+void C64Bus::readBytes(uint16_t addr, uint8_t* data, uint16_t size) {
+    if(!isRam(addr, size, false)) {
+        Bus::readBytes(addr, data, size);
+        return;
+    }
+    memcpy(data, ram + addr, size);
+    counters.reads[METRICS_RAM] += size;
+}
+
+void C64Bus::tickChips() {
+#ifndef NO_MMIO
+    // a bus on its own, like the one in test6502.cpp, has no chips
+    if(!cia1) {
+        return;
+    }
+    cia1->tick();
+    cia2->tick();
+    vic->tick();
+    sid->tick();
+    input->tick();
+#endif
+}
+
+uint8_t C64Bus::peek(uint16_t addr) {
+    if(addr >= 0xD000 && addr <= 0xDFFF && (dataRegister & 0b011) && (dataRegister & 0b100)) {
+        return 0xFF;
+    }
+    // a debugger look is not an access
+    BusCounters saved = counters;
+    uint8_t value = read(addr);
+    counters = saved;
+    return value;
+}
+
 uint8_t C64Bus::handleIoRead(uint16_t addr) {
     if(addr >= 0xD400 && addr < 0xD800) return sid->read(addr);
     if(addr >= 0xD800 && addr < 0xDBFF) return colorRam[addr - 0xD800];
     if(addr >= 0xD000 && addr < 0xD400) return vic->read(addr);
     if(addr >= 0xDC00 && addr < 0xDD00) return cia1->read(addr);
     if(addr >= 0xDD00 && addr < 0xDE00) return cia2->read(addr);
+    if(cartridge && addr >= 0xDE00 && addr < 0xDF00) return cartridge->readIO1(addr);
+    if(cartridge && addr >= 0xDF00) return cartridge->readIO2(addr);
     return 0;
 }
 
@@ -211,6 +237,8 @@ void C64Bus::handleIoWrite(uint16_t addr, uint8_t data) {
     if(addr >= 0xD000 && addr < 0xD400) vic->write(addr, data);
     if(addr >= 0xDC00 && addr < 0xDD00) cia1->write(addr, data);
     if(addr >= 0xDD00 && addr < 0xDE00) cia2->write(addr, data);
+    if(cartridge && addr >= 0xDE00 && addr < 0xDF00) cartridge->writeIO1(addr, data);
+    if(cartridge && addr >= 0xDF00) cartridge->writeIO2(addr, data);
 }
 
 void C64Bus::loadC64rom(const char* filename) {
@@ -220,8 +248,10 @@ void C64Bus::loadC64rom(const char* filename) {
         return;
     }
 
-    file.read(reinterpret_cast<char*>(basicRom), 0x2000);
-    file.read(reinterpret_cast<char*>(kernalRom), 0x2000);
+    auto loaded = std::make_shared<C64Roms>(*roms);
+    file.read(reinterpret_cast<char*>(loaded->basic), sizeof(loaded->basic));
+    file.read(reinterpret_cast<char*>(loaded->kernal), sizeof(loaded->kernal));
+    roms = loaded;
 
     file.close();
 }
@@ -233,11 +263,33 @@ void C64Bus::loadCharacterRom(const char* filename) {
         return;
     }
 
-    file.read(reinterpret_cast<char*>(charRom), 0x1000);
+    auto loaded = std::make_shared<C64Roms>(*roms);
+    file.read(reinterpret_cast<char*>(loaded->character), sizeof(loaded->character));
+    roms = loaded;
 
     file.close();
 }
 
 uint8_t C64Bus::readCharRom(uint16_t addr) {
-    return charRom[addr];
+    return roms->character[addr];
+}
+
+void C64Bus::saveState(StateWriter& state) const {
+    state.write(dataDirectionRegister);
+    state.write(dataRegister);
+    state.writeBytes(ram, sizeof(ram));
+    state.writeBytes(colorRam, sizeof(colorRam));
+    if(cartridge) {
+        cartridge->saveState(state);
+    }
+}
+
+void C64Bus::loadState(StateReader& state) {
+    state.read(dataDirectionRegister);
+    state.read(dataRegister);
+    state.readBytes(ram, sizeof(ram));
+    state.readBytes(colorRam, sizeof(colorRam));
+    if(cartridge) {
+        cartridge->loadState(state);
+    }
 }
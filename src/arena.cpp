@@ -0,0 +1,24 @@
+#include <arena.hpp>
+#include <new>
+#include <system.hpp>
+
+static size_t alignUp(size_t size) {
+    return (size + ARENA_ALIGNMENT - 1) & ~static_cast<size_t>(ARENA_ALIGNMENT - 1);
+}
+
+MachineArena::MachineArena(size_t instances) : instances(instances) {
+    const size_t chipSizes[ARENA_REGIONS] = {
+        sizeof(C64Bus), sizeof(CPUCore<C64Bus>), sizeof(CIA1),      sizeof(CIA2),   sizeof(VIC),
+        sizeof(SID),    sizeof(Input),           sizeof(SerialBus), sizeof(Floppy),
+    };
+    for(int i = 0; i < ARENA_REGIONS; i++) {
+        slotSizes[i] = alignUp(chipSizes[i]);
+        offsets[i] = bytes;
+        bytes += slotSizes[i] * instances;
+    }
+    memory = static_cast<uint8_t*>(::operator new(bytes, std::align_val_t(ARENA_ALIGNMENT)));
+}
+
+MachineArena::~MachineArena() {
+    ::operator delete(memory, std::align_val_t(ARENA_ALIGNMENT));
+}
@@ -14,3 +14,9 @@ void Bus::writeBytes(uint16_t addr, const uint8_t* data, uint16_t size) {
         write(addr + i, data[i]);
     }
 }
+
+void Bus::readBytes(uint16_t addr, uint8_t* data, uint16_t size) {
+    for(int i = 0; i < size; i++) {
+        data[i] = read(addr + i);
+    }
+}
@@ -0,0 +1,201 @@
+#include <cartridge.hpp>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// CRT fields are big endian
+static uint16_t readWord(const uint8_t* data) {
+    return (data[0] << 8) | data[1];
+}
+
+static uint32_t readLong(const uint8_t* data) {
+    return (data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+}
+
+Cartridge* Cartridge::load(const std::string& path) {
+    std::ifstream file(path, std::ios::binary | std::ios::in);
+    if(!file.is_open()) {
+        std::cerr << "Failed to open file: " << path << "\n";
+        return nullptr;
+    }
+    uint8_t header[0x40];
+    file.read(reinterpret_cast<char*>(header), sizeof(header));
+    if(!file || memcmp(header, CRT_HEADER_SIGNATURE, 16) != 0) {
+        std::cerr << "Not a CRT file: " << path << "\n";
+        return nullptr;
+    }
+    file.close();
+
+    Cartridge* cartridge;
+    uint16_t type = readWord(header + 0x16);
+    switch(type) {
+    case CRT_NORMAL:
+        cartridge = new NormalCartridge();
+        break;
+    case CRT_OCEAN:
+        cartridge = new OceanCartridge();
+        break;
+    case CRT_MAGIC_DESK:
+        cartridge = new MagicDeskCartridge();
+        break;
+    case CRT_EASYFLASH:
+        cartridge = new EasyFlashCartridge();
+        break;
+    default:
+        std::cerr << "Unsupported cartridge type " << type << ": " << path << "\n";
+        return nullptr;
+    }
+
+    if(!cartridge->open(path)) {
+        delete cartridge;
+        return nullptr;
+    }
+    cartridge->reset();
+    return cartridge;
+}
+
+bool Cartridge::open(const std::string& path) {
+    if(!file.open(path)) {
+        return false;
+    }
+    const uint8_t* data = file.data();
+    size_t size = file.size();
+
+    this->path = path;
+    type = readWord(data + 0x16);
+    initialExrom = data[0x18] == 0;
+    initialGame = data[0x19] == 0;
+    name = std::string(reinterpret_cast<const char*>(data + 0x20), 32);
+    name = name.substr(0, name.find('\0'));
+
+    size_t offset = readLong(data + 0x10);
+    while(offset + CRT_CHIP_HEADER_LENGTH <= size) {
+        const uint8_t* chip = data + offset;
+        uint32_t length = readLong(chip + 0x04);
+        if(memcmp(chip, CRT_CHIP_SIGNATURE, 4) != 0 || length < CRT_CHIP_HEADER_LENGTH) {
+            std::cerr << "Invalid CHIP packet at " << offset << ": " << path << "\n";
+            return false;
+        }
+        uint16_t bank = readWord(chip + 0x0A);
+        uint16_t loadAddress = readWord(chip + 0x0C);
+        uint16_t chipSize = readWord(chip + 0x0E);
+        const uint8_t* rom = chip + CRT_CHIP_HEADER_LENGTH;
+        if(offset + CRT_CHIP_HEADER_LENGTH + chipSize > size || chipSize == 0) {
+            std::cerr << "Truncated CHIP packet at " << offset << ": " << path << "\n";
+            return false;
+        }
+
+        if(chipSize < CARTRIDGE_BANK_SIZE) {
+            uint8_t* mirrored = new uint8_t[CARTRIDGE_BANK_SIZE];
+            for(size_t i = 0; i < CARTRIDGE_BANK_SIZE; i++) {
+                mirrored[i] = rom[i % chipSize];
+            }
+            mirroredChips.emplace_back(mirrored);
+            rom = mirrored;
+        }
+
+        if(bank >= lowBanks.size()) {
+            lowBanks.resize(bank + 1, nullptr);
+            highBanks.resize(bank + 1, nullptr);
+        }
+        if(loadAddress == 0x8000) {
+            lowBanks[bank] = rom;
+            // a 16K chip covers both areas
+            if(chipSize > CARTRIDGE_BANK_SIZE) {
+                highBanks[bank] = rom + CARTRIDGE_BANK_SIZE;
+            }
+        } else if(loadAddress == 0xA000 || loadAddress == 0xE000) {
+            highBanks[bank] = rom;
+        } else {
+            std::cerr << "Invalid CHIP load address " << loadAddress << ": " << path << "\n";
+            return false;
+        }
+        offset += length;
+    }
+
+    if(lowBanks.empty()) {
+        std::cerr << "Cartridge has no ROM: " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+void Cartridge::reset() {
+    exromActive = initialExrom;
+    gameActive = initialGame;
+    selectBank(0);
+}
+
+void Cartridge::saveState(StateWriter& state) const {
+    state.write(exromActive);
+    state.write(gameActive);
+    state.write(bank);
+}
+
+void Cartridge::loadState(StateReader& state) {
+    state.read(exromActive);
+    state.read(gameActive);
+    selectBank(state.read<size_t>());
+}
+
+void Cartridge::selectBank(size_t bank) {
+    this->bank = bank;
+    if(bank < lowBanks.size()) {
+        romL = lowBanks[bank];
+        romH = highBanks[bank];
+    } else {
+        romL = nullptr;
+        romH = nullptr;
+    }
+}
+
+void OceanCartridge::writeIO1(uint16_t addr, uint8_t data) {
+    selectBank(data & 0x3F);
+}
+
+void OceanCartridge::selectBank(size_t bank) {
+    Cartridge::selectBank(bank);
+    // the 512K boards only have chips at $8000 and show the same bank at $A000
+    if(!romH) {
+        romH = romL;
+    }
+}
+
+void MagicDeskCartridge::writeIO1(uint16_t addr, uint8_t data) {
+    selectBank(data & 0x7F);
+    exromActive = !(data & 0x80);
+}
+
+void EasyFlashCartridge::reset() {
+    Cartridge::reset();
+    memset(ram, 0, sizeof(ram));
+    setControl(0);
+}
+
+void EasyFlashCartridge::saveState(StateWriter& state) const {
+    Cartridge::saveState(state);
+    state.writeBytes(ram, sizeof(ram));
+}
+
+void EasyFlashCartridge::loadState(StateReader& state) {
+    Cartridge::loadState(state);
+    state.readBytes(ram, sizeof(ram));
+}
+
+void EasyFlashCartridge::writeIO1(uint16_t addr, uint8_t data) {
+    switch(addr & 0x02) {
+    case 0x00:
+        selectBank(data & 0x3F);
+        break;
+    case 0x02:
+        setControl(data);
+        break;
+    }
+}
+
+void EasyFlashCartridge::setControl(uint8_t data) {
+    // bit 2 takes GAME from bit 0 instead of the boot jumper, which holds it low.
+    // bit 1 pulls EXROM low, bit 7 is the LED
+    gameActive = (data & 0x04) ? (data & 0x01) : true;
+    exromActive = data & 0x02;
+}
@@ -0,0 +1,403 @@
+#include <algorithm>
+#include <cia.hpp>
+#include <cpu.hpp>
+
+static uint8_t incrementBCD(uint8_t value) {
+    value++;
+    if((value & 0x0F) == 0x0A) {
+        value += 0x06;
+    }
+    return value;
+}
+
+CIA::CIA() {
+    for(int i = 0; i < 0x10; i++) {
+        registers[i] = 0x00;
+    }
+    nextTodCycle = todPeriod();
+    updateNextEvent();
+}
+
+CIA::~CIA() {
+}
+
+void CIA::write(uint16_t addr, uint8_t data) {
+    addr &= 0x0F;
+    size_t cycle = cpu->cycles;
+    switch(addr) {
+    case PORTA:
+    case DIRECTION_REGISTER_A:
+        registers[addr] = data;
+        portAChanged(portAPins());
+        return;
+    case PORTB:
+    case DIRECTION_REGISTER_B:
+        registers[addr] = data;
+        portBChanged(portBPins());
+        return;
+    case TIMER_A_LOW:
+        timerA.latch = (timerA.latch & 0xFF00) | data;
+        break;
+    case TIMER_A_HIGH:
+        timerA.latch = (timerA.latch & 0x00FF) | (data << 8);
+        if(!timerA.running) {
+            timerA.load(cycle);
+        }
+        break;
+    case TIMER_B_LOW:
+        timerB.latch = (timerB.latch & 0xFF00) | data;
+        break;
+    case TIMER_B_HIGH:
+        timerB.latch = (timerB.latch & 0x00FF) | (data << 8);
+        if(!timerB.running) {
+            timerB.load(cycle);
+        }
+        break;
+    case TIME_OF_DAY_TENTHS:
+    case TIME_OF_DAY_SECONDS:
+    case TIME_OF_DAY_MINUTES:
+    case TIME_OF_DAY_HOURS: {
+        // CRB bit 7 selects whether the clock or the alarm is written
+        CIATimeOfDay& target = (registers[TIMER_B_CONTROL_REGISTER] & 0x80) ? alarm : tod;
+        if(addr == TIME_OF_DAY_TENTHS) {
+            target.tenths = data & 0x0F;
+            if(&target == &tod) {
+                todHalted = false;
+            }
+        } else if(addr == TIME_OF_DAY_SECONDS) {
+            target.seconds = data & 0x7F;
+        } else if(addr == TIME_OF_DAY_MINUTES) {
+            target.minutes = data & 0x7F;
+        } else {
+            target.hours = data & 0x9F;
+            // the clock stops until the tenths are written
+            if(&target == &tod) {
+                todHalted = true;
+            }
+        }
+        checkAlarm();
+        break;
+    }
+    case SERIAL_SHIFT_REGISTER:
+        registers[SERIAL_SHIFT_REGISTER] = data;
+        if(registers[TIMER_A_CONTROL_REGISTER] & 0x40) {
+            serialPending = true;
+            if(shiftCount == 0) {
+                shiftSerialOut();
+            }
+        }
+        break;
+    case INTERRUPT_CONTROL_REGISTER:
+        // bit 7 selects whether the other bits set or clear mask bits
+        if(data & 0x80) {
+            interruptMask |= data & 0x1F;
+        } else {
+            interruptMask &= ~data;
+        }
+        if((interruptData & interruptMask) && !(interruptData & 0x80)) {
+            interruptData |= 0x80;
+            interruptOutput(true);
+        }
+        break;
+    case TIMER_A_CONTROL_REGISTER:
+        writeControlA(data, cycle);
+        break;
+    case TIMER_B_CONTROL_REGISTER:
+        writeControlB(data, cycle);
+        break;
+    default:
+        break;
+    }
+    updateNextEvent();
+}
+
+void CIA::writeControlA(uint8_t data, size_t cycle) {
+    bool wasRunning = timerA.running;
+    timerA.stop(cycle);
+    timerA.oneShot = data & 0x08;
+    // bit 5 counts positive CNT edges instead of cycles
+    timerA.countsCycles = !(data & 0x20);
+    if(data & 0x10) {
+        timerA.load(cycle);
+    }
+    if(data & 0x01) {
+        timerA.start(cycle);
+        if(!wasRunning) {
+            pb6Toggle = true;
+        }
+    }
+    if((data ^ registers[TIMER_A_CONTROL_REGISTER]) & 0x40) {
+        // switching the serial port direction aborts a transfer
+        shiftCount = 0;
+        serialPending = false;
+        cntLevel = true;
+    }
+    registers[TIMER_A_CONTROL_REGISTER] = data & ~0x10;
+}
+
+void CIA::writeControlB(uint8_t data, size_t cycle) {
+    bool wasRunning = timerB.running;
+    timerB.stop(cycle);
+    timerB.oneShot = data & 0x08;
+    // bits 5-6: 00 cycles, 01 CNT edges, 10 timer A underflows, 11 timer A underflows while CNT
+    // is high
+    timerB.countsCycles = !(data & 0x60);
+    if(data & 0x10) {
+        timerB.load(cycle);
+    }
+    if(data & 0x01) {
+        timerB.start(cycle);
+        if(!wasRunning) {
+            pb7Toggle = true;
+        }
+    }
+    registers[TIMER_B_CONTROL_REGISTER] = data & ~0x10;
+}
+
+uint8_t CIA::read(uint16_t addr) {
+    addr &= 0x0F;
+    size_t cycle = cpu->cycles;
+    switch(addr) {
+    case PORTA:
+        return portAPins() & portAInput();
+    case PORTB: {
+        uint8_t value = portBPins() & portBInput();
+        // timer outputs on PB6/PB7 override the data direction register
+        if(registers[TIMER_A_CONTROL_REGISTER] & 0x02) {
+            bool level = (registers[TIMER_A_CONTROL_REGISTER] & 0x04) ? pb6Toggle : false;
+            value = (value & ~0x40) | (level << 6);
+        }
+        if(registers[TIMER_B_CONTROL_REGISTER] & 0x02) {
+            bool level = (registers[TIMER_B_CONTROL_REGISTER] & 0x04) ? pb7Toggle : false;
+            value = (value & ~0x80) | (level << 7);
+        }
+        return value;
+    }
+    case TIMER_A_LOW:
+        return timerA.read(cycle) & 0xFF;
+    case TIMER_A_HIGH:
+        return timerA.read(cycle) >> 8;
+    case TIMER_B_LOW:
+        return timerB.read(cycle) & 0xFF;
+    case TIMER_B_HIGH:
+        return timerB.read(cycle) >> 8;
+    case TIME_OF_DAY_TENTHS: {
+        // reading the tenths releases the latch taken when reading the hours
+        uint8_t value = todLatched ? todLatch.tenths : tod.tenths;
+        todLatched = false;
+        return value;
+    }
+    case TIME_OF_DAY_SECONDS:
+        return todLatched ? todLatch.seconds : tod.seconds;
+    case TIME_OF_DAY_MINUTES:
+        return todLatched ? todLatch.minutes : tod.minutes;
+    case TIME_OF_DAY_HOURS:
+        if(!todLatched) {
+            todLatch = tod;
+            todLatched = true;
+        }
+        return todLatch.hours;
+    case INTERRUPT_CONTROL_REGISTER: {
+        // reading acknowledges all pending interrupts
+        uint8_t value = interruptData;
+        if(interruptData & 0x80) {
+            interruptOutput(false);
+        }
+        interruptData = 0;
+        return value;
+    }
+    case TIMER_A_CONTROL_REGISTER:
+        return (registers[addr] & ~0x01) | timerA.running;
+    case TIMER_B_CONTROL_REGISTER:
+        return (registers[addr] & ~0x01) | timerB.running;
+    default:
+        return registers[addr];
+    }
+}
+
+// nothing happens between events, so most cycles are a single comparison
+void CIA::tick() {
+    if(cpu->cycles >= nextEventCycle) {
+        handleEvents(cpu->cycles);
+    }
+}
+
+void CIA::handleEvents(size_t cycle) {
+    if(cycle >= nextTodCycle) {
+        nextTodCycle += todPeriod();
+        if(!todHalted) {
+            advanceTimeOfDay();
+        }
+    }
+
+    if(cycle >= timerA.nextUnderflow()) {
+        timerA.underflow(timerA.nextUnderflow());
+        timerAUnderflow();
+    }
+
+    if(cycle >= timerB.nextUnderflow()) {
+        timerB.underflow(timerB.nextUnderflow());
+        timerBUnderflow();
+    }
+
+    updateNextEvent();
+}
+
+void CIA::updateNextEvent() {
+    nextEventCycle = std::min({nextTodCycle, timerA.nextUnderflow(), timerB.nextUnderflow()});
+}
+
+void CIA::timerAUnderflow() {
+    pb6Toggle = !pb6Toggle;
+    setInterrupt(CIA_INTERRUPT_TIMER_A);
+
+    if((registers[TIMER_A_CONTROL_REGISTER] & 0x40) && shiftCount > 0) {
+        // the serial port is clocked at half the timer A underflow rate
+        cntLevel = !cntLevel;
+        if(!cntLevel) {
+            serialOutput(shiftRegister & 0x80);
+            shiftRegister <<= 1;
+        }
+        if(--shiftCount == 0) {
+            setInterrupt(CIA_INTERRUPT_SERIAL);
+            if(serialPending) {
+                shiftSerialOut();
+            }
+        }
+    }
+
+    // cascaded timer B
+    uint8_t modeB = registers[TIMER_B_CONTROL_REGISTER] & 0x60;
+    if(modeB == 0x40 || (modeB == 0x60 && cntLevel)) {
+        if(timerB.countPulse()) {
+            timerBUnderflow();
+        }
+    }
+}
+
+void CIA::timerBUnderflow() {
+    pb7Toggle = !pb7Toggle;
+    setInterrupt(CIA_INTERRUPT_TIMER_B);
+}
+
+void CIA::shiftSerialOut() {
+    shiftRegister = registers[SERIAL_SHIFT_REGISTER];
+    shiftCount = 16;
+    serialPending = false;
+}
+
+void CIA::serialInput(bool bit) {
+    if(registers[TIMER_A_CONTROL_REGISTER] & 0x20) {
+        if(timerA.countPulse()) {
+            timerAUnderflow();
+        }
+    }
+    if((registers[TIMER_B_CONTROL_REGISTER] & 0x60) == 0x20) {
+        if(timerB.countPulse()) {
+            timerBUnderflow();
+        }
+    }
+
+    if(registers[TIMER_A_CONTROL_REGISTER] & 0x40) {
+        return;
+    }
+    shiftRegister = (shiftRegister << 1) | bit;
+    if(++shiftCount == 8) {
+        shiftCount = 0;
+        registers[SERIAL_SHIFT_REGISTER] = shiftRegister;
+        setInterrupt(CIA_INTERRUPT_SERIAL);
+    }
+}
+
+void CIA::triggerFlag() {
+    setInterrupt(CIA_INTERRUPT_FLAG);
+}
+
+void CIA::setInterrupt(uint8_t source) {
+    interruptData |= source;
+    if(interruptMask & source) {
+        interruptData |= 0x80;
+        interruptOutput(true);
+    }
+}
+
+size_t CIA::todPeriod() const {
+    // CRA bit 7 selects a 50Hz or 60Hz divider for the mains input
+    return ((registers[TIMER_A_CONTROL_REGISTER] & 0x80) ? 5 : 6) * CIA_TOD_PULSE_CYCLES;
+}
+
+void CIA::advanceTimeOfDay() {
+    tod.tenths = (tod.tenths + 1) & 0x0F;
+    if(tod.tenths == 10) {
+        tod.tenths = 0;
+        tod.seconds = incrementBCD(tod.seconds);
+        if(tod.seconds == 0x60) {
+            tod.seconds = 0;
+            tod.minutes = incrementBCD(tod.minutes);
+            if(tod.minutes == 0x60) {
+                tod.minutes = 0;
+                uint8_t pm = tod.hours & 0x80;
+                uint8_t hours = tod.hours & 0x1F;
+                if(hours == 0x11) {
+                    hours = 0x12;
+                    pm ^= 0x80;
+                } else if(hours == 0x12) {
+                    hours = 0x01;
+                } else {
+                    hours = incrementBCD(hours);
+                }
+                tod.hours = pm | hours;
+            }
+        }
+    }
+    checkAlarm();
+}
+
+void CIA::checkAlarm() {
+    if(tod.tenths == alarm.tenths && tod.seconds == alarm.seconds &&
+       tod.minutes == alarm.minutes && tod.hours == alarm.hours) {
+        setInterrupt(CIA_INTERRUPT_ALARM);
+    }
+}
+
+void CIA::saveState(StateWriter& state) const {
+    state.writeBytes(registers, sizeof(registers));
+    state.write(timerA);
+    state.write(timerB);
+    state.write(pb6Toggle);
+    state.write(pb7Toggle);
+    state.write(interruptData);
+    state.write(interruptMask);
+    state.write(tod);
+    state.write(alarm);
+    state.write(todLatch);
+    state.write(todLatched);
+    state.write(todHalted);
+    state.write(nextTodCycle);
+    state.write(shiftRegister);
+    state.write(shiftCount);
+    state.write(serialPending);
+    state.write(cntLevel);
+    state.write(nextEventCycle);
+}
+
+void CIA::loadState(StateReader& state) {
+    state.readBytes(registers, sizeof(registers));
+    state.read(timerA);
+    state.read(timerB);
+    state.read(pb6Toggle);
+    state.read(pb7Toggle);
+    state.read(interruptData);
+    state.read(interruptMask);
+    state.read(tod);
+    state.read(alarm);
+    state.read(todLatch);
+    state.read(todLatched);
+    state.read(todHalted);
+    state.read(nextTodCycle);
+    state.read(shiftRegister);
+    state.read(shiftCount);
+    state.read(serialPending);
+    state.read(cntLevel);
+    state.read(nextEventCycle);
+}
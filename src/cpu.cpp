@@ -1,9 +1,13 @@
+#include <C64Bus.hpp>
 #include <array>
 #include <cpu.hpp>
 #include <cstddef>
+#include <cstring>
+#include <flat_bus.hpp>
 #include <iostream>
 #include <stdexcept>
 #include <sys/types.h>
+#include <tuple>
 
 // TODO: implement timing for page crossing on illegal opcodes
 
@@ -30,109 +34,127 @@ static const std::array<std::string, 256> instructionNames = {
     "ISC", "SED", "SBC", "NOP", "ISC", "TOP", "SBC", "INC", "ISC",
 };
 
-static void unkownInstruction(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void unkownInstruction(CPUCore<BusType>* cpu, AddressingMode mode) {
     std::cout << "opcode: " << std::hex << static_cast<int>(cpu->getCurrentOpcode()) << std::dec
               << "\n";
     throw std::runtime_error("Unknown instruction");
 }
 
-static void JMP(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void JMP(CPUCore<BusType>* cpu, AddressingMode mode) {
     cpu->PC = cpu->getAddress(mode);
 }
 
-static void LDX(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void LDX(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode);
-    cpu->X = cpu->bus->read(address);
+    cpu->X = cpu->typedBus->read(address);
     cpu->P &= ~(ZERO_FLAG | NEGATIVE_FLAG);
     cpu->P |= (!cpu->X) * ZERO_FLAG;
     cpu->P |= (cpu->X & 0x80);
     cpu->stepCycles(1);
 }
 
-static void LDA(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void LDA(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode);
-    cpu->A = cpu->bus->read(address);
+    cpu->A = cpu->typedBus->read(address);
     cpu->P &= ~(ZERO_FLAG | NEGATIVE_FLAG);
     cpu->P |= (!cpu->A) * ZERO_FLAG;
     cpu->P |= (cpu->A & 0x80);
     cpu->stepCycles(1);
 }
 
-static void LDY(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void LDY(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode);
-    cpu->Y = cpu->bus->read(address);
+    cpu->Y = cpu->typedBus->read(address);
     cpu->P &= ~(ZERO_FLAG | NEGATIVE_FLAG);
     cpu->P |= (!cpu->Y) * ZERO_FLAG;
     cpu->P |= (cpu->Y & 0x80);
     cpu->stepCycles(1);
 }
 
-static void STX(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void STX(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode);
-    cpu->bus->write(address, cpu->X);
+    cpu->typedBus->write(address, cpu->X);
     cpu->stepCycles(1);
 }
 
-static void STY(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void STY(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode);
-    cpu->bus->write(address, cpu->Y);
+    cpu->typedBus->write(address, cpu->Y);
     cpu->stepCycles(1);
 }
 
-static void JSR(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void JSR(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode);
     cpu->pushWord(cpu->PC - 1);
     cpu->PC = address;
     cpu->stepCycles(1);
 }
 
-static void RTS(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void RTS(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->popWord();
     cpu->PC = address + 1;
     cpu->stepCycles(3);
 }
 
-static void NOP(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void NOP(CPUCore<BusType>* cpu, AddressingMode mode) {
     cpu->stepCycles(1);
 }
 
-static void SEC(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void SEC(CPUCore<BusType>* cpu, AddressingMode mode) {
     cpu->P |= CARRY_FLAG;
     cpu->stepCycles(1);
 }
 
-static void CLC(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void CLC(CPUCore<BusType>* cpu, AddressingMode mode) {
     cpu->P &= ~CARRY_FLAG;
     cpu->stepCycles(1);
 }
 
-static void SEI(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void SEI(CPUCore<BusType>* cpu, AddressingMode mode) {
     cpu->P |= INTERRUPT_DISABLE_FLAG;
     cpu->stepCycles(1);
 }
 
-static void CLI(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void CLI(CPUCore<BusType>* cpu, AddressingMode mode) {
     cpu->P &= ~INTERRUPT_DISABLE_FLAG;
     cpu->stepCycles(1);
 }
 
-static void SED(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void SED(CPUCore<BusType>* cpu, AddressingMode mode) {
     cpu->P |= DECIMAL_MODE_FLAG;
     cpu->stepCycles(1);
 }
 
-static void CLD(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void CLD(CPUCore<BusType>* cpu, AddressingMode mode) {
     cpu->P &= ~DECIMAL_MODE_FLAG;
     cpu->stepCycles(1);
 }
 
-static void CLV(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void CLV(CPUCore<BusType>* cpu, AddressingMode mode) {
     cpu->P &= ~OVERFLOW_FLAG;
     cpu->stepCycles(1);
 }
 
-static void BCS(CPU* cpu, AddressingMode mode) {
-    int8_t offset = cpu->bus->read(cpu->PC++);
+template<typename BusType>
+static void BCS(CPUCore<BusType>* cpu, AddressingMode mode) {
+    int8_t offset = cpu->typedBus->read(cpu->PC++);
     if(cpu->P & CARRY_FLAG) {
         cpu->stepCycles(1);
         if((cpu->PC & 0xFF00) != ((cpu->PC + offset) & 0xFF00)) {
@@ -143,8 +165,9 @@ static void BCS(CPU* cpu, AddressingMode mode) {
     cpu->stepCycles(1);
 }
 
-static void BCC(CPU* cpu, AddressingMode mode) {
-    int8_t offset = cpu->bus->read(cpu->PC++);
+template<typename BusType>
+static void BCC(CPUCore<BusType>* cpu, AddressingMode mode) {
+    int8_t offset = cpu->typedBus->read(cpu->PC++);
     if(!(cpu->P & CARRY_FLAG)) {
         cpu->stepCycles(1);
         if((cpu->PC & 0xFF00) != ((cpu->PC + offset) & 0xFF00)) {
@@ -155,8 +178,9 @@ static void BCC(CPU* cpu, AddressingMode mode) {
     cpu->stepCycles(1);
 }
 
-static void BEQ(CPU* cpu, AddressingMode mode) {
-    int8_t offset = cpu->bus->read(cpu->PC++);
+template<typename BusType>
+static void BEQ(CPUCore<BusType>* cpu, AddressingMode mode) {
+    int8_t offset = cpu->typedBus->read(cpu->PC++);
     if(cpu->P & ZERO_FLAG) {
         cpu->stepCycles(1);
         if((cpu->PC & 0xFF00) != ((cpu->PC + offset) & 0xFF00)) {
@@ -167,8 +191,9 @@ static void BEQ(CPU* cpu, AddressingMode mode) {
     cpu->stepCycles(1);
 }
 
-static void BNE(CPU* cpu, AddressingMode mode) {
-    int8_t offset = cpu->bus->read(cpu->PC++);
+template<typename BusType>
+static void BNE(CPUCore<BusType>* cpu, AddressingMode mode) {
+    int8_t offset = cpu->typedBus->read(cpu->PC++);
     if(!(cpu->P & ZERO_FLAG)) {
         cpu->stepCycles(1);
         if((cpu->PC & 0xFF00) != ((cpu->PC + offset) & 0xFF00)) {
@@ -179,8 +204,9 @@ static void BNE(CPU* cpu, AddressingMode mode) {
     cpu->stepCycles(1);
 }
 
-static void BVS(CPU* cpu, AddressingMode mode) {
-    int8_t offset = cpu->bus->read(cpu->PC++);
+template<typename BusType>
+static void BVS(CPUCore<BusType>* cpu, AddressingMode mode) {
+    int8_t offset = cpu->typedBus->read(cpu->PC++);
     if(cpu->P & OVERFLOW_FLAG) {
         cpu->stepCycles(1);
         if((cpu->PC & 0xFF00) != ((cpu->PC + offset) & 0xFF00)) {
@@ -191,8 +217,9 @@ static void BVS(CPU* cpu, AddressingMode mode) {
     cpu->stepCycles(1);
 }
 
-static void BVC(CPU* cpu, AddressingMode mode) {
-    int8_t offset = cpu->bus->read(cpu->PC++);
+template<typename BusType>
+static void BVC(CPUCore<BusType>* cpu, AddressingMode mode) {
+    int8_t offset = cpu->typedBus->read(cpu->PC++);
     if(!(cpu->P & OVERFLOW_FLAG)) {
         cpu->stepCycles(1);
         if((cpu->PC & 0xFF00) != ((cpu->PC + offset) & 0xFF00)) {
@@ -203,8 +230,9 @@ static void BVC(CPU* cpu, AddressingMode mode) {
     cpu->stepCycles(1);
 }
 
-static void BPL(CPU* cpu, AddressingMode mode) {
-    int8_t offset = cpu->bus->read(cpu->PC++);
+template<typename BusType>
+static void BPL(CPUCore<BusType>* cpu, AddressingMode mode) {
+    int8_t offset = cpu->typedBus->read(cpu->PC++);
     if(!(cpu->P & NEGATIVE_FLAG)) {
         cpu->stepCycles(1);
         if((cpu->PC & 0xFF00) != ((cpu->PC + offset) & 0xFF00)) {
@@ -215,8 +243,9 @@ static void BPL(CPU* cpu, AddressingMode mode) {
     cpu->stepCycles(1);
 }
 
-static void BMI(CPU* cpu, AddressingMode mode) {
-    int8_t offset = cpu->bus->read(cpu->PC++);
+template<typename BusType>
+static void BMI(CPUCore<BusType>* cpu, AddressingMode mode) {
+    int8_t offset = cpu->typedBus->read(cpu->PC++);
     if(cpu->P & NEGATIVE_FLAG) {
         cpu->stepCycles(1);
         if((cpu->PC & 0xFF00) != ((cpu->PC + offset) & 0xFF00)) {
@@ -227,15 +256,17 @@ static void BMI(CPU* cpu, AddressingMode mode) {
     cpu->stepCycles(1);
 }
 
-static void STA(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void STA(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode, false);
-    cpu->bus->write(address, cpu->A);
+    cpu->typedBus->write(address, cpu->A);
     cpu->stepCycles(1);
 }
 
-static void BIT(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void BIT(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode);
-    uint8_t data = cpu->bus->read(address);
+    uint8_t data = cpu->typedBus->read(address);
     cpu->P &= ~ZERO_FLAG;
     cpu->P &= ~NEGATIVE_FLAG;
     cpu->P &= ~OVERFLOW_FLAG;
@@ -251,22 +282,26 @@ static void BIT(CPU* cpu, AddressingMode mode) {
     cpu->stepCycles(1);
 }
 
-static void PHP(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void PHP(CPUCore<BusType>* cpu, AddressingMode mode) {
     cpu->pushByte(cpu->P | BREAK_FLAG | UNUSED_FLAG);
     cpu->stepCycles(2);
 }
 
-static void PLP(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void PLP(CPUCore<BusType>* cpu, AddressingMode mode) {
     cpu->P = (cpu->popByte() & 0xEF) | (cpu->P & 0x10) | 0x20;
     cpu->stepCycles(2);
 }
 
-static void PHA(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void PHA(CPUCore<BusType>* cpu, AddressingMode mode) {
     cpu->pushByte(cpu->A);
     cpu->stepCycles(2);
 }
 
-static void PLA(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void PLA(CPUCore<BusType>* cpu, AddressingMode mode) {
     cpu->A = cpu->popByte();
     cpu->P &= ~(ZERO_FLAG | NEGATIVE_FLAG);
     cpu->P |= (!cpu->A) * ZERO_FLAG;
@@ -280,24 +315,27 @@ static void PLA(CPU* cpu, AddressingMode mode) {
 //     cpu->stepCycles(1);
 // }
 
-static void RTI(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void RTI(CPUCore<BusType>* cpu, AddressingMode mode) {
     cpu->P = cpu->popByte();  // Pop status register
     cpu->P |= 0x20;           // Ensure unused bit is set
     cpu->PC = cpu->popWord(); // Restore PC
 }
 
-static void AND(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void AND(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode);
-    cpu->A &= cpu->bus->read(address);
+    cpu->A &= cpu->typedBus->read(address);
     cpu->P &= ~(ZERO_FLAG | NEGATIVE_FLAG);
     cpu->P |= (!cpu->A) * ZERO_FLAG;
     cpu->P |= (cpu->A & 0x80);
     cpu->stepCycles(1);
 }
 
-static void CMP(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void CMP(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode);
-    uint8_t data = cpu->bus->read(address);
+    uint8_t data = cpu->typedBus->read(address);
     uint16_t result = cpu->A - data;
     cpu->P &= ~ZERO_FLAG;
     cpu->P &= ~NEGATIVE_FLAG;
@@ -314,9 +352,10 @@ static void CMP(CPU* cpu, AddressingMode mode) {
     cpu->stepCycles(1);
 }
 
-static void CPX(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void CPX(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode);
-    uint8_t data = cpu->bus->read(address);
+    uint8_t data = cpu->typedBus->read(address);
     uint16_t result = cpu->X - data;
     cpu->P &= ~ZERO_FLAG;
     cpu->P &= ~NEGATIVE_FLAG;
@@ -333,9 +372,10 @@ static void CPX(CPU* cpu, AddressingMode mode) {
     cpu->stepCycles(1);
 }
 
-static void CPY(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void CPY(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode);
-    uint8_t data = cpu->bus->read(address);
+    uint8_t data = cpu->typedBus->read(address);
     uint16_t result = cpu->Y - data;
     cpu->P &= ~ZERO_FLAG;
     cpu->P &= ~NEGATIVE_FLAG;
@@ -352,18 +392,20 @@ static void CPY(CPU* cpu, AddressingMode mode) {
     cpu->stepCycles(1);
 }
 
-static void ORA(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void ORA(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode);
-    cpu->A |= cpu->bus->read(address);
+    cpu->A |= cpu->typedBus->read(address);
     cpu->P &= ~(ZERO_FLAG | NEGATIVE_FLAG);
     cpu->P |= (!cpu->A) * ZERO_FLAG;
     cpu->P |= (cpu->A & 0x80);
     cpu->stepCycles(1);
 }
 
-static void EOR(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void EOR(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode);
-    cpu->A ^= cpu->bus->read(address);
+    cpu->A ^= cpu->typedBus->read(address);
     cpu->P &= ~(ZERO_FLAG | NEGATIVE_FLAG);
     cpu->P |= (!cpu->A) * ZERO_FLAG;
     cpu->P |= (cpu->A & 0x80);
@@ -371,9 +413,10 @@ static void EOR(CPU* cpu, AddressingMode mode) {
 }
 
 // we will implement decimal mode later :3
-static void ADC(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void ADC(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode);
-    uint8_t data = cpu->bus->read(address);
+    uint8_t data = cpu->typedBus->read(address);
     uint16_t result = cpu->A + data + (cpu->P & CARRY_FLAG);
 
     if(cpu->P & DECIMAL_MODE_FLAG) {
@@ -405,9 +448,10 @@ static void ADC(CPU* cpu, AddressingMode mode) {
     cpu->stepCycles(1);
 }
 
-static void SBC(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void SBC(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode);
-    uint8_t data = cpu->bus->read(address);
+    uint8_t data = cpu->typedBus->read(address);
     uint16_t result = cpu->A - data - (1 - (cpu->P & CARRY_FLAG));
 
     if(cpu->P & DECIMAL_MODE_FLAG) {
@@ -439,17 +483,19 @@ static void SBC(CPU* cpu, AddressingMode mode) {
     cpu->stepCycles(1);
 }
 
-static void DEC(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void DEC(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode, true);
-    uint8_t data = cpu->bus->read(address) - 1;
-    cpu->bus->write(address, data);
+    uint8_t data = cpu->typedBus->read(address) - 1;
+    cpu->typedBus->write(address, data);
     cpu->P &= ~(ZERO_FLAG | NEGATIVE_FLAG);
     cpu->P |= (!data) * ZERO_FLAG;
     cpu->P |= (data & 0x80);
     cpu->stepCycles(2);
 }
 
-static void DEY(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void DEY(CPUCore<BusType>* cpu, AddressingMode mode) {
     cpu->Y -= 1;
     cpu->P &= ~(ZERO_FLAG | NEGATIVE_FLAG);
     cpu->P |= (!cpu->Y) * ZERO_FLAG;
@@ -457,7 +503,8 @@ static void DEY(CPU* cpu, AddressingMode mode) {
     cpu->stepCycles(1);
 }
 
-static void DEX(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void DEX(CPUCore<BusType>* cpu, AddressingMode mode) {
     cpu->X -= 1;
     cpu->P &= ~(ZERO_FLAG | NEGATIVE_FLAG);
     cpu->P |= (!cpu->X) * ZERO_FLAG;
@@ -465,17 +512,19 @@ static void DEX(CPU* cpu, AddressingMode mode) {
     cpu->stepCycles(1);
 }
 
-static void INC(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void INC(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode, true);
-    uint8_t data = cpu->bus->read(address) + 1;
-    cpu->bus->write(address, data);
+    uint8_t data = cpu->typedBus->read(address) + 1;
+    cpu->typedBus->write(address, data);
     cpu->P &= ~(ZERO_FLAG | NEGATIVE_FLAG);
     cpu->P |= (!data) * ZERO_FLAG;
     cpu->P |= (data & 0x80);
     cpu->stepCycles(2);
 }
 
-static void INY(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void INY(CPUCore<BusType>* cpu, AddressingMode mode) {
     cpu->Y += 1;
     cpu->P &= ~(ZERO_FLAG | NEGATIVE_FLAG);
     cpu->P |= (!cpu->Y) * ZERO_FLAG;
@@ -483,7 +532,8 @@ static void INY(CPU* cpu, AddressingMode mode) {
     cpu->stepCycles(1);
 }
 
-static void INX(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void INX(CPUCore<BusType>* cpu, AddressingMode mode) {
     cpu->X += 1;
     cpu->P &= ~(ZERO_FLAG | NEGATIVE_FLAG);
     cpu->P |= (!cpu->X) * ZERO_FLAG;
@@ -491,7 +541,8 @@ static void INX(CPU* cpu, AddressingMode mode) {
     cpu->stepCycles(1);
 }
 
-static void TAY(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void TAY(CPUCore<BusType>* cpu, AddressingMode mode) {
     cpu->Y = cpu->A;
     cpu->P &= ~(ZERO_FLAG | NEGATIVE_FLAG);
     cpu->P |= (!cpu->Y) * ZERO_FLAG;
@@ -499,7 +550,8 @@ static void TAY(CPU* cpu, AddressingMode mode) {
     cpu->stepCycles(1);
 }
 
-static void TAX(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void TAX(CPUCore<BusType>* cpu, AddressingMode mode) {
     cpu->X = cpu->A;
     cpu->P &= ~(ZERO_FLAG | NEGATIVE_FLAG);
     cpu->P |= (!cpu->X) * ZERO_FLAG;
@@ -507,7 +559,8 @@ static void TAX(CPU* cpu, AddressingMode mode) {
     cpu->stepCycles(1);
 }
 
-static void TSX(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void TSX(CPUCore<BusType>* cpu, AddressingMode mode) {
     cpu->X = cpu->SP;
     cpu->P &= ~(ZERO_FLAG | NEGATIVE_FLAG);
     cpu->P |= (!cpu->X) * ZERO_FLAG;
@@ -515,7 +568,8 @@ static void TSX(CPU* cpu, AddressingMode mode) {
     cpu->stepCycles(1);
 }
 
-static void TYA(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void TYA(CPUCore<BusType>* cpu, AddressingMode mode) {
     cpu->A = cpu->Y;
     cpu->P &= ~(ZERO_FLAG | NEGATIVE_FLAG);
     cpu->P |= (!cpu->A) * ZERO_FLAG;
@@ -523,7 +577,8 @@ static void TYA(CPU* cpu, AddressingMode mode) {
     cpu->stepCycles(1);
 }
 
-static void TXA(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void TXA(CPUCore<BusType>* cpu, AddressingMode mode) {
     cpu->A = cpu->X;
     cpu->P &= ~(ZERO_FLAG | NEGATIVE_FLAG);
     cpu->P |= (!cpu->A) * ZERO_FLAG;
@@ -531,12 +586,14 @@ static void TXA(CPU* cpu, AddressingMode mode) {
     cpu->stepCycles(1);
 }
 
-static void TXS(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void TXS(CPUCore<BusType>* cpu, AddressingMode mode) {
     cpu->SP = cpu->X;
     cpu->stepCycles(1);
 }
 
-static void LSR(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void LSR(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode, true);
     if(mode == AddressingMode::ACCUMULATOR) {
         cpu->P &= ~CARRY_FLAG;
@@ -555,7 +612,7 @@ static void LSR(CPU* cpu, AddressingMode mode) {
         cpu->stepCycles(2);
         return;
     }
-    uint8_t data = cpu->bus->read(address);
+    uint8_t data = cpu->typedBus->read(address);
     cpu->P &= ~CARRY_FLAG;
     cpu->P &= ~ZERO_FLAG;
     cpu->P &= ~NEGATIVE_FLAG;
@@ -569,11 +626,12 @@ static void LSR(CPU* cpu, AddressingMode mode) {
     if(data & 0x80) {
         cpu->P |= NEGATIVE_FLAG;
     }
-    cpu->bus->write(address, data);
+    cpu->typedBus->write(address, data);
     cpu->stepCycles(2);
 }
 
-static void ASL(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void ASL(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode, true);
     if(mode == AddressingMode::ACCUMULATOR) {
         cpu->P &= ~CARRY_FLAG;
@@ -592,7 +650,7 @@ static void ASL(CPU* cpu, AddressingMode mode) {
         cpu->stepCycles(2);
         return;
     }
-    uint8_t data = cpu->bus->read(address);
+    uint8_t data = cpu->typedBus->read(address);
     cpu->P &= ~CARRY_FLAG;
     cpu->P &= ~ZERO_FLAG;
     cpu->P &= ~NEGATIVE_FLAG;
@@ -606,11 +664,12 @@ static void ASL(CPU* cpu, AddressingMode mode) {
     if(data & 0x80) {
         cpu->P |= NEGATIVE_FLAG;
     }
-    cpu->bus->write(address, data);
+    cpu->typedBus->write(address, data);
     cpu->stepCycles(2);
 }
 
-static void ROR(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void ROR(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode, true);
     if(mode == AddressingMode::ACCUMULATOR) {
         uint8_t carry = cpu->P & CARRY_FLAG;
@@ -633,7 +692,7 @@ static void ROR(CPU* cpu, AddressingMode mode) {
         cpu->stepCycles(2);
         return;
     }
-    uint8_t data = cpu->bus->read(address);
+    uint8_t data = cpu->typedBus->read(address);
     uint8_t carry = cpu->P & CARRY_FLAG;
     cpu->P &= ~CARRY_FLAG;
     cpu->P &= ~ZERO_FLAG;
@@ -651,11 +710,12 @@ static void ROR(CPU* cpu, AddressingMode mode) {
     if(data & 0x80) {
         cpu->P |= NEGATIVE_FLAG;
     }
-    cpu->bus->write(address, data);
+    cpu->typedBus->write(address, data);
     cpu->stepCycles(2);
 }
 
-static void ROL(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void ROL(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode, true);
     if(mode == AddressingMode::ACCUMULATOR) {
         uint8_t carry = cpu->P & CARRY_FLAG;
@@ -678,7 +738,7 @@ static void ROL(CPU* cpu, AddressingMode mode) {
         cpu->stepCycles(2);
         return;
     }
-    uint8_t data = cpu->bus->read(address);
+    uint8_t data = cpu->typedBus->read(address);
     uint8_t carry = cpu->P & CARRY_FLAG;
     cpu->P &= ~CARRY_FLAG;
     cpu->P &= ~ZERO_FLAG;
@@ -696,33 +756,37 @@ static void ROL(CPU* cpu, AddressingMode mode) {
     if(data & 0x80) {
         cpu->P |= NEGATIVE_FLAG;
     }
-    cpu->bus->write(address, data);
+    cpu->typedBus->write(address, data);
     cpu->stepCycles(2);
 }
 
-static void BRK(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void BRK(CPUCore<BusType>* cpu, AddressingMode mode) {
     cpu->PC += 1;
     cpu->pushWord(cpu->PC);
     cpu->pushByte(cpu->P | BREAK_FLAG | UNUSED_FLAG);
     cpu->P |= INTERRUPT_DISABLE_FLAG;
-    cpu->PC = cpu->bus->readWord(0xFFFE);
+    cpu->PC = cpu->typedBus->readWord(0xFFFE);
     cpu->stepCycles(1);
 }
 
 // beware. illegal opcodes beyond!!!
-static void DOP(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void DOP(CPUCore<BusType>* cpu, AddressingMode mode) {
     cpu->getAddress(mode);
     cpu->stepCycles(1);
 }
 
-static void TOP(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void TOP(CPUCore<BusType>* cpu, AddressingMode mode) {
     cpu->getAddress(mode);
     cpu->stepCycles(1);
 }
 
-static void LAX(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void LAX(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode);
-    uint8_t data = cpu->bus->read(address);
+    uint8_t data = cpu->typedBus->read(address);
     cpu->A = data;
     cpu->X = data;
     cpu->P &= ~(ZERO_FLAG | NEGATIVE_FLAG);
@@ -731,17 +795,19 @@ static void LAX(CPU* cpu, AddressingMode mode) {
     cpu->stepCycles(1);
 }
 
-static void AAX(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void AAX(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode);
     uint8_t data = cpu->A & cpu->X;
-    cpu->bus->write(address, data);
+    cpu->typedBus->write(address, data);
     cpu->stepCycles(1);
 }
 
-static void DCP(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void DCP(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode);
-    uint8_t data = cpu->bus->read(address) - 1;
-    cpu->bus->write(address, data);
+    uint8_t data = cpu->typedBus->read(address) - 1;
+    cpu->typedBus->write(address, data);
     uint16_t result = cpu->A - data;
     cpu->P &= ~ZERO_FLAG;
     cpu->P &= ~NEGATIVE_FLAG;
@@ -758,10 +824,11 @@ static void DCP(CPU* cpu, AddressingMode mode) {
     cpu->stepCycles(3);
 }
 
-static void ISC(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void ISC(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode);
-    uint8_t data = cpu->bus->read(address) + 1;
-    cpu->bus->write(address, data);
+    uint8_t data = cpu->typedBus->read(address) + 1;
+    cpu->typedBus->write(address, data);
     uint16_t result = cpu->A - data - (1 - (cpu->P & CARRY_FLAG));
     cpu->P &= ~ZERO_FLAG;
     cpu->P &= ~NEGATIVE_FLAG;
@@ -783,9 +850,10 @@ static void ISC(CPU* cpu, AddressingMode mode) {
     cpu->stepCycles(3);
 }
 
-static void SLO(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void SLO(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode);
-    uint8_t data = cpu->bus->read(address);
+    uint8_t data = cpu->typedBus->read(address);
     cpu->P &= ~CARRY_FLAG;
     cpu->P &= ~ZERO_FLAG;
     cpu->P &= ~NEGATIVE_FLAG;
@@ -799,7 +867,7 @@ static void SLO(CPU* cpu, AddressingMode mode) {
     if(data & 0x80) {
         cpu->P |= NEGATIVE_FLAG;
     }
-    cpu->bus->write(address, data);
+    cpu->typedBus->write(address, data);
     cpu->A |= data;
 
     cpu->P &= ~ZERO_FLAG;
@@ -814,9 +882,10 @@ static void SLO(CPU* cpu, AddressingMode mode) {
     cpu->stepCycles(3);
 }
 
-static void RLA(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void RLA(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode);
-    uint8_t data = cpu->bus->read(address);
+    uint8_t data = cpu->typedBus->read(address);
     uint8_t carry = cpu->P & CARRY_FLAG;
     cpu->P &= ~CARRY_FLAG;
     cpu->P &= ~ZERO_FLAG;
@@ -834,7 +903,7 @@ static void RLA(CPU* cpu, AddressingMode mode) {
     if(data & 0x80) {
         cpu->P |= NEGATIVE_FLAG;
     }
-    cpu->bus->write(address, data);
+    cpu->typedBus->write(address, data);
     cpu->A &= data;
 
     cpu->P &= ~ZERO_FLAG;
@@ -849,9 +918,10 @@ static void RLA(CPU* cpu, AddressingMode mode) {
     cpu->stepCycles(3);
 }
 
-static void SRE(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void SRE(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode);
-    uint8_t data = cpu->bus->read(address);
+    uint8_t data = cpu->typedBus->read(address);
     cpu->P &= ~CARRY_FLAG;
     cpu->P &= ~ZERO_FLAG;
     cpu->P &= ~NEGATIVE_FLAG;
@@ -865,7 +935,7 @@ static void SRE(CPU* cpu, AddressingMode mode) {
     if(data & 0x80) {
         cpu->P |= NEGATIVE_FLAG;
     }
-    cpu->bus->write(address, data);
+    cpu->typedBus->write(address, data);
     cpu->A ^= data;
 
     cpu->P &= ~ZERO_FLAG;
@@ -880,9 +950,10 @@ static void SRE(CPU* cpu, AddressingMode mode) {
     cpu->stepCycles(3);
 }
 
-static void RRA(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void RRA(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode);
-    uint8_t data = cpu->bus->read(address);
+    uint8_t data = cpu->typedBus->read(address);
     uint8_t carry = cpu->P & CARRY_FLAG;
     cpu->P &= ~CARRY_FLAG;
     cpu->P &= ~ZERO_FLAG;
@@ -900,7 +971,7 @@ static void RRA(CPU* cpu, AddressingMode mode) {
     if(data & 0x80) {
         cpu->P |= NEGATIVE_FLAG;
     }
-    cpu->bus->write(address, data);
+    cpu->typedBus->write(address, data);
     uint16_t result = cpu->A + data + (cpu->P & CARRY_FLAG);
     cpu->P &= ~ZERO_FLAG;
     cpu->P &= ~NEGATIVE_FLAG;
@@ -923,9 +994,10 @@ static void RRA(CPU* cpu, AddressingMode mode) {
 }
 
 // probably not right but ok
-static void XAA(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void XAA(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode);
-    uint8_t data = cpu->bus->read(address);
+    uint8_t data = cpu->typedBus->read(address);
     cpu->A &= cpu->X & data;
     cpu->P &= ~(ZERO_FLAG | NEGATIVE_FLAG);
     cpu->P |= (!cpu->A) * ZERO_FLAG;
@@ -933,7 +1005,8 @@ static void XAA(CPU* cpu, AddressingMode mode) {
     cpu->stepCycles(1);
 }
 
-static void KIL(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void KIL(CPUCore<BusType>* cpu, AddressingMode mode) {
     cpu->PC -= 1;
     cpu->stepCycles(1);
 }
@@ -941,17 +1014,19 @@ static void KIL(CPU* cpu, AddressingMode mode) {
 // AND X register with accumulator and store result in stack pointer, then
 // AND stack pointer with the high byte of the target address of the
 // argument + 1. Store result in memory.
-static void XAS(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void XAS(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode);
     cpu->X = cpu->A & cpu->X;
     cpu->SP = cpu->X;
-    cpu->bus->write(address, cpu->SP & ((address >> 8) + 1));
+    cpu->typedBus->write(address, cpu->SP & ((address >> 8) + 1));
     cpu->stepCycles(2);
 }
 
-static void AAC(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void AAC(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode);
-    uint8_t data = cpu->bus->read(address);
+    uint8_t data = cpu->typedBus->read(address);
     cpu->A &= data;
     cpu->P &= ~(ZERO_FLAG | NEGATIVE_FLAG);
     cpu->P |= (!cpu->A) * ZERO_FLAG;
@@ -963,9 +1038,10 @@ static void AAC(CPU* cpu, AddressingMode mode) {
     cpu->stepCycles(1);
 }
 
-static void ASR(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void ASR(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode);
-    uint8_t data = cpu->bus->read(address);
+    uint8_t data = cpu->typedBus->read(address);
     cpu->A &= data;
     cpu->P &= ~(ZERO_FLAG | NEGATIVE_FLAG);
     cpu->P |= (!cpu->A) * ZERO_FLAG;
@@ -978,9 +1054,10 @@ static void ASR(CPU* cpu, AddressingMode mode) {
     cpu->stepCycles(1);
 }
 
-static void ARR(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void ARR(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode);
-    uint8_t data = cpu->bus->read(address);
+    uint8_t data = cpu->typedBus->read(address);
     cpu->A &= data;
     cpu->P &= ~CARRY_FLAG;
     cpu->P &= ~OVERFLOW_FLAG;
@@ -1003,27 +1080,31 @@ static void ARR(CPU* cpu, AddressingMode mode) {
 }
 
 // i dont think this is right
-static void SYA(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void SYA(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode);
-    cpu->bus->write(address, cpu->Y & ((address >> 8) + 1));
+    cpu->typedBus->write(address, cpu->Y & ((address >> 8) + 1));
     cpu->stepCycles(2);
 }
 
-static void AXA(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void AXA(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode);
-    cpu->bus->write(address, cpu->X & cpu->A & 0x07);
+    cpu->typedBus->write(address, cpu->X & cpu->A & 0x07);
     cpu->stepCycles(2);
 }
 
-static void SXA(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void SXA(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode);
-    cpu->bus->write(address, cpu->X & ((address >> 8) + 1));
+    cpu->typedBus->write(address, cpu->X & ((address >> 8) + 1));
     cpu->stepCycles(2);
 }
 
-static void ATX(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void ATX(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode);
-    uint8_t data = cpu->bus->read(address);
+    uint8_t data = cpu->typedBus->read(address);
     cpu->A &= data;
     cpu->X = cpu->A;
     cpu->P &= ~(ZERO_FLAG | NEGATIVE_FLAG);
@@ -1032,9 +1113,10 @@ static void ATX(CPU* cpu, AddressingMode mode) {
     cpu->stepCycles(1);
 }
 
-static void LAR(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void LAR(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode);
-    uint8_t data = cpu->bus->read(address);
+    uint8_t data = cpu->typedBus->read(address);
     cpu->A = cpu->X = cpu->SP = cpu->SP & data;
     cpu->P &= ~ZERO_FLAG;
     cpu->P &= ~NEGATIVE_FLAG;
@@ -1049,9 +1131,10 @@ static void LAR(CPU* cpu, AddressingMode mode) {
     cpu->stepCycles(1);
 }
 
-static void AXS(CPU* cpu, AddressingMode mode) {
+template<typename BusType>
+static void AXS(CPUCore<BusType>* cpu, AddressingMode mode) {
     uint16_t address = cpu->getAddress(mode);
-    uint8_t data = cpu->bus->read(address);
+    uint8_t data = cpu->typedBus->read(address);
     cpu->X = cpu->A & cpu->X;
     cpu->X -= data;
     cpu->P &= ~ZERO_FLAG;
@@ -1071,279 +1154,338 @@ static void AXS(CPU* cpu, AddressingMode mode) {
 
 CPU::CPU(Bus* bus) {
     this->bus = bus;
-
-    instructions.fill({unkownInstruction, AddressingMode::IMPLIED});
-
-    instructions[0x00] = {BRK, AddressingMode::IMPLIED};
-    instructions[0x01] = {ORA, AddressingMode::INDIRECT_X};
-    instructions[0x02] = {KIL, AddressingMode::IMPLIED};
-    instructions[0x03] = {SLO, AddressingMode::INDIRECT_X};
-    instructions[0x04] = {DOP, AddressingMode::ZERO_PAGE};
-    instructions[0x05] = {ORA, AddressingMode::ZERO_PAGE};
-    instructions[0x06] = {ASL, AddressingMode::ZERO_PAGE};
-    instructions[0x07] = {SLO, AddressingMode::ZERO_PAGE};
-    instructions[0x08] = {PHP, AddressingMode::IMPLIED};
-    instructions[0x09] = {ORA, AddressingMode::IMMEDIATE};
-    instructions[0x0A] = {ASL, AddressingMode::ACCUMULATOR};
-    instructions[0x0B] = {AAC, AddressingMode::IMMEDIATE};
-    instructions[0x0C] = {TOP, AddressingMode::ABSOLUTE};
-    instructions[0x0D] = {ORA, AddressingMode::ABSOLUTE};
-    instructions[0x0E] = {ASL, AddressingMode::ABSOLUTE};
-    instructions[0x0F] = {SLO, AddressingMode::ABSOLUTE};
-    instructions[0x10] = {BPL, AddressingMode::RELATIVE};
-    instructions[0x11] = {ORA, AddressingMode::INDIRECT_Y};
-    instructions[0x12] = {KIL, AddressingMode::IMPLIED};
-    instructions[0x13] = {SLO, AddressingMode::INDIRECT_Y};
-    instructions[0x14] = {DOP, AddressingMode::ZERO_PAGE_X};
-    instructions[0x15] = {ORA, AddressingMode::ZERO_PAGE_X};
-    instructions[0x16] = {ASL, AddressingMode::ZERO_PAGE_X};
-    instructions[0x17] = {SLO, AddressingMode::ZERO_PAGE_X};
-    instructions[0x18] = {CLC, AddressingMode::IMPLIED};
-    instructions[0x19] = {ORA, AddressingMode::ABSOLUTE_Y};
-    instructions[0x1A] = {NOP, AddressingMode::IMPLIED};
-    instructions[0x1B] = {SLO, AddressingMode::ABSOLUTE_Y};
-    instructions[0x1C] = {TOP, AddressingMode::ABSOLUTE_X};
-    instructions[0x1D] = {ORA, AddressingMode::ABSOLUTE_X};
-    instructions[0x1E] = {ASL, AddressingMode::ABSOLUTE_X};
-    instructions[0x1F] = {SLO, AddressingMode::ABSOLUTE_X};
-    instructions[0x20] = {JSR, AddressingMode::ABSOLUTE};
-    instructions[0x21] = {AND, AddressingMode::INDIRECT_X};
-    instructions[0x22] = {KIL, AddressingMode::IMPLIED};
-    instructions[0x23] = {RLA, AddressingMode::INDIRECT_X};
-    instructions[0x24] = {BIT, AddressingMode::ZERO_PAGE};
-    instructions[0x25] = {AND, AddressingMode::ZERO_PAGE};
-    instructions[0x26] = {ROL, AddressingMode::ZERO_PAGE};
-    instructions[0x27] = {RLA, AddressingMode::ZERO_PAGE};
-    instructions[0x28] = {PLP, AddressingMode::IMPLIED};
-    instructions[0x29] = {AND, AddressingMode::IMMEDIATE};
-    instructions[0x2A] = {ROL, AddressingMode::ACCUMULATOR};
-    instructions[0x2B] = {AAC, AddressingMode::IMMEDIATE};
-    instructions[0x2C] = {BIT, AddressingMode::ABSOLUTE};
-    instructions[0x2D] = {AND, AddressingMode::ABSOLUTE};
-    instructions[0x2E] = {ROL, AddressingMode::ABSOLUTE};
-    instructions[0x2F] = {RLA, AddressingMode::ABSOLUTE};
-    instructions[0x30] = {BMI, AddressingMode::RELATIVE};
-    instructions[0x31] = {AND, AddressingMode::INDIRECT_Y};
-    instructions[0x32] = {KIL, AddressingMode::IMPLIED};
-    instructions[0x33] = {RLA, AddressingMode::INDIRECT_Y};
-    instructions[0x34] = {DOP, AddressingMode::ZERO_PAGE_X};
-    instructions[0x35] = {AND, AddressingMode::ZERO_PAGE_X};
-    instructions[0x36] = {ROL, AddressingMode::ZERO_PAGE_X};
-    instructions[0x37] = {RLA, AddressingMode::ZERO_PAGE_X};
-    instructions[0x38] = {SEC, AddressingMode::IMPLIED};
-    instructions[0x39] = {AND, AddressingMode::ABSOLUTE_Y};
-    instructions[0x3A] = {NOP, AddressingMode::IMPLIED};
-    instructions[0x3B] = {RLA, AddressingMode::ABSOLUTE_Y};
-    instructions[0x3C] = {TOP, AddressingMode::ABSOLUTE_X};
-    instructions[0x3D] = {AND, AddressingMode::ABSOLUTE_X};
-    instructions[0x3E] = {ROL, AddressingMode::ABSOLUTE_X};
-    instructions[0x3F] = {RLA, AddressingMode::ABSOLUTE_X};
-    instructions[0x40] = {RTI, AddressingMode::IMPLIED};
-    instructions[0x41] = {EOR, AddressingMode::INDIRECT_X};
-    instructions[0x42] = {KIL, AddressingMode::IMPLIED};
-    instructions[0x43] = {SRE, AddressingMode::INDIRECT_X};
-    instructions[0x44] = {DOP, AddressingMode::ZERO_PAGE};
-    instructions[0x45] = {EOR, AddressingMode::ZERO_PAGE};
-    instructions[0x46] = {LSR, AddressingMode::ZERO_PAGE};
-    instructions[0x47] = {SRE, AddressingMode::ZERO_PAGE};
-    instructions[0x48] = {PHA, AddressingMode::IMPLIED};
-    instructions[0x49] = {EOR, AddressingMode::IMMEDIATE};
-    instructions[0x4A] = {LSR, AddressingMode::ACCUMULATOR};
-    instructions[0x4B] = {ASR, AddressingMode::IMMEDIATE};
-    instructions[0x4C] = {JMP, AddressingMode::ABSOLUTE};
-    instructions[0x4D] = {EOR, AddressingMode::ABSOLUTE};
-    instructions[0x4E] = {LSR, AddressingMode::ABSOLUTE};
-    instructions[0x4F] = {SRE, AddressingMode::ABSOLUTE};
-    instructions[0x50] = {BVC, AddressingMode::RELATIVE};
-    instructions[0x51] = {EOR, AddressingMode::INDIRECT_Y};
-    instructions[0x52] = {KIL, AddressingMode::IMPLIED};
-    instructions[0x53] = {SRE, AddressingMode::INDIRECT_Y};
-    instructions[0x54] = {DOP, AddressingMode::ZERO_PAGE_X};
-    instructions[0x55] = {EOR, AddressingMode::ZERO_PAGE_X};
-    instructions[0x56] = {LSR, AddressingMode::ZERO_PAGE_X};
-    instructions[0x57] = {SRE, AddressingMode::ZERO_PAGE_X};
-    instructions[0x58] = {CLI, AddressingMode::IMPLIED};
-    instructions[0x59] = {EOR, AddressingMode::ABSOLUTE_Y};
-    instructions[0x5A] = {NOP, AddressingMode::IMPLIED};
-    instructions[0x5B] = {SRE, AddressingMode::ABSOLUTE_Y};
-    instructions[0x5C] = {TOP, AddressingMode::ABSOLUTE_X};
-    instructions[0x5D] = {EOR, AddressingMode::ABSOLUTE_X};
-    instructions[0x5E] = {LSR, AddressingMode::ABSOLUTE_X};
-    instructions[0x5F] = {SRE, AddressingMode::ABSOLUTE_X};
-    instructions[0x60] = {RTS, AddressingMode::IMPLIED};
-    instructions[0x61] = {ADC, AddressingMode::INDIRECT_X};
-    instructions[0x62] = {KIL, AddressingMode::IMPLIED};
-    instructions[0x63] = {RRA, AddressingMode::INDIRECT_X};
-    instructions[0x64] = {DOP, AddressingMode::ZERO_PAGE};
-    instructions[0x65] = {ADC, AddressingMode::ZERO_PAGE};
-    instructions[0x66] = {ROR, AddressingMode::ZERO_PAGE};
-    instructions[0x67] = {RRA, AddressingMode::ZERO_PAGE};
-    instructions[0x68] = {PLA, AddressingMode::IMPLIED};
-    instructions[0x69] = {ADC, AddressingMode::IMMEDIATE};
-    instructions[0x6A] = {ROR, AddressingMode::ACCUMULATOR};
-    instructions[0x6B] = {ARR, AddressingMode::IMMEDIATE};
-    instructions[0x6C] = {JMP, AddressingMode::INDIRECT};
-    instructions[0x6D] = {ADC, AddressingMode::ABSOLUTE};
-    instructions[0x6E] = {ROR, AddressingMode::ABSOLUTE};
-    instructions[0x6F] = {RRA, AddressingMode::ABSOLUTE};
-    instructions[0x70] = {BVS, AddressingMode::RELATIVE};
-    instructions[0x71] = {ADC, AddressingMode::INDIRECT_Y};
-    instructions[0x72] = {KIL, AddressingMode::IMPLIED};
-    instructions[0x73] = {RRA, AddressingMode::INDIRECT_Y};
-    instructions[0x74] = {DOP, AddressingMode::ZERO_PAGE_X};
-    instructions[0x75] = {ADC, AddressingMode::ZERO_PAGE_X};
-    instructions[0x76] = {ROR, AddressingMode::ZERO_PAGE_X};
-    instructions[0x77] = {RRA, AddressingMode::ZERO_PAGE_X};
-    instructions[0x78] = {SEI, AddressingMode::IMPLIED};
-    instructions[0x79] = {ADC, AddressingMode::ABSOLUTE_Y};
-    instructions[0x7A] = {NOP, AddressingMode::IMPLIED};
-    instructions[0x7B] = {RRA, AddressingMode::ABSOLUTE_Y};
-    instructions[0x7C] = {TOP, AddressingMode::ABSOLUTE_X};
-    instructions[0x7D] = {ADC, AddressingMode::ABSOLUTE_X};
-    instructions[0x7E] = {ROR, AddressingMode::ABSOLUTE_X};
-    instructions[0x7F] = {RRA, AddressingMode::ABSOLUTE_X};
-    instructions[0x80] = {DOP, AddressingMode::IMMEDIATE};
-    instructions[0x81] = {STA, AddressingMode::INDIRECT_X};
-    instructions[0x82] = {DOP, AddressingMode::IMMEDIATE};
-    instructions[0x83] = {AAX, AddressingMode::INDIRECT_X};
-    instructions[0x84] = {STY, AddressingMode::ZERO_PAGE};
-    instructions[0x85] = {STA, AddressingMode::ZERO_PAGE};
-    instructions[0x86] = {STX, AddressingMode::ZERO_PAGE};
-    instructions[0x87] = {AAX, AddressingMode::ZERO_PAGE};
-    instructions[0x88] = {DEY, AddressingMode::IMPLIED};
-    instructions[0x89] = {DOP, AddressingMode::IMMEDIATE};
-    instructions[0x8A] = {TXA, AddressingMode::IMPLIED};
-    instructions[0x8B] = {XAA, AddressingMode::IMMEDIATE};
-    instructions[0x8C] = {STY, AddressingMode::ABSOLUTE};
-    instructions[0x8D] = {STA, AddressingMode::ABSOLUTE};
-    instructions[0x8E] = {STX, AddressingMode::ABSOLUTE};
-    instructions[0x8F] = {AAX, AddressingMode::ABSOLUTE};
-    instructions[0x90] = {BCC, AddressingMode::RELATIVE};
-    instructions[0x91] = {STA, AddressingMode::INDIRECT_Y};
-    instructions[0x92] = {KIL, AddressingMode::IMPLIED};
-    instructions[0x93] = {AXA, AddressingMode::INDIRECT_Y};
-    instructions[0x94] = {STY, AddressingMode::ZERO_PAGE_X};
-    instructions[0x95] = {STA, AddressingMode::ZERO_PAGE_X};
-    instructions[0x96] = {STX, AddressingMode::ZERO_PAGE_Y};
-    instructions[0x97] = {AAX, AddressingMode::ZERO_PAGE_Y};
-    instructions[0x98] = {TYA, AddressingMode::IMPLIED};
-    instructions[0x99] = {STA, AddressingMode::ABSOLUTE_Y};
-    instructions[0x9A] = {TXS, AddressingMode::IMPLIED};
-    instructions[0x9B] = {XAS, AddressingMode::ABSOLUTE_Y};
-    instructions[0x9C] = {SYA, AddressingMode::ABSOLUTE_X};
-    instructions[0x9D] = {STA, AddressingMode::ABSOLUTE_X};
-    instructions[0x9E] = {SXA, AddressingMode::ABSOLUTE_Y};
-    instructions[0x9F] = {AXA, AddressingMode::ABSOLUTE_Y};
-    instructions[0xA0] = {LDY, AddressingMode::IMMEDIATE};
-    instructions[0xA1] = {LDA, AddressingMode::INDIRECT_X};
-    instructions[0xA2] = {LDX, AddressingMode::IMMEDIATE};
-    instructions[0xA3] = {LAX, AddressingMode::INDIRECT_X};
-    instructions[0xA4] = {LDY, AddressingMode::ZERO_PAGE};
-    instructions[0xA5] = {LDA, AddressingMode::ZERO_PAGE};
-    instructions[0xA6] = {LDX, AddressingMode::ZERO_PAGE};
-    instructions[0xA7] = {LAX, AddressingMode::ZERO_PAGE};
-    instructions[0xA8] = {TAY, AddressingMode::IMPLIED};
-    instructions[0xA9] = {LDA, AddressingMode::IMMEDIATE};
-    instructions[0xAA] = {TAX, AddressingMode::IMPLIED};
-    instructions[0xAB] = {ATX, AddressingMode::IMMEDIATE};
-    instructions[0xAC] = {LDY, AddressingMode::ABSOLUTE};
-    instructions[0xAD] = {LDA, AddressingMode::ABSOLUTE};
-    instructions[0xAE] = {LDX, AddressingMode::ABSOLUTE};
-    instructions[0xAF] = {LAX, AddressingMode::ABSOLUTE};
-    instructions[0xB0] = {BCS, AddressingMode::RELATIVE};
-    instructions[0xB1] = {LDA, AddressingMode::INDIRECT_Y};
-    instructions[0xB2] = {KIL, AddressingMode::IMPLIED};
-    instructions[0xB3] = {LAX, AddressingMode::INDIRECT_Y};
-    instructions[0xB4] = {LDY, AddressingMode::ZERO_PAGE_X};
-    instructions[0xB5] = {LDA, AddressingMode::ZERO_PAGE_X};
-    instructions[0xB6] = {LDX, AddressingMode::ZERO_PAGE_Y};
-    instructions[0xB7] = {LAX, AddressingMode::ZERO_PAGE_Y};
-    instructions[0xB8] = {CLV, AddressingMode::IMPLIED};
-    instructions[0xB9] = {LDA, AddressingMode::ABSOLUTE_Y};
-    instructions[0xBA] = {TSX, AddressingMode::IMPLIED};
-    instructions[0xBB] = {LAR, AddressingMode::ABSOLUTE_Y};
-    instructions[0xBC] = {LDY, AddressingMode::ABSOLUTE_X};
-    instructions[0xBD] = {LDA, AddressingMode::ABSOLUTE_X};
-    instructions[0xBE] = {LDX, AddressingMode::ABSOLUTE_Y};
-    instructions[0xBF] = {LAX, AddressingMode::ABSOLUTE_Y};
-    instructions[0xC0] = {CPY, AddressingMode::IMMEDIATE};
-    instructions[0xC1] = {CMP, AddressingMode::INDIRECT_X};
-    instructions[0xC2] = {DOP, AddressingMode::IMMEDIATE};
-    instructions[0xC3] = {DCP, AddressingMode::INDIRECT_X};
-    instructions[0xC4] = {CPY, AddressingMode::ZERO_PAGE};
-    instructions[0xC5] = {CMP, AddressingMode::ZERO_PAGE};
-    instructions[0xC6] = {DEC, AddressingMode::ZERO_PAGE};
-    instructions[0xC7] = {DCP, AddressingMode::ZERO_PAGE};
-    instructions[0xC8] = {INY, AddressingMode::IMPLIED};
-    instructions[0xC9] = {CMP, AddressingMode::IMMEDIATE};
-    instructions[0xCA] = {DEX, AddressingMode::IMPLIED};
-    instructions[0xCB] = {AXS, AddressingMode::IMMEDIATE};
-    instructions[0xCC] = {CPY, AddressingMode::ABSOLUTE};
-    instructions[0xCD] = {CMP, AddressingMode::ABSOLUTE};
-    instructions[0xCE] = {DEC, AddressingMode::ABSOLUTE};
-    instructions[0xCF] = {DCP, AddressingMode::ABSOLUTE};
-    instructions[0xD0] = {BNE, AddressingMode::RELATIVE};
-    instructions[0xD1] = {CMP, AddressingMode::INDIRECT_Y};
-    instructions[0xD2] = {KIL, AddressingMode::IMPLIED};
-    instructions[0xD3] = {DCP, AddressingMode::INDIRECT_Y};
-    instructions[0xD4] = {DOP, AddressingMode::ZERO_PAGE_X};
-    instructions[0xD5] = {CMP, AddressingMode::ZERO_PAGE_X};
-    instructions[0xD6] = {DEC, AddressingMode::ZERO_PAGE_X};
-    instructions[0xD7] = {DCP, AddressingMode::ZERO_PAGE_X};
-    instructions[0xD8] = {CLD, AddressingMode::IMPLIED};
-    instructions[0xD9] = {CMP, AddressingMode::ABSOLUTE_Y};
-    instructions[0xDA] = {NOP, AddressingMode::IMPLIED};
-    instructions[0xDB] = {DCP, AddressingMode::ABSOLUTE_Y};
-    instructions[0xDC] = {TOP, AddressingMode::ABSOLUTE_X};
-    instructions[0xDD] = {CMP, AddressingMode::ABSOLUTE_X};
-    instructions[0xDE] = {DEC, AddressingMode::ABSOLUTE_X};
-    instructions[0xDF] = {DCP, AddressingMode::ABSOLUTE_X};
-    instructions[0xE0] = {CPX, AddressingMode::IMMEDIATE};
-    instructions[0xE1] = {SBC, AddressingMode::INDIRECT_X};
-    instructions[0xE2] = {DOP, AddressingMode::IMMEDIATE};
-    instructions[0xE3] = {ISC, AddressingMode::INDIRECT_X};
-    instructions[0xE4] = {CPX, AddressingMode::ZERO_PAGE};
-    instructions[0xE5] = {SBC, AddressingMode::ZERO_PAGE};
-    instructions[0xE6] = {INC, AddressingMode::ZERO_PAGE};
-    instructions[0xE7] = {ISC, AddressingMode::ZERO_PAGE};
-    instructions[0xE8] = {INX, AddressingMode::IMPLIED};
-    instructions[0xE9] = {SBC, AddressingMode::IMMEDIATE};
-    instructions[0xEA] = {NOP, AddressingMode::IMPLIED};
-    instructions[0xEB] = {SBC, AddressingMode::IMMEDIATE};
-    instructions[0xEC] = {CPX, AddressingMode::ABSOLUTE};
-    instructions[0xED] = {SBC, AddressingMode::ABSOLUTE};
-    instructions[0xEE] = {INC, AddressingMode::ABSOLUTE};
-    instructions[0xEF] = {ISC, AddressingMode::ABSOLUTE};
-    instructions[0xF0] = {BEQ, AddressingMode::RELATIVE};
-    instructions[0xF1] = {SBC, AddressingMode::INDIRECT_Y};
-    instructions[0xF2] = {KIL, AddressingMode::IMPLIED};
-    instructions[0xF3] = {ISC, AddressingMode::INDIRECT_Y};
-    instructions[0xF4] = {DOP, AddressingMode::ZERO_PAGE_X};
-    instructions[0xF5] = {SBC, AddressingMode::ZERO_PAGE_X};
-    instructions[0xF6] = {INC, AddressingMode::ZERO_PAGE_X};
-    instructions[0xF7] = {ISC, AddressingMode::ZERO_PAGE_X};
-    instructions[0xF8] = {SED, AddressingMode::IMPLIED};
-    instructions[0xF9] = {SBC, AddressingMode::ABSOLUTE_Y};
-    instructions[0xFA] = {NOP, AddressingMode::IMPLIED};
-    instructions[0xFB] = {ISC, AddressingMode::ABSOLUTE_Y};
-    instructions[0xFC] = {TOP, AddressingMode::ABSOLUTE_X};
-    instructions[0xFD] = {SBC, AddressingMode::ABSOLUTE_X};
-    instructions[0xFE] = {INC, AddressingMode::ABSOLUTE_X};
-    instructions[0xFF] = {ISC, AddressingMode::ABSOLUTE_X};
 }
 
 CPU::~CPU() {
+    delete trace;
 }
 
-void CPU::triggerIRQ() {
-    irqPending = true;
+template<typename BusType>
+struct InstructionTable {
+    std::array<void (*)(CPUCore<BusType>*, AddressingMode), 256> functions;
+    std::array<AddressingMode, 256> modes;
+};
+
+template<typename BusType>
+static InstructionTable<BusType> buildInstructionTable() {
+    std::array<std::tuple<void (*)(CPUCore<BusType>*, AddressingMode), AddressingMode>, 256> table;
+    table.fill({unkownInstruction, AddressingMode::IMPLIED});
+
+    table[0x00] = {BRK, AddressingMode::IMPLIED};
+    table[0x01] = {ORA, AddressingMode::INDIRECT_X};
+    table[0x02] = {KIL, AddressingMode::IMPLIED};
+    table[0x03] = {SLO, AddressingMode::INDIRECT_X};
+    table[0x04] = {DOP, AddressingMode::ZERO_PAGE};
+    table[0x05] = {ORA, AddressingMode::ZERO_PAGE};
+    table[0x06] = {ASL, AddressingMode::ZERO_PAGE};
+    table[0x07] = {SLO, AddressingMode::ZERO_PAGE};
+    table[0x08] = {PHP, AddressingMode::IMPLIED};
+    table[0x09] = {ORA, AddressingMode::IMMEDIATE};
+    table[0x0A] = {ASL, AddressingMode::ACCUMULATOR};
+    table[0x0B] = {AAC, AddressingMode::IMMEDIATE};
+    table[0x0C] = {TOP, AddressingMode::ABSOLUTE};
+    table[0x0D] = {ORA, AddressingMode::ABSOLUTE};
+    table[0x0E] = {ASL, AddressingMode::ABSOLUTE};
+    table[0x0F] = {SLO, AddressingMode::ABSOLUTE};
+    table[0x10] = {BPL, AddressingMode::RELATIVE};
+    table[0x11] = {ORA, AddressingMode::INDIRECT_Y};
+    table[0x12] = {KIL, AddressingMode::IMPLIED};
+    table[0x13] = {SLO, AddressingMode::INDIRECT_Y};
+    table[0x14] = {DOP, AddressingMode::ZERO_PAGE_X};
+    table[0x15] = {ORA, AddressingMode::ZERO_PAGE_X};
+    table[0x16] = {ASL, AddressingMode::ZERO_PAGE_X};
+    table[0x17] = {SLO, AddressingMode::ZERO_PAGE_X};
+    table[0x18] = {CLC, AddressingMode::IMPLIED};
+    table[0x19] = {ORA, AddressingMode::ABSOLUTE_Y};
+    table[0x1A] = {NOP, AddressingMode::IMPLIED};
+    table[0x1B] = {SLO, AddressingMode::ABSOLUTE_Y};
+    table[0x1C] = {TOP, AddressingMode::ABSOLUTE_X};
+    table[0x1D] = {ORA, AddressingMode::ABSOLUTE_X};
+    table[0x1E] = {ASL, AddressingMode::ABSOLUTE_X};
+    table[0x1F] = {SLO, AddressingMode::ABSOLUTE_X};
+    table[0x20] = {JSR, AddressingMode::ABSOLUTE};
+    table[0x21] = {AND, AddressingMode::INDIRECT_X};
+    table[0x22] = {KIL, AddressingMode::IMPLIED};
+    table[0x23] = {RLA, AddressingMode::INDIRECT_X};
+    table[0x24] = {BIT, AddressingMode::ZERO_PAGE};
+    table[0x25] = {AND, AddressingMode::ZERO_PAGE};
+    table[0x26] = {ROL, AddressingMode::ZERO_PAGE};
+    table[0x27] = {RLA, AddressingMode::ZERO_PAGE};
+    table[0x28] = {PLP, AddressingMode::IMPLIED};
+    table[0x29] = {AND, AddressingMode::IMMEDIATE};
+    table[0x2A] = {ROL, AddressingMode::ACCUMULATOR};
+    table[0x2B] = {AAC, AddressingMode::IMMEDIATE};
+    table[0x2C] = {BIT, AddressingMode::ABSOLUTE};
+    table[0x2D] = {AND, AddressingMode::ABSOLUTE};
+    table[0x2E] = {ROL, AddressingMode::ABSOLUTE};
+    table[0x2F] = {RLA, AddressingMode::ABSOLUTE};
+    table[0x30] = {BMI, AddressingMode::RELATIVE};
+    table[0x31] = {AND, AddressingMode::INDIRECT_Y};
+    table[0x32] = {KIL, AddressingMode::IMPLIED};
+    table[0x33] = {RLA, AddressingMode::INDIRECT_Y};
+    table[0x34] = {DOP, AddressingMode::ZERO_PAGE_X};
+    table[0x35] = {AND, AddressingMode::ZERO_PAGE_X};
+    table[0x36] = {ROL, AddressingMode::ZERO_PAGE_X};
+    table[0x37] = {RLA, AddressingMode::ZERO_PAGE_X};
+    table[0x38] = {SEC, AddressingMode::IMPLIED};
+    table[0x39] = {AND, AddressingMode::ABSOLUTE_Y};
+    table[0x3A] = {NOP, AddressingMode::IMPLIED};
+    table[0x3B] = {RLA, AddressingMode::ABSOLUTE_Y};
+    table[0x3C] = {TOP, AddressingMode::ABSOLUTE_X};
+    table[0x3D] = {AND, AddressingMode::ABSOLUTE_X};
+    table[0x3E] = {ROL, AddressingMode::ABSOLUTE_X};
+    table[0x3F] = {RLA, AddressingMode::ABSOLUTE_X};
+    table[0x40] = {RTI, AddressingMode::IMPLIED};
+    table[0x41] = {EOR, AddressingMode::INDIRECT_X};
+    table[0x42] = {KIL, AddressingMode::IMPLIED};
+    table[0x43] = {SRE, AddressingMode::INDIRECT_X};
+    table[0x44] = {DOP, AddressingMode::ZERO_PAGE};
+    table[0x45] = {EOR, AddressingMode::ZERO_PAGE};
+    table[0x46] = {LSR, AddressingMode::ZERO_PAGE};
+    table[0x47] = {SRE, AddressingMode::ZERO_PAGE};
+    table[0x48] = {PHA, AddressingMode::IMPLIED};
+    table[0x49] = {EOR, AddressingMode::IMMEDIATE};
+    table[0x4A] = {LSR, AddressingMode::ACCUMULATOR};
+    table[0x4B] = {ASR, AddressingMode::IMMEDIATE};
+    table[0x4C] = {JMP, AddressingMode::ABSOLUTE};
+    table[0x4D] = {EOR, AddressingMode::ABSOLUTE};
+    table[0x4E] = {LSR, AddressingMode::ABSOLUTE};
+    table[0x4F] = {SRE, AddressingMode::ABSOLUTE};
+    table[0x50] = {BVC, AddressingMode::RELATIVE};
+    table[0x51] = {EOR, AddressingMode::INDIRECT_Y};
+    table[0x52] = {KIL, AddressingMode::IMPLIED};
+    table[0x53] = {SRE, AddressingMode::INDIRECT_Y};
+    table[0x54] = {DOP, AddressingMode::ZERO_PAGE_X};
+    table[0x55] = {EOR, AddressingMode::ZERO_PAGE_X};
+    table[0x56] = {LSR, AddressingMode::ZERO_PAGE_X};
+    table[0x57] = {SRE, AddressingMode::ZERO_PAGE_X};
+    table[0x58] = {CLI, AddressingMode::IMPLIED};
+    table[0x59] = {EOR, AddressingMode::ABSOLUTE_Y};
+    table[0x5A] = {NOP, AddressingMode::IMPLIED};
+    table[0x5B] = {SRE, AddressingMode::ABSOLUTE_Y};
+    table[0x5C] = {TOP, AddressingMode::ABSOLUTE_X};
+    table[0x5D] = {EOR, AddressingMode::ABSOLUTE_X};
+    table[0x5E] = {LSR, AddressingMode::ABSOLUTE_X};
+    table[0x5F] = {SRE, AddressingMode::ABSOLUTE_X};
+    table[0x60] = {RTS, AddressingMode::IMPLIED};
+    table[0x61] = {ADC, AddressingMode::INDIRECT_X};
+    table[0x62] = {KIL, AddressingMode::IMPLIED};
+    table[0x63] = {RRA, AddressingMode::INDIRECT_X};
+    table[0x64] = {DOP, AddressingMode::ZERO_PAGE};
+    table[0x65] = {ADC, AddressingMode::ZERO_PAGE};
+    table[0x66] = {ROR, AddressingMode::ZERO_PAGE};
+    table[0x67] = {RRA, AddressingMode::ZERO_PAGE};
+    table[0x68] = {PLA, AddressingMode::IMPLIED};
+    table[0x69] = {ADC, AddressingMode::IMMEDIATE};
+    table[0x6A] = {ROR, AddressingMode::ACCUMULATOR};
+    table[0x6B] = {ARR, AddressingMode::IMMEDIATE};
+    table[0x6C] = {JMP, AddressingMode::INDIRECT};
+    table[0x6D] = {ADC, AddressingMode::ABSOLUTE};
+    table[0x6E] = {ROR, AddressingMode::ABSOLUTE};
+    table[0x6F] = {RRA, AddressingMode::ABSOLUTE};
+    table[0x70] = {BVS, AddressingMode::RELATIVE};
+    table[0x71] = {ADC, AddressingMode::INDIRECT_Y};
+    table[0x72] = {KIL, AddressingMode::IMPLIED};
+    table[0x73] = {RRA, AddressingMode::INDIRECT_Y};
+    table[0x74] = {DOP, AddressingMode::ZERO_PAGE_X};
+    table[0x75] = {ADC, AddressingMode::ZERO_PAGE_X};
+    table[0x76] = {ROR, AddressingMode::ZERO_PAGE_X};
+    table[0x77] = {RRA, AddressingMode::ZERO_PAGE_X};
+    table[0x78] = {SEI, AddressingMode::IMPLIED};
+    table[0x79] = {ADC, AddressingMode::ABSOLUTE_Y};
+    table[0x7A] = {NOP, AddressingMode::IMPLIED};
+    table[0x7B] = {RRA, AddressingMode::ABSOLUTE_Y};
+    table[0x7C] = {TOP, AddressingMode::ABSOLUTE_X};
+    table[0x7D] = {ADC, AddressingMode::ABSOLUTE_X};
+    table[0x7E] = {ROR, AddressingMode::ABSOLUTE_X};
+    table[0x7F] = {RRA, AddressingMode::ABSOLUTE_X};
+    table[0x80] = {DOP, AddressingMode::IMMEDIATE};
+    table[0x81] = {STA, AddressingMode::INDIRECT_X};
+    table[0x82] = {DOP, AddressingMode::IMMEDIATE};
+    table[0x83] = {AAX, AddressingMode::INDIRECT_X};
+    table[0x84] = {STY, AddressingMode::ZERO_PAGE};
+    table[0x85] = {STA, AddressingMode::ZERO_PAGE};
+    table[0x86] = {STX, AddressingMode::ZERO_PAGE};
+    table[0x87] = {AAX, AddressingMode::ZERO_PAGE};
+    table[0x88] = {DEY, AddressingMode::IMPLIED};
+    table[0x89] = {DOP, AddressingMode::IMMEDIATE};
+    table[0x8A] = {TXA, AddressingMode::IMPLIED};
+    table[0x8B] = {XAA, AddressingMode::IMMEDIATE};
+    table[0x8C] = {STY, AddressingMode::ABSOLUTE};
+    table[0x8D] = {STA, AddressingMode::ABSOLUTE};
+    table[0x8E] = {STX, AddressingMode::ABSOLUTE};
+    table[0x8F] = {AAX, AddressingMode::ABSOLUTE};
+    table[0x90] = {BCC, AddressingMode::RELATIVE};
+    table[0x91] = {STA, AddressingMode::INDIRECT_Y};
+    table[0x92] = {KIL, AddressingMode::IMPLIED};
+    table[0x93] = {AXA, AddressingMode::INDIRECT_Y};
+    table[0x94] = {STY, AddressingMode::ZERO_PAGE_X};
+    table[0x95] = {STA, AddressingMode::ZERO_PAGE_X};
+    table[0x96] = {STX, AddressingMode::ZERO_PAGE_Y};
+    table[0x97] = {AAX, AddressingMode::ZERO_PAGE_Y};
+    table[0x98] = {TYA, AddressingMode::IMPLIED};
+    table[0x99] = {STA, AddressingMode::ABSOLUTE_Y};
+    table[0x9A] = {TXS, AddressingMode::IMPLIED};
+    table[0x9B] = {XAS, AddressingMode::ABSOLUTE_Y};
+    table[0x9C] = {SYA, AddressingMode::ABSOLUTE_X};
+    table[0x9D] = {STA, AddressingMode::ABSOLUTE_X};
+    table[0x9E] = {SXA, AddressingMode::ABSOLUTE_Y};
+    table[0x9F] = {AXA, AddressingMode::ABSOLUTE_Y};
+    table[0xA0] = {LDY, AddressingMode::IMMEDIATE};
+    table[0xA1] = {LDA, AddressingMode::INDIRECT_X};
+    table[0xA2] = {LDX, AddressingMode::IMMEDIATE};
+    table[0xA3] = {LAX, AddressingMode::INDIRECT_X};
+    table[0xA4] = {LDY, AddressingMode::ZERO_PAGE};
+    table[0xA5] = {LDA, AddressingMode::ZERO_PAGE};
+    table[0xA6] = {LDX, AddressingMode::ZERO_PAGE};
+    table[0xA7] = {LAX, AddressingMode::ZERO_PAGE};
+    table[0xA8] = {TAY, AddressingMode::IMPLIED};
+    table[0xA9] = {LDA, AddressingMode::IMMEDIATE};
+    table[0xAA] = {TAX, AddressingMode::IMPLIED};
+    table[0xAB] = {ATX, AddressingMode::IMMEDIATE};
+    table[0xAC] = {LDY, AddressingMode::ABSOLUTE};
+    table[0xAD] = {LDA, AddressingMode::ABSOLUTE};
+    table[0xAE] = {LDX, AddressingMode::ABSOLUTE};
+    table[0xAF] = {LAX, AddressingMode::ABSOLUTE};
+    table[0xB0] = {BCS, AddressingMode::RELATIVE};
+    table[0xB1] = {LDA, AddressingMode::INDIRECT_Y};
+    table[0xB2] = {KIL, AddressingMode::IMPLIED};
+    table[0xB3] = {LAX, AddressingMode::INDIRECT_Y};
+    table[0xB4] = {LDY, AddressingMode::ZERO_PAGE_X};
+    table[0xB5] = {LDA, AddressingMode::ZERO_PAGE_X};
+    table[0xB6] = {LDX, AddressingMode::ZERO_PAGE_Y};
+    table[0xB7] = {LAX, AddressingMode::ZERO_PAGE_Y};
+    table[0xB8] = {CLV, AddressingMode::IMPLIED};
+    table[0xB9] = {LDA, AddressingMode::ABSOLUTE_Y};
+    table[0xBA] = {TSX, AddressingMode::IMPLIED};
+    table[0xBB] = {LAR, AddressingMode::ABSOLUTE_Y};
+    table[0xBC] = {LDY, AddressingMode::ABSOLUTE_X};
+    table[0xBD] = {LDA, AddressingMode::ABSOLUTE_X};
+    table[0xBE] = {LDX, AddressingMode::ABSOLUTE_Y};
+    table[0xBF] = {LAX, AddressingMode::ABSOLUTE_Y};
+    table[0xC0] = {CPY, AddressingMode::IMMEDIATE};
+    table[0xC1] = {CMP, AddressingMode::INDIRECT_X};
+    table[0xC2] = {DOP, AddressingMode::IMMEDIATE};
+    table[0xC3] = {DCP, AddressingMode::INDIRECT_X};
+    table[0xC4] = {CPY, AddressingMode::ZERO_PAGE};
+    table[0xC5] = {CMP, AddressingMode::ZERO_PAGE};
+    table[0xC6] = {DEC, AddressingMode::ZERO_PAGE};
+    table[0xC7] = {DCP, AddressingMode::ZERO_PAGE};
+    table[0xC8] = {INY, AddressingMode::IMPLIED};
+    table[0xC9] = {CMP, AddressingMode::IMMEDIATE};
+    table[0xCA] = {DEX, AddressingMode::IMPLIED};
+    table[0xCB] = {AXS, AddressingMode::IMMEDIATE};
+    table[0xCC] = {CPY, AddressingMode::ABSOLUTE};
+    table[0xCD] = {CMP, AddressingMode::ABSOLUTE};
+    table[0xCE] = {DEC, AddressingMode::ABSOLUTE};
+    table[0xCF] = {DCP, AddressingMode::ABSOLUTE};
+    table[0xD0] = {BNE, AddressingMode::RELATIVE};
+    table[0xD1] = {CMP, AddressingMode::INDIRECT_Y};
+    table[0xD2] = {KIL, AddressingMode::IMPLIED};
+    table[0xD3] = {DCP, AddressingMode::INDIRECT_Y};
+    table[0xD4] = {DOP, AddressingMode::ZERO_PAGE_X};
+    table[0xD5] = {CMP, AddressingMode::ZERO_PAGE_X};
+    table[0xD6] = {DEC, AddressingMode::ZERO_PAGE_X};
+    table[0xD7] = {DCP, AddressingMode::ZERO_PAGE_X};
+    table[0xD8] = {CLD, AddressingMode::IMPLIED};
+    table[0xD9] = {CMP, AddressingMode::ABSOLUTE_Y};
+    table[0xDA] = {NOP, AddressingMode::IMPLIED};
+    table[0xDB] = {DCP, AddressingMode::ABSOLUTE_Y};
+    table[0xDC] = {TOP, AddressingMode::ABSOLUTE_X};
+    table[0xDD] = {CMP, AddressingMode::ABSOLUTE_X};
+    table[0xDE] = {DEC, AddressingMode::ABSOLUTE_X};
+    table[0xDF] = {DCP, AddressingMode::ABSOLUTE_X};
+    table[0xE0] = {CPX, AddressingMode::IMMEDIATE};
+    table[0xE1] = {SBC, AddressingMode::INDIRECT_X};
+    table[0xE2] = {DOP, AddressingMode::IMMEDIATE};
+    table[0xE3] = {ISC, AddressingMode::INDIRECT_X};
+    table[0xE4] = {CPX, AddressingMode::ZERO_PAGE};
+    table[0xE5] = {SBC, AddressingMode::ZERO_PAGE};
+    table[0xE6] = {INC, AddressingMode::ZERO_PAGE};
+    table[0xE7] = {ISC, AddressingMode::ZERO_PAGE};
+    table[0xE8] = {INX, AddressingMode::IMPLIED};
+    table[0xE9] = {SBC, AddressingMode::IMMEDIATE};
+    table[0xEA] = {NOP, AddressingMode::IMPLIED};
+    table[0xEB] = {SBC, AddressingMode::IMMEDIATE};
+    table[0xEC] = {CPX, AddressingMode::ABSOLUTE};
+    table[0xED] = {SBC, AddressingMode::ABSOLUTE};
+    table[0xEE] = {INC, AddressingMode::ABSOLUTE};
+    table[0xEF] = {ISC, AddressingMode::ABSOLUTE};
+    table[0xF0] = {BEQ, AddressingMode::RELATIVE};
+    table[0xF1] = {SBC, AddressingMode::INDIRECT_Y};
+    table[0xF2] = {KIL, AddressingMode::IMPLIED};
+    table[0xF3] = {ISC, AddressingMode::INDIRECT_Y};
+    table[0xF4] = {DOP, AddressingMode::ZERO_PAGE_X};
+    table[0xF5] = {SBC, AddressingMode::ZERO_PAGE_X};
+    table[0xF6] = {INC, AddressingMode::ZERO_PAGE_X};
+    table[0xF7] = {ISC, AddressingMode::ZERO_PAGE_X};
+    table[0xF8] = {SED, AddressingMode::IMPLIED};
+    table[0xF9] = {SBC, AddressingMode::ABSOLUTE_Y};
+    table[0xFA] = {NOP, AddressingMode::IMPLIED};
+    table[0xFB] = {ISC, AddressingMode::ABSOLUTE_Y};
+    table[0xFC] = {TOP, AddressingMode::ABSOLUTE_X};
+    table[0xFD] = {SBC, AddressingMode::ABSOLUTE_X};
+    table[0xFE] = {INC, AddressingMode::ABSOLUTE_X};
+    table[0xFF] = {ISC, AddressingMode::ABSOLUTE_X};
+
+    InstructionTable<BusType> instructions;
+    for(int i = 0; i < 256; i++) {
+        instructions.functions[i] = std::get<0>(table[i]);
+        instructions.modes[i] = std::get<1>(table[i]);
+    }
+    return instructions;
+}
+
+template<typename BusType>
+CPUCore<BusType>::CPUCore(BusType* bus) : CPU(bus), typedBus(bus) {
+    // one table per bus type, shared by every instance
+    static const InstructionTable<BusType> table = buildInstructionTable<BusType>();
+    instructions = table.functions.data();
+    addressingModes = table.modes.data();
+}
+
+static uint8_t operandLength(AddressingMode mode) {
+    switch(mode) {
+    case AddressingMode::ACCUMULATOR:
+    case AddressingMode::IMPLIED:
+        return 0;
+    case AddressingMode::ABSOLUTE:
+    case AddressingMode::ABSOLUTE_X:
+    case AddressingMode::ABSOLUTE_Y:
+    case AddressingMode::INDIRECT:
+        return 2;
+    default:
+        return 1;
+    }
 }
 
-void CPU::triggerNMI() {
-    nmiPending = true;
+const char* CPU::getInstructionName(uint8_t opcode) {
+    return instructionNames[opcode].c_str();
 }
 
-uint16_t CPU::getAddress(AddressingMode mode, bool alwaysCrossPage) {
+bool CPU::startTrace(const std::string& path) {
+    TraceOpcodes opcodes;
+    for(int i = 0; i < 256; i++) {
+        opcodes.operandLengths[i] = operandLength(addressingModes[i]);
+        memcpy(opcodes.names[i], getInstructionName(i), 4);
+    }
+
+    stopTrace();
+    trace = new TraceWriter();
+    if(!trace->open(path, opcodes, {cycles, PC, 0, {0, 0}, A, X, Y, SP, P})) {
+        stopTrace();
+        return false;
+    }
+    return true;
+}
+
+void CPU::stopTrace() {
+    delete trace;
+    trace = nullptr;
+}
+
+template<typename BusType>
+uint16_t CPUCore<BusType>::getAddress(AddressingMode mode, bool alwaysCrossPage) {
     switch(mode) {
     case AddressingMode::ACCUMULATOR:
         return 0;
@@ -1392,20 +1534,20 @@ uint16_t CPU::getAddress(AddressingMode mode, bool alwaysCrossPage) {
     case AddressingMode::INDIRECT: {
         const uint16_t address = fetchWord();
         stepCycles(2);
-        return bus->read(address) | (bus->read((address & 0xFF00) | ((address + 1) & 0xFF)) << 8);
+        return typedBus->read(address) | (typedBus->read((address & 0xFF00) | ((address + 1) & 0xFF)) << 8);
     }
 
     case AddressingMode::INDIRECT_X: {
         uint8_t address = fetch();
         stepCycles(2); // might need to change this to 3
-        return bus->read((address + X) & 0xFF) +
-               (uint16_t(bus->read((address + X + 1) & 0xFF)) << 8);
+        return typedBus->read((address + X) & 0xFF) +
+               (uint16_t(typedBus->read((address + X + 1) & 0xFF)) << 8);
     }
 
     case AddressingMode::INDIRECT_Y: {
         uint8_t base = fetch();
-        uint8_t lo = bus->read(base);
-        uint8_t hi = bus->read((base + 1) & 0xFF);
+        uint8_t lo = typedBus->read(base);
+        uint8_t hi = typedBus->read((base + 1) & 0xFF);
 
         uint16_t deref_base = ((uint16_t)lo) | ((uint16_t)hi << 8);
         uint16_t deref = deref_base + Y;
@@ -1431,23 +1573,25 @@ void CPU::powerOn() {
     A = 0x00;
     X = 0x00;
     Y = 0x00;
-    cycles = 4;
+    stepCycles(7);
 }
 
 void CPU::reset() {
     PC = bus->readWord(0xFFFC);
     SP -= 3;
     P |= INTERRUPT_DISABLE_FLAG;
-    cycles = 0;
+    stepCycles(7);
 }
 
-uint8_t CPU::fetch() {
-    const uint8_t data = bus->read(PC++);
+template<typename BusType>
+uint8_t CPUCore<BusType>::fetch() {
+    const uint8_t data = typedBus->read(PC++);
     stepCycles(1);
     return data;
 }
 
-uint16_t CPU::fetchWord() {
+template<typename BusType>
+uint16_t CPUCore<BusType>::fetchWord() {
     uint16_t data = fetch() | (fetch() << 8);
     return data;
 }
@@ -1455,62 +1599,132 @@ uint16_t CPU::fetchWord() {
 // notes
 // TODO: fix page crossing executing everywhere
 
-void CPU::executeOnce() {
+template<typename BusType>
+void CPUCore<BusType>::executeOnce() {
+    if(cycleStepped) {
+        do {
+            tick();
+        } while(microOps);
+        return;
+    }
     lastCycles = cycles;
     if(nmiPending) {
+        uint8_t sp = SP;
+        size_t start = cycles;
         pushWord(PC);
         pushByte(P & ~BREAK_FLAG);
         P |= INTERRUPT_DISABLE_FLAG;
-        PC = bus->readWord(0xFFFA);
+        PC = typedBus->readWord(0xFFFA);
         nmiPending = false;
+        nmiCount++;
+        if(profiler) {
+            profiler->interrupt(true, PC, sp, cycles - start);
+        }
     }
-    if(irqPending && !(P & INTERRUPT_DISABLE_FLAG)) {
+    if(irqLines && !(P & INTERRUPT_DISABLE_FLAG)) {
+        uint8_t sp = SP;
+        size_t start = cycles;
         pushWord(PC);
         pushByte(P & ~BREAK_FLAG);
         P |= INTERRUPT_DISABLE_FLAG;
-        PC = bus->readWord(0xFFFE);
-        irqPending = false;
-    } else if((P & INTERRUPT_DISABLE_FLAG)) {
-        irqPending = false;
+        PC = typedBus->readWord(0xFFFE);
+        irqCount++;
+        if(profiler) {
+            profiler->interrupt(false, PC, sp, cycles - start);
+        }
+    }
+
+    if(!traps.empty()) {
+        auto trap = traps.find(PC);
+        if(trap != traps.end() && trap->second()) {
+            return;
+        }
+    }
+
+    if(trace) {
+        trace->record({cycles, PC, typedBus->peek(PC), {typedBus->peek(PC + 1), typedBus->peek(PC + 2)}, A, X, Y,
+                       SP, P});
     }
 
-    uint8_t opcode = fetch();
-    currentOpcode = opcode;
-    auto [instruction, addressingMode] = instructions[opcode];
-    instruction(this, addressingMode);
+    instructionPc = PC;
+    instructionSp = SP;
+    instructionStart = cycles;
+    currentOpcode = fetch();
+    instructions[currentOpcode](this, addressingModes[currentOpcode]);
+    instructionCount++;
+
+    if(profiler) {
+        profiler->instruction(instructionPc, currentOpcode, PC, instructionSp, SP,
+                              cycles - instructionStart);
+    }
 }
 
-void CPU::pushByte(uint8_t data) {
-    bus->write(0x100 | SP--, data);
+template<typename BusType>
+void CPUCore<BusType>::pushByte(uint8_t data) {
+    typedBus->write(0x100 | SP--, data);
     stepCycles(1);
 }
 
-void CPU::pushWord(uint16_t data) {
+template<typename BusType>
+void CPUCore<BusType>::pushWord(uint16_t data) {
     pushByte(data >> 8);
     pushByte(data & 0xFF);
 }
 
-void CPU::stepCycles(size_t cycles) {
-    this->cycles += cycles;
-    for(size_t i = 0; i < cycles; i++) {
-        if (cycleCallback) {
-            cycleCallback();
-        }
-    }
-}
-
 void CPU::stallCycles(size_t cycles) {
     // TODO: add this
     this->cycles += cycles;
 }
 
-uint8_t CPU::popByte() {
+template<typename BusType>
+uint8_t CPUCore<BusType>::popByte() {
     stepCycles(1);
-    return bus->read(0x100 | ++SP);
+    return typedBus->read(0x100 | ++SP);
 }
 
-uint16_t CPU::popWord() {
+template<typename BusType>
+uint16_t CPUCore<BusType>::popWord() {
     uint16_t data = popByte();
     data |= popByte() << 8;
     return data;
 }
+
+void CPU::saveState(StateWriter& state) const {
+    state.write(A);
+    state.write(X);
+    state.write(Y);
+    state.write(SP);
+    state.write(P);
+    state.write(PC);
+    state.write(cycles);
+    state.write(lastCycles);
+    state.write(currentOpcode);
+    state.write(irqLines);
+    state.write(nmiLines);
+    state.write(nmiPending);
+}
+
+void CPU::loadState(StateReader& state) {
+    state.read(A);
+    state.read(X);
+    state.read(Y);
+    state.read(SP);
+    state.read(P);
+    state.read(PC);
+    state.read(cycles);
+    state.read(lastCycles);
+    state.read(currentOpcode);
+    state.read(irqLines);
+    state.read(nmiLines);
+    state.read(nmiPending);
+    // snapshots are taken between instructions, the cycle stepped core samples the restored
+    // interrupts as if the last instruction had just ended
+    microOps = nullptr;
+    nmiSampled = nmiPending;
+    irqSampled = irqLines && !(P & INTERRUPT_DISABLE_FLAG);
+}
+
+// the buses the core is built for, the cycle stepped half is instantiated in cpu_cycle.cpp
+template class CPUCore<Bus>;
+template class CPUCore<C64Bus>;
+template class CPUCore<FlatBus>;
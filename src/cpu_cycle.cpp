@@ -0,0 +1,868 @@
+#include <C64Bus.hpp>
+#include <array>
+#include <cpu.hpp>
+#include <cstring>
+#include <flat_bus.hpp>
+#include <mutex>
+#include <vector>
+
+// The cycle stepped core. Every instruction is a short program of micro ops and every micro op
+// is exactly one bus cycle, the dummy reads and writes included, following 6502_cpu.txt. The
+// programs are built once from the mnemonic and addressing mode tables of the instruction
+// stepped core and the results of every instruction are the same as in that core, only the
+// bus cycles differ.
+
+#define CYCLE_PROGRAM_LENGTH 8
+
+enum MicroOp : uint8_t {
+    END,
+    // addressing
+    FETCH_ADDRESS_LOW,
+    FETCH_ADDRESS_HIGH,
+    FETCH_ADDRESS_HIGH_X, // adds the index to the low byte only, the carry is fixed later
+    FETCH_ADDRESS_HIGH_Y,
+    ADD_X_ZERO_PAGE,
+    ADD_Y_ZERO_PAGE,
+    FETCH_POINTER,
+    ADD_X_POINTER,
+    READ_POINTER_LOW,
+    READ_POINTER_HIGH,
+    READ_POINTER_HIGH_Y,
+    FIX_ADDRESS, // dummy read at the uncorrected address
+    // operands
+    READ_IMMEDIATE,
+    READ_OPERAND,
+    READ_OPERAND_INDEXED, // finishes the instruction unless the page was crossed
+    READ_MODIFY,
+    IMPLIED,
+    // stack and control flow
+    DUMMY_READ_PC,
+    READ_PC_INCREMENT,
+    DUMMY_READ_STACK,
+    DUMMY_READ_STACK_INCREMENT,
+    PULL_REGISTER,
+    PULL_P_INCREMENT,
+    PULL_PC_LOW_INCREMENT,
+    PULL_PC_HIGH,
+    JUMP_ABSOLUTE,
+    JUMP_INDIRECT_LOW,
+    JUMP_INDIRECT_HIGH,
+    READ_VECTOR_LOW,
+    READ_VECTOR_HIGH,
+    BRANCH,
+    BRANCH_TAKEN,
+    BRANCH_FIX,
+    JAM,
+    // everything from here on writes, RDY does not stop these
+    WRITE_OPERAND,
+    DUMMY_WRITE,
+    WRITE_RESULT,
+    PUSH_REGISTER,
+    PUSH_PC_HIGH,
+    PUSH_PC_LOW,
+    PUSH_P_BREAK,
+    PUSH_P_INTERRUPT,
+};
+
+enum class Operation : uint8_t {
+    NOP,
+    // reads
+    LDA, LDX, LDY, EOR, AND, ORA, ADC, SBC, CMP, CPX, CPY, BIT, LAX, AAC, ASR, ARR, ATX, AXS,
+    XAA, LAR,
+    // writes
+    STA, STX, STY, AAX, AXA, SXA, SYA, XAS,
+    // read modify writes, the shifts also work on the accumulator
+    ASL, LSR, ROL, ROR, INC, DEC, SLO, RLA, SRE, RRA, ISC, DCP,
+    // implied
+    CLC, SEC, CLI, SEI, CLV, CLD, SED, INX, INY, DEX, DEY, TAX, TAY, TXA, TYA, TSX, TXS,
+    // stack
+    PHA, PHP, PLA, PLP,
+    // branches
+    BPL, BMI, BVC, BVS, BCC, BCS, BNE, BEQ,
+};
+
+enum class Kind { READ, WRITE, MODIFY, IMPLIED, PUSH, PULL, BRANCH, JSR, RTS, RTI, BRK, JMP, JAM };
+
+struct Mnemonic {
+    const char* name;
+    Operation operation;
+    Kind kind;
+};
+
+static const Mnemonic mnemonics[] = {
+    {"LDA", Operation::LDA, Kind::READ},    {"LDX", Operation::LDX, Kind::READ},
+    {"LDY", Operation::LDY, Kind::READ},    {"EOR", Operation::EOR, Kind::READ},
+    {"AND", Operation::AND, Kind::READ},    {"ORA", Operation::ORA, Kind::READ},
+    {"ADC", Operation::ADC, Kind::READ},    {"SBC", Operation::SBC, Kind::READ},
+    {"CMP", Operation::CMP, Kind::READ},    {"CPX", Operation::CPX, Kind::READ},
+    {"CPY", Operation::CPY, Kind::READ},    {"BIT", Operation::BIT, Kind::READ},
+    {"LAX", Operation::LAX, Kind::READ},    {"AAC", Operation::AAC, Kind::READ},
+    {"ASR", Operation::ASR, Kind::READ},    {"ARR", Operation::ARR, Kind::READ},
+    {"ATX", Operation::ATX, Kind::READ},    {"AXS", Operation::AXS, Kind::READ},
+    {"XAA", Operation::XAA, Kind::READ},    {"LAR", Operation::LAR, Kind::READ},
+    {"DOP", Operation::NOP, Kind::READ},    {"TOP", Operation::NOP, Kind::READ},
+    {"STA", Operation::STA, Kind::WRITE},   {"STX", Operation::STX, Kind::WRITE},
+    {"STY", Operation::STY, Kind::WRITE},   {"AAX", Operation::AAX, Kind::WRITE},
+    {"AXA", Operation::AXA, Kind::WRITE},   {"SXA", Operation::SXA, Kind::WRITE},
+    {"SYA", Operation::SYA, Kind::WRITE},   {"XAS", Operation::XAS, Kind::WRITE},
+    {"ASL", Operation::ASL, Kind::MODIFY},  {"LSR", Operation::LSR, Kind::MODIFY},
+    {"ROL", Operation::ROL, Kind::MODIFY},  {"ROR", Operation::ROR, Kind::MODIFY},
+    {"INC", Operation::INC, Kind::MODIFY},  {"DEC", Operation::DEC, Kind::MODIFY},
+    {"SLO", Operation::SLO, Kind::MODIFY},  {"RLA", Operation::RLA, Kind::MODIFY},
+    {"SRE", Operation::SRE, Kind::MODIFY},  {"RRA", Operation::RRA, Kind::MODIFY},
+    {"ISC", Operation::ISC, Kind::MODIFY},  {"DCP", Operation::DCP, Kind::MODIFY},
+    {"NOP", Operation::NOP, Kind::IMPLIED}, {"CLC", Operation::CLC, Kind::IMPLIED},
+    {"SEC", Operation::SEC, Kind::IMPLIED}, {"CLI", Operation::CLI, Kind::IMPLIED},
+    {"SEI", Operation::SEI, Kind::IMPLIED}, {"CLV", Operation::CLV, Kind::IMPLIED},
+    {"CLD", Operation::CLD, Kind::IMPLIED}, {"SED", Operation::SED, Kind::IMPLIED},
+    {"INX", Operation::INX, Kind::IMPLIED}, {"INY", Operation::INY, Kind::IMPLIED},
+    {"DEX", Operation::DEX, Kind::IMPLIED}, {"DEY", Operation::DEY, Kind::IMPLIED},
+    {"TAX", Operation::TAX, Kind::IMPLIED}, {"TAY", Operation::TAY, Kind::IMPLIED},
+    {"TXA", Operation::TXA, Kind::IMPLIED}, {"TYA", Operation::TYA, Kind::IMPLIED},
+    {"TSX", Operation::TSX, Kind::IMPLIED}, {"TXS", Operation::TXS, Kind::IMPLIED},
+    {"PHA", Operation::PHA, Kind::PUSH},    {"PHP", Operation::PHP, Kind::PUSH},
+    {"PLA", Operation::PLA, Kind::PULL},    {"PLP", Operation::PLP, Kind::PULL},
+    {"BPL", Operation::BPL, Kind::BRANCH},  {"BMI", Operation::BMI, Kind::BRANCH},
+    {"BVC", Operation::BVC, Kind::BRANCH},  {"BVS", Operation::BVS, Kind::BRANCH},
+    {"BCC", Operation::BCC, Kind::BRANCH},  {"BCS", Operation::BCS, Kind::BRANCH},
+    {"BNE", Operation::BNE, Kind::BRANCH},  {"BEQ", Operation::BEQ, Kind::BRANCH},
+    {"JSR", Operation::NOP, Kind::JSR},     {"RTS", Operation::NOP, Kind::RTS},
+    {"RTI", Operation::NOP, Kind::RTI},     {"BRK", Operation::NOP, Kind::BRK},
+    {"JMP", Operation::NOP, Kind::JMP},     {"KIL", Operation::NOP, Kind::JAM},
+};
+
+struct CycleTables {
+    uint8_t programs[256][CYCLE_PROGRAM_LENGTH];
+    Operation operations[256];
+};
+
+static CycleTables cycleTables;
+static std::once_flag cycleTablesBuilt;
+
+// the cycles after the opcode fetch of an interrupt, the fetched opcode is thrown away
+static const uint8_t interruptProgram[] = {DUMMY_READ_PC, PUSH_PC_HIGH,    PUSH_PC_LOW,
+                                           PUSH_P_INTERRUPT, READ_VECTOR_LOW, READ_VECTOR_HIGH,
+                                           END};
+// where micro ops that end their instruction early jump to
+static const uint8_t finished[] = {END};
+
+// the cycles that compute the effective address, indexed modes stop before fixing the page
+static void addAddressing(std::vector<uint8_t>& program, AddressingMode mode) {
+    switch(mode) {
+    case AddressingMode::ZERO_PAGE:
+        program.push_back(FETCH_ADDRESS_LOW);
+        break;
+    case AddressingMode::ZERO_PAGE_X:
+        program.insert(program.end(), {FETCH_ADDRESS_LOW, ADD_X_ZERO_PAGE});
+        break;
+    case AddressingMode::ZERO_PAGE_Y:
+        program.insert(program.end(), {FETCH_ADDRESS_LOW, ADD_Y_ZERO_PAGE});
+        break;
+    case AddressingMode::ABSOLUTE:
+        program.insert(program.end(), {FETCH_ADDRESS_LOW, FETCH_ADDRESS_HIGH});
+        break;
+    case AddressingMode::ABSOLUTE_X:
+        program.insert(program.end(), {FETCH_ADDRESS_LOW, FETCH_ADDRESS_HIGH_X});
+        break;
+    case AddressingMode::ABSOLUTE_Y:
+        program.insert(program.end(), {FETCH_ADDRESS_LOW, FETCH_ADDRESS_HIGH_Y});
+        break;
+    case AddressingMode::INDIRECT_X:
+        program.insert(program.end(),
+                       {FETCH_POINTER, ADD_X_POINTER, READ_POINTER_LOW, READ_POINTER_HIGH});
+        break;
+    case AddressingMode::INDIRECT_Y:
+        program.insert(program.end(), {FETCH_POINTER, READ_POINTER_LOW, READ_POINTER_HIGH_Y});
+        break;
+    default:
+        break;
+    }
+}
+
+static bool isIndexed(AddressingMode mode) {
+    return mode == AddressingMode::ABSOLUTE_X || mode == AddressingMode::ABSOLUTE_Y ||
+           mode == AddressingMode::INDIRECT_Y;
+}
+
+static std::vector<uint8_t> buildProgram(Kind kind, AddressingMode mode) {
+    std::vector<uint8_t> program;
+    switch(kind) {
+    case Kind::READ:
+        if(mode == AddressingMode::IMMEDIATE) {
+            program.push_back(READ_IMMEDIATE);
+            break;
+        }
+        addAddressing(program, mode);
+        if(isIndexed(mode)) {
+            program.push_back(READ_OPERAND_INDEXED);
+        }
+        program.push_back(READ_OPERAND);
+        break;
+    case Kind::WRITE:
+        addAddressing(program, mode);
+        if(isIndexed(mode)) {
+            program.push_back(FIX_ADDRESS);
+        }
+        program.push_back(WRITE_OPERAND);
+        break;
+    case Kind::MODIFY:
+        if(mode == AddressingMode::ACCUMULATOR) {
+            program.push_back(IMPLIED);
+            break;
+        }
+        addAddressing(program, mode);
+        if(isIndexed(mode)) {
+            program.push_back(FIX_ADDRESS);
+        }
+        program.insert(program.end(), {READ_MODIFY, DUMMY_WRITE, WRITE_RESULT});
+        break;
+    case Kind::IMPLIED:
+        program.push_back(IMPLIED);
+        break;
+    case Kind::PUSH:
+        program.insert(program.end(), {DUMMY_READ_PC, PUSH_REGISTER});
+        break;
+    case Kind::PULL:
+        program.insert(program.end(), {DUMMY_READ_PC, DUMMY_READ_STACK_INCREMENT, PULL_REGISTER});
+        break;
+    case Kind::BRANCH:
+        program.insert(program.end(), {BRANCH, BRANCH_TAKEN, BRANCH_FIX});
+        break;
+    case Kind::JSR:
+        program.insert(program.end(), {FETCH_ADDRESS_LOW, DUMMY_READ_STACK, PUSH_PC_HIGH,
+                                       PUSH_PC_LOW, JUMP_ABSOLUTE});
+        break;
+    case Kind::RTS:
+        program.insert(program.end(), {DUMMY_READ_PC, DUMMY_READ_STACK_INCREMENT,
+                                       PULL_PC_LOW_INCREMENT, PULL_PC_HIGH, READ_PC_INCREMENT});
+        break;
+    case Kind::RTI:
+        program.insert(program.end(), {DUMMY_READ_PC, DUMMY_READ_STACK_INCREMENT,
+                                       PULL_P_INCREMENT, PULL_PC_LOW_INCREMENT, PULL_PC_HIGH});
+        break;
+    case Kind::BRK:
+        program.insert(program.end(), {READ_PC_INCREMENT, PUSH_PC_HIGH, PUSH_PC_LOW,
+                                       PUSH_P_BREAK, READ_VECTOR_LOW, READ_VECTOR_HIGH});
+        break;
+    case Kind::JMP:
+        if(mode == AddressingMode::INDIRECT) {
+            program.insert(program.end(), {FETCH_ADDRESS_LOW, FETCH_ADDRESS_HIGH,
+                                           JUMP_INDIRECT_LOW, JUMP_INDIRECT_HIGH});
+        } else {
+            program.insert(program.end(), {FETCH_ADDRESS_LOW, JUMP_ABSOLUTE});
+        }
+        break;
+    case Kind::JAM:
+        program.push_back(JAM);
+        break;
+    }
+    program.push_back(END);
+    return program;
+}
+
+static void buildCycleTables(const AddressingMode* modes) {
+    for(int opcode = 0; opcode < 256; opcode++) {
+        const char* name = CPU::getInstructionName(opcode);
+        const Mnemonic* mnemonic = mnemonics;
+        while(strcmp(mnemonic->name, name) != 0) {
+            mnemonic++;
+        }
+        std::vector<uint8_t> program = buildProgram(mnemonic->kind, modes[opcode]);
+        std::copy(program.begin(), program.end(), cycleTables.programs[opcode]);
+        cycleTables.operations[opcode] = mnemonic->operation;
+    }
+}
+
+static void setZeroNegative(CPU* cpu, uint8_t value) {
+    cpu->P &= ~(ZERO_FLAG | NEGATIVE_FLAG);
+    cpu->P |= (!value) * ZERO_FLAG;
+    cpu->P |= (value & 0x80);
+}
+
+static void compare(CPU* cpu, uint8_t reg, uint8_t data) {
+    cpu->P &= ~(ZERO_FLAG | NEGATIVE_FLAG | CARRY_FLAG);
+    setZeroNegative(cpu, reg - data);
+    if(reg >= data) {
+        cpu->P |= CARRY_FLAG;
+    }
+}
+
+static void addWithCarry(CPU* cpu, uint8_t data, bool decimal) {
+    uint16_t result = cpu->A + data + (cpu->P & CARRY_FLAG);
+    if(decimal && (cpu->P & DECIMAL_MODE_FLAG)) {
+        if((cpu->A & 0x0F) + (data & 0x0F) + (cpu->P & CARRY_FLAG) > 0x09) {
+            result += 0x06;
+        }
+        if(result > 0x99) {
+            result += 0x60;
+        }
+    }
+    cpu->P &= ~(ZERO_FLAG | NEGATIVE_FLAG | CARRY_FLAG | OVERFLOW_FLAG);
+    setZeroNegative(cpu, result);
+    if(result > 0xFF) {
+        cpu->P |= CARRY_FLAG;
+    }
+    if((cpu->A ^ result) & (data ^ result) & 0x80) {
+        cpu->P |= OVERFLOW_FLAG;
+    }
+    cpu->A = result;
+}
+
+static void subtractWithCarry(CPU* cpu, uint8_t data, bool decimal) {
+    uint16_t result = cpu->A - data - (1 - (cpu->P & CARRY_FLAG));
+    if(decimal && (cpu->P & DECIMAL_MODE_FLAG)) {
+        if((cpu->A & 0x0F) < (data & 0x0F) + (1 - (cpu->P & CARRY_FLAG))) {
+            result -= 0x06;
+        }
+        if(result & 0x100) {
+            result -= 0x60;
+        }
+    }
+    cpu->P &= ~(ZERO_FLAG | NEGATIVE_FLAG | CARRY_FLAG | OVERFLOW_FLAG);
+    setZeroNegative(cpu, result);
+    if(result < 0x100) {
+        cpu->P |= CARRY_FLAG;
+    }
+    if((cpu->A ^ result) & (cpu->A ^ data) & 0x80) {
+        cpu->P |= OVERFLOW_FLAG;
+    }
+    cpu->A = result;
+}
+
+static void executeRead(CPU* cpu, Operation operation, uint8_t data) {
+    switch(operation) {
+    case Operation::LDA:
+        cpu->A = data;
+        setZeroNegative(cpu, data);
+        break;
+    case Operation::LDX:
+        cpu->X = data;
+        setZeroNegative(cpu, data);
+        break;
+    case Operation::LDY:
+        cpu->Y = data;
+        setZeroNegative(cpu, data);
+        break;
+    case Operation::EOR:
+        cpu->A ^= data;
+        setZeroNegative(cpu, cpu->A);
+        break;
+    case Operation::AND:
+        cpu->A &= data;
+        setZeroNegative(cpu, cpu->A);
+        break;
+    case Operation::ORA:
+        cpu->A |= data;
+        setZeroNegative(cpu, cpu->A);
+        break;
+    case Operation::ADC:
+        addWithCarry(cpu, data, true);
+        break;
+    case Operation::SBC:
+        subtractWithCarry(cpu, data, true);
+        break;
+    case Operation::CMP:
+        compare(cpu, cpu->A, data);
+        break;
+    case Operation::CPX:
+        compare(cpu, cpu->X, data);
+        break;
+    case Operation::CPY:
+        compare(cpu, cpu->Y, data);
+        break;
+    case Operation::BIT:
+        cpu->P &= ~(ZERO_FLAG | NEGATIVE_FLAG | OVERFLOW_FLAG);
+        cpu->P |= !(cpu->A & data) * ZERO_FLAG;
+        cpu->P |= data & (NEGATIVE_FLAG | OVERFLOW_FLAG);
+        break;
+    case Operation::LAX:
+        cpu->A = cpu->X = data;
+        setZeroNegative(cpu, data);
+        break;
+    case Operation::AAC:
+        cpu->A &= data;
+        setZeroNegative(cpu, cpu->A);
+        cpu->P = (cpu->P & ~CARRY_FLAG) | (cpu->A >> 7);
+        break;
+    case Operation::ASR:
+        cpu->A &= data;
+        setZeroNegative(cpu, cpu->A);
+        cpu->P = (cpu->P & ~CARRY_FLAG) | (cpu->A & CARRY_FLAG);
+        cpu->A >>= 1;
+        break;
+    case Operation::ARR:
+        cpu->A = (cpu->A & data) >> 1;
+        cpu->P &= ~(CARRY_FLAG | OVERFLOW_FLAG);
+        if(cpu->A & 0x20) {
+            cpu->P |= CARRY_FLAG;
+        }
+        if((cpu->A ^ (cpu->A << 1)) & 0x20) {
+            cpu->P |= OVERFLOW_FLAG;
+        }
+        break;
+    case Operation::ATX:
+        cpu->X = cpu->A &= data;
+        setZeroNegative(cpu, cpu->X);
+        break;
+    case Operation::AXS:
+        cpu->X = (cpu->A & cpu->X) - data;
+        cpu->P &= ~CARRY_FLAG;
+        setZeroNegative(cpu, cpu->X);
+        if(cpu->X >= data) {
+            cpu->P |= CARRY_FLAG;
+        }
+        break;
+    case Operation::XAA:
+        cpu->A &= cpu->X & data;
+        setZeroNegative(cpu, cpu->A);
+        break;
+    case Operation::LAR:
+        cpu->A = cpu->X = cpu->SP = cpu->SP & data;
+        setZeroNegative(cpu, cpu->A);
+        break;
+    default:
+        break;
+    }
+}
+
+static uint8_t executeStore(CPU* cpu, Operation operation, uint16_t address) {
+    switch(operation) {
+    case Operation::STA:
+        return cpu->A;
+    case Operation::STX:
+        return cpu->X;
+    case Operation::STY:
+        return cpu->Y;
+    case Operation::AAX:
+        return cpu->A & cpu->X;
+    case Operation::AXA:
+        return cpu->X & cpu->A & 0x07;
+    case Operation::SXA:
+        return cpu->X & ((address >> 8) + 1);
+    case Operation::SYA:
+        return cpu->Y & ((address >> 8) + 1);
+    case Operation::XAS:
+        cpu->X = cpu->A & cpu->X;
+        cpu->SP = cpu->X;
+        return cpu->SP & ((address >> 8) + 1);
+    default:
+        return 0;
+    }
+}
+
+static uint8_t executeModify(CPU* cpu, Operation operation, uint8_t data) {
+    uint8_t carry = cpu->P & CARRY_FLAG;
+    switch(operation) {
+    case Operation::ASL:
+    case Operation::SLO:
+        cpu->P = (cpu->P & ~CARRY_FLAG) | (data >> 7);
+        data <<= 1;
+        break;
+    case Operation::LSR:
+    case Operation::SRE:
+        cpu->P = (cpu->P & ~CARRY_FLAG) | (data & CARRY_FLAG);
+        data >>= 1;
+        break;
+    case Operation::ROL:
+    case Operation::RLA:
+        cpu->P = (cpu->P & ~CARRY_FLAG) | (data >> 7);
+        data = (data << 1) | carry;
+        break;
+    case Operation::ROR:
+    case Operation::RRA:
+        cpu->P = (cpu->P & ~CARRY_FLAG) | (data & CARRY_FLAG);
+        data = (data >> 1) | (carry << 7);
+        break;
+    case Operation::INC:
+    case Operation::ISC:
+        data++;
+        break;
+    case Operation::DEC:
+    case Operation::DCP:
+        data--;
+        break;
+    default:
+        break;
+    }
+
+    switch(operation) {
+    case Operation::SLO:
+        cpu->A |= data;
+        setZeroNegative(cpu, cpu->A);
+        break;
+    case Operation::RLA:
+        cpu->A &= data;
+        setZeroNegative(cpu, cpu->A);
+        break;
+    case Operation::SRE:
+        cpu->A ^= data;
+        setZeroNegative(cpu, cpu->A);
+        break;
+    case Operation::RRA:
+        addWithCarry(cpu, data, false);
+        break;
+    case Operation::ISC:
+        subtractWithCarry(cpu, data, false);
+        break;
+    case Operation::DCP:
+        compare(cpu, cpu->A, data);
+        break;
+    default:
+        setZeroNegative(cpu, data);
+        break;
+    }
+    return data;
+}
+
+static void executeImplied(CPU* cpu, Operation operation) {
+    switch(operation) {
+    case Operation::CLC:
+        cpu->P &= ~CARRY_FLAG;
+        break;
+    case Operation::SEC:
+        cpu->P |= CARRY_FLAG;
+        break;
+    case Operation::CLI:
+        cpu->P &= ~INTERRUPT_DISABLE_FLAG;
+        break;
+    case Operation::SEI:
+        cpu->P |= INTERRUPT_DISABLE_FLAG;
+        break;
+    case Operation::CLV:
+        cpu->P &= ~OVERFLOW_FLAG;
+        break;
+    case Operation::CLD:
+        cpu->P &= ~DECIMAL_MODE_FLAG;
+        break;
+    case Operation::SED:
+        cpu->P |= DECIMAL_MODE_FLAG;
+        break;
+    case Operation::INX:
+        setZeroNegative(cpu, ++cpu->X);
+        break;
+    case Operation::INY:
+        setZeroNegative(cpu, ++cpu->Y);
+        break;
+    case Operation::DEX:
+        setZeroNegative(cpu, --cpu->X);
+        break;
+    case Operation::DEY:
+        setZeroNegative(cpu, --cpu->Y);
+        break;
+    case Operation::TAX:
+        setZeroNegative(cpu, cpu->X = cpu->A);
+        break;
+    case Operation::TAY:
+        setZeroNegative(cpu, cpu->Y = cpu->A);
+        break;
+    case Operation::TXA:
+        setZeroNegative(cpu, cpu->A = cpu->X);
+        break;
+    case Operation::TYA:
+        setZeroNegative(cpu, cpu->A = cpu->Y);
+        break;
+    case Operation::TSX:
+        setZeroNegative(cpu, cpu->X = cpu->SP);
+        break;
+    case Operation::TXS:
+        cpu->SP = cpu->X;
+        break;
+    case Operation::ASL:
+    case Operation::LSR:
+    case Operation::ROL:
+    case Operation::ROR:
+        cpu->A = executeModify(cpu, operation, cpu->A);
+        break;
+    default:
+        break;
+    }
+}
+
+static bool isBranchTaken(CPU* cpu, Operation operation) {
+    switch(operation) {
+    case Operation::BPL:
+        return !(cpu->P & NEGATIVE_FLAG);
+    case Operation::BMI:
+        return cpu->P & NEGATIVE_FLAG;
+    case Operation::BVC:
+        return !(cpu->P & OVERFLOW_FLAG);
+    case Operation::BVS:
+        return cpu->P & OVERFLOW_FLAG;
+    case Operation::BCC:
+        return !(cpu->P & CARRY_FLAG);
+    case Operation::BCS:
+        return cpu->P & CARRY_FLAG;
+    case Operation::BNE:
+        return !(cpu->P & ZERO_FLAG);
+    case Operation::BEQ:
+        return cpu->P & ZERO_FLAG;
+    default:
+        return false;
+    }
+}
+
+void CPU::setCycleStepped(bool enabled) {
+    if(enabled) {
+        std::call_once(cycleTablesBuilt, [this]() { buildCycleTables(addressingModes); });
+    }
+    cycleStepped = enabled;
+}
+
+// the opcode fetch, or the first cycle of an interrupt sequence when one was sampled during the
+// last cycle of the previous instruction
+template<typename BusType>
+void CPUCore<BusType>::startInstruction() {
+    if(!ready) {
+        stepCycles(1);
+        return;
+    }
+    lastCycles = cycles;
+    if(nmiSampled || irqSampled) {
+        interruptIsNmi = nmiSampled;
+        if(nmiSampled) {
+            nmiPending = false;
+            nmiCount++;
+        } else {
+            irqCount++;
+        }
+        nmiSampled = irqSampled = false;
+        interrupting = true;
+        instructionSp = SP;
+        instructionStart = cycles;
+        typedBus->read(PC);
+        stepCycles(1);
+        microOps = interruptProgram;
+        return;
+    }
+
+    if(!traps.empty()) {
+        auto trap = traps.find(PC);
+        if(trap != traps.end() && trap->second()) {
+            return;
+        }
+    }
+
+    if(trace) {
+        trace->record({cycles, PC, typedBus->peek(PC), {typedBus->peek(PC + 1), typedBus->peek(PC + 2)}, A, X, Y,
+                       SP, P});
+    }
+
+    instructionPc = PC;
+    instructionSp = SP;
+    instructionStart = cycles;
+    currentOpcode = typedBus->read(PC++);
+    operation = static_cast<uint8_t>(cycleTables.operations[currentOpcode]);
+    microOps = cycleTables.programs[currentOpcode];
+    stepCycles(1);
+}
+
+void CPU::finishInstruction() {
+    microOps = nullptr;
+    if(interrupting) {
+        interrupting = false;
+        if(profiler) {
+            profiler->interrupt(interruptIsNmi, PC, instructionSp, cycles - instructionStart);
+        }
+        return;
+    }
+    instructionCount++;
+    if(profiler) {
+        profiler->instruction(instructionPc, currentOpcode, PC, instructionSp, SP,
+                              cycles - instructionStart);
+    }
+}
+
+template<typename BusType>
+void CPUCore<BusType>::tick() {
+    if(!microOps) {
+        startInstruction();
+        return;
+    }
+    uint8_t microOp = *microOps;
+    if(!ready && microOp < WRITE_OPERAND) {
+        stepCycles(1);
+        return;
+    }
+    microOps++;
+    // interrupts are sampled during every cycle, what counts is the last cycle of the instruction
+    nmiSampled = nmiPending;
+    irqSampled = irqLines && !(P & INTERRUPT_DISABLE_FLAG);
+
+    Operation op = static_cast<Operation>(operation);
+    switch(microOp) {
+    case FETCH_ADDRESS_LOW:
+        address = typedBus->read(PC++);
+        break;
+    case FETCH_ADDRESS_HIGH:
+        address |= typedBus->read(PC++) << 8;
+        break;
+    case FETCH_ADDRESS_HIGH_X:
+    case FETCH_ADDRESS_HIGH_Y: {
+        uint16_t low = (address & 0xFF) + (microOp == FETCH_ADDRESS_HIGH_X ? X : Y);
+        pageCrossed = low > 0xFF;
+        address = (typedBus->read(PC++) << 8) | (low & 0xFF);
+        break;
+    }
+    case ADD_X_ZERO_PAGE:
+        typedBus->read(address);
+        address = (address + X) & 0xFF;
+        break;
+    case ADD_Y_ZERO_PAGE:
+        typedBus->read(address);
+        address = (address + Y) & 0xFF;
+        break;
+    case FETCH_POINTER:
+        pointer = typedBus->read(PC++);
+        break;
+    case ADD_X_POINTER:
+        typedBus->read(pointer);
+        pointer += X;
+        break;
+    case READ_POINTER_LOW:
+        address = typedBus->read(pointer);
+        break;
+    case READ_POINTER_HIGH:
+        address |= typedBus->read(static_cast<uint8_t>(pointer + 1)) << 8;
+        break;
+    case READ_POINTER_HIGH_Y: {
+        uint16_t low = address + Y;
+        pageCrossed = low > 0xFF;
+        address = (typedBus->read(static_cast<uint8_t>(pointer + 1)) << 8) | (low & 0xFF);
+        break;
+    }
+    case FIX_ADDRESS:
+        typedBus->read(address);
+        if(pageCrossed) {
+            address += 0x100;
+        }
+        break;
+    case READ_IMMEDIATE:
+        executeRead(this, op, typedBus->read(PC++));
+        break;
+    case READ_OPERAND:
+        executeRead(this, op, typedBus->read(address));
+        break;
+    case READ_OPERAND_INDEXED:
+        data = typedBus->read(address);
+        if(pageCrossed) {
+            address += 0x100;
+        } else {
+            executeRead(this, op, data);
+            microOps = finished;
+        }
+        break;
+    case READ_MODIFY:
+        data = typedBus->read(address);
+        break;
+    case IMPLIED:
+        typedBus->read(PC);
+        executeImplied(this, op);
+        break;
+    case DUMMY_READ_PC:
+        typedBus->read(PC);
+        break;
+    case READ_PC_INCREMENT:
+        typedBus->read(PC++);
+        break;
+    case DUMMY_READ_STACK:
+        typedBus->read(0x100 | SP);
+        break;
+    case DUMMY_READ_STACK_INCREMENT:
+        typedBus->read(0x100 | SP++);
+        break;
+    case PULL_REGISTER:
+        data = typedBus->read(0x100 | SP);
+        if(op == Operation::PLA) {
+            setZeroNegative(this, A = data);
+        } else {
+            P = (data & ~BREAK_FLAG) | (P & BREAK_FLAG) | UNUSED_FLAG;
+        }
+        break;
+    case PULL_P_INCREMENT:
+        P = typedBus->read(0x100 | SP++) | UNUSED_FLAG;
+        break;
+    case PULL_PC_LOW_INCREMENT:
+        PC = (PC & 0xFF00) | typedBus->read(0x100 | SP++);
+        break;
+    case PULL_PC_HIGH:
+        PC = (PC & 0xFF) | (typedBus->read(0x100 | SP) << 8);
+        break;
+    case JUMP_ABSOLUTE:
+        PC = (typedBus->read(PC) << 8) | (address & 0xFF);
+        break;
+    case JUMP_INDIRECT_LOW:
+        data = typedBus->read(address);
+        break;
+    case JUMP_INDIRECT_HIGH:
+        PC = (typedBus->read((address & 0xFF00) | ((address + 1) & 0xFF)) << 8) | data;
+        break;
+    case READ_VECTOR_LOW:
+        data = typedBus->read(address);
+        break;
+    case READ_VECTOR_HIGH:
+        PC = (typedBus->read(address + 1) << 8) | data;
+        break;
+    case BRANCH:
+        data = typedBus->read(PC++);
+        if(!isBranchTaken(this, op)) {
+            microOps = finished;
+        }
+        break;
+    case BRANCH_TAKEN: {
+        typedBus->read(PC);
+        uint16_t target = PC + static_cast<int8_t>(data);
+        if((target & 0xFF00) == (PC & 0xFF00)) {
+            microOps = finished;
+        }
+        PC = (PC & 0xFF00) | (target & 0xFF);
+        address = target;
+        break;
+    }
+    case BRANCH_FIX:
+        typedBus->read(PC);
+        PC = address;
+        break;
+    case JAM:
+        typedBus->read(PC);
+        PC--;
+        break;
+    case WRITE_OPERAND:
+        typedBus->write(address, executeStore(this, op, address));
+        break;
+    case DUMMY_WRITE:
+        typedBus->write(address, data);
+        data = executeModify(this, op, data);
+        break;
+    case WRITE_RESULT:
+        typedBus->write(address, data);
+        break;
+    case PUSH_REGISTER:
+        typedBus->write(0x100 | SP--, op == Operation::PHA ? A : P | BREAK_FLAG | UNUSED_FLAG);
+        break;
+    case PUSH_PC_HIGH:
+        typedBus->write(0x100 | SP--, PC >> 8);
+        break;
+    case PUSH_PC_LOW:
+        typedBus->write(0x100 | SP--, PC & 0xFF);
+        break;
+    case PUSH_P_BREAK:
+        typedBus->write(0x100 | SP--, P | BREAK_FLAG | UNUSED_FLAG);
+        P |= INTERRUPT_DISABLE_FLAG;
+        address = 0xFFFE;
+        break;
+    case PUSH_P_INTERRUPT:
+        typedBus->write(0x100 | SP--, P & ~BREAK_FLAG);
+        P |= INTERRUPT_DISABLE_FLAG;
+        address = interruptIsNmi ? 0xFFFA : 0xFFFE;
+        break;
+    }
+    stepCycles(1);
+
+    if(*microOps == END) {
+        finishInstruction();
+    }
+}
+
+template void CPUCore<Bus>::tick();
+template void CPUCore<C64Bus>::tick();
+template void CPUCore<FlatBus>::tick();
@@ -0,0 +1,297 @@
+#include <cstring>
+#include <disk_image.hpp>
+#include <fstream>
+#include <iostream>
+
+#define GCR_HEADER_SIZE 10 // 8 bytes
+#define GCR_DATA_SIZE 325 // 260 bytes
+// sync, header, gap, sync, data
+#define GCR_SECTOR_SIZE (5 + GCR_HEADER_SIZE + 9 + 5 + GCR_DATA_SIZE)
+
+// bytes per track in each speed zone
+static const size_t trackCapacity[4] = {6250, 6666, 7142, 7692};
+
+static const uint8_t gcrEncode[16] = {0x0A, 0x0B, 0x12, 0x13, 0x0E, 0x0F, 0x16, 0x17,
+                                      0x09, 0x19, 0x1A, 0x1B, 0x0D, 0x1D, 0x1E, 0x15};
+
+// 0xFF marks quintets that are not valid GCR
+static const uint8_t gcrDecode[32] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x08, 0x00, 0x01, 0xFF, 0x0C, 0x04, 0x05,
+    0xFF, 0xFF, 0x02, 0x03, 0xFF, 0x0F, 0x06, 0x07, 0xFF, 0x09, 0x0A, 0x0B, 0xFF, 0x0D, 0x0E, 0xFF};
+
+// every 4 bytes become 5 GCR bytes
+static void encodeGcr(const uint8_t* in, size_t size, uint8_t* out) {
+    for(size_t i = 0; i < size; i += 4) {
+        uint64_t bits = 0;
+        for(size_t j = 0; j < 4; j++) {
+            bits = (bits << 10) | (gcrEncode[in[i + j] >> 4] << 5) | gcrEncode[in[i + j] & 0x0F];
+        }
+        for(int j = 4; j >= 0; j--) {
+            *out++ = bits >> (j * 8);
+        }
+    }
+}
+
+// decodes from a circular track, returns false on invalid GCR
+static bool decodeGcr(const uint8_t* track, size_t length, size_t offset, uint8_t* out,
+                      size_t size) {
+    for(size_t i = 0; i < size; i += 4) {
+        uint64_t bits = 0;
+        for(size_t j = 0; j < 5; j++) {
+            bits = (bits << 8) | track[offset++ % length];
+        }
+        for(int j = 3; j >= 0; j--) {
+            uint8_t high = gcrDecode[(bits >> (j * 10 + 5)) & 0x1F];
+            uint8_t low = gcrDecode[(bits >> (j * 10)) & 0x1F];
+            if(high == 0xFF || low == 0xFF) {
+                return false;
+            }
+            *out++ = (high << 4) | low;
+        }
+    }
+    return true;
+}
+
+// offset of the first byte after the next sync mark, syncs are assumed to end on a byte
+// boundary like they do in images written by a 1541
+static bool findSync(const uint8_t* track, size_t length, size_t start, size_t limit,
+                     size_t& offset) {
+    for(size_t i = start; i < start + limit; i++) {
+        if(track[i % length] == 0xFF && track[(i + 1) % length] != 0xFF) {
+            offset = (i + 1) % length;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool findDataBlock(const uint8_t* track, size_t length, int trackNumber, int sector,
+                          size_t& offset) {
+    size_t position = 0;
+    size_t header;
+    while(position < length && findSync(track, length, position, length - position, header)) {
+        position = header > position ? header : length;
+        uint8_t id[8];
+        if(!decodeGcr(track, length, header, id, 8) || id[0] != 0x08 || id[2] != sector ||
+           id[3] != trackNumber) {
+            continue;
+        }
+        // the data block follows after a short gap
+        if(!findSync(track, length, header + GCR_HEADER_SIZE, 64, offset)) {
+            return false;
+        }
+        uint8_t mark[4];
+        return decodeGcr(track, length, offset, mark, 4) && mark[0] == 0x07;
+    }
+    return false;
+}
+
+static void buildDataBlock(const uint8_t* data, uint8_t* block) {
+    block[0] = 0x07;
+    uint8_t checksum = 0;
+    for(int i = 0; i < D64_SECTOR_SIZE; i++) {
+        block[i + 1] = data[i];
+        checksum ^= data[i];
+    }
+    block[257] = checksum;
+    block[258] = 0x00;
+    block[259] = 0x00;
+}
+
+DiskImage::DiskImage() {
+}
+
+DiskImage::~DiskImage() {
+}
+
+int DiskImage::sectorsPerTrack(int track) {
+    if(track <= 17) return 21;
+    if(track <= 24) return 19;
+    if(track <= 30) return 18;
+    return 17;
+}
+
+int DiskImage::speedZone(int track) {
+    if(track <= 17) return 3;
+    if(track <= 24) return 2;
+    if(track <= 30) return 1;
+    return 0;
+}
+
+bool DiskImage::open(const std::string& path) {
+    for(std::vector<uint8_t>& track : gcrTracks) {
+        track.clear();
+    }
+    if(!file.open(path)) {
+        return false;
+    }
+
+    const uint8_t* data = file.data();
+    size_t size = file.size();
+    g64 = size > 12 && std::memcmp(data, "GCR-1541", 8) == 0;
+    if(g64) {
+        // signature, version, half track count, maximum track size, then the track offsets
+        size_t halfTracks = data[9];
+        if(halfTracks > DISK_HALF_TRACKS || 12 + halfTracks * 8 > size) {
+            std::cerr << "Invalid G64 header: " << path << "\n";
+            file.close();
+            return false;
+        }
+        tracks = static_cast<int>(halfTracks / 2);
+        return true;
+    }
+
+    // the error bytes that some images append are ignored
+    switch(size) {
+    case D64_SIZE:
+    case D64_SIZE_ERRORS:
+        tracks = 35;
+        return true;
+    case D64_40_TRACK_SIZE:
+    case D64_40_TRACK_SIZE_ERRORS:
+        tracks = 40;
+        return true;
+    default:
+        std::cerr << "Unknown disk image size: " << path << "\n";
+        file.close();
+        return false;
+    }
+}
+
+bool DiskImage::save(const std::string& path) const {
+    std::ofstream out(path, std::ios::binary | std::ios::out | std::ios::trunc);
+    if(!out.is_open()) {
+        std::cerr << "Failed to open file: " << path << "\n";
+        return false;
+    }
+    out.write(reinterpret_cast<const char*>(file.data()), file.size());
+    return out.good();
+}
+
+size_t DiskImage::sectorOffset(int track, int sector) const {
+    size_t offset = 0;
+    for(int i = 1; i < track; i++) {
+        offset += sectorsPerTrack(i);
+    }
+    return (offset + sector) * D64_SECTOR_SIZE;
+}
+
+bool DiskImage::readSector(int track, int sector, uint8_t* data) {
+    if(!file.isOpen() || track < 1 || track > tracks || sector < 0 ||
+       sector >= sectorsPerTrack(track)) {
+        return false;
+    }
+
+    if(!g64) {
+        std::memcpy(data, file.data() + sectorOffset(track, sector), D64_SECTOR_SIZE);
+        return true;
+    }
+
+    size_t length;
+    const uint8_t* gcr = getTrack(track * 2, length);
+    size_t offset;
+    uint8_t block[260];
+    if(!gcr || !findDataBlock(gcr, length, track, sector, offset) ||
+       !decodeGcr(gcr, length, offset, block, 260)) {
+        return false;
+    }
+    std::memcpy(data, block + 1, D64_SECTOR_SIZE);
+    return true;
+}
+
+bool DiskImage::writeSector(int track, int sector, const uint8_t* data) {
+    if(!file.isOpen() || track < 1 || track > tracks || sector < 0 ||
+       sector >= sectorsPerTrack(track)) {
+        return false;
+    }
+
+    if(!g64) {
+        std::memcpy(file.data() + sectorOffset(track, sector), data, D64_SECTOR_SIZE);
+        // re-encode in place so the drive keeps a valid pointer to the track
+        if(!gcrTracks[track - 1].empty()) {
+            encodeTrack(track);
+        }
+        return true;
+    }
+
+    size_t length;
+    uint8_t* gcr = const_cast<uint8_t*>(getTrack(track * 2, length));
+    size_t offset;
+    if(!gcr || !findDataBlock(gcr, length, track, sector, offset)) {
+        return false;
+    }
+    uint8_t block[260];
+    uint8_t encoded[GCR_DATA_SIZE];
+    buildDataBlock(data, block);
+    encodeGcr(block, 260, encoded);
+    for(size_t i = 0; i < GCR_DATA_SIZE; i++) {
+        gcr[(offset + i) % length] = encoded[i];
+    }
+    return true;
+}
+
+const uint8_t* DiskImage::getTrack(int halfTrack, size_t& length) {
+    if(!file.isOpen() || halfTrack < 2) {
+        return nullptr;
+    }
+
+    if(g64) {
+        const uint8_t* data = file.data();
+        size_t index = halfTrack - 2;
+        if(index >= data[9]) {
+            return nullptr;
+        }
+        const uint8_t* entry = data + 12 + index * 4;
+        size_t offset = entry[0] | (entry[1] << 8) | (entry[2] << 16) | (entry[3] << 24);
+        if(offset == 0 || offset + 2 > file.size()) {
+            return nullptr;
+        }
+        length = data[offset] | (data[offset + 1] << 8);
+        if(length == 0 || offset + 2 + length > file.size()) {
+            return nullptr;
+        }
+        return data + offset + 2;
+    }
+
+    // D64 images only hold the full tracks
+    int track = halfTrack / 2;
+    if((halfTrack & 1) || track > tracks) {
+        return nullptr;
+    }
+    if(gcrTracks[track - 1].empty()) {
+        encodeTrack(track);
+    }
+    length = gcrTracks[track - 1].size();
+    return gcrTracks[track - 1].data();
+}
+
+void DiskImage::encodeTrack(int track) {
+    int sectors = sectorsPerTrack(track);
+    size_t capacity = trackCapacity[speedZone(track)];
+    std::vector<uint8_t>& gcr = gcrTracks[track - 1];
+    gcr.assign(capacity, 0x55);
+
+    // the disk ID from the BAM is repeated in every sector header
+    const uint8_t* bam = file.data() + sectorOffset(18, 0);
+    uint8_t id1 = bam[0xA2];
+    uint8_t id2 = bam[0xA3];
+
+    size_t gap = (capacity - sectors * GCR_SECTOR_SIZE) / sectors;
+    size_t position = 0;
+    for(int sector = 0; sector < sectors; sector++) {
+        std::memset(&gcr[position], 0xFF, 5);
+        position += 5;
+        uint8_t header[8] = {0x08, static_cast<uint8_t>(sector ^ track ^ id2 ^ id1),
+                             static_cast<uint8_t>(sector), static_cast<uint8_t>(track),
+                             id2, id1, 0x0F, 0x0F};
+        encodeGcr(header, 8, &gcr[position]);
+        position += GCR_HEADER_SIZE + 9;
+
+        std::memset(&gcr[position], 0xFF, 5);
+        position += 5;
+        uint8_t block[260];
+        buildDataBlock(file.data() + sectorOffset(track, sector), block);
+        encodeGcr(block, 260, &gcr[position]);
+        position += GCR_DATA_SIZE + gap;
+    }
+}
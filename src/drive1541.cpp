@@ -0,0 +1,311 @@
+#include <algorithm>
+#include <drive1541.hpp>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+uint8_t DriveVIA1::portBInput() {
+    // bit 0 DATA in, bit 2 CLK in, bit 7 ATN in, bits 5-6 are the device number jumpers
+    SerialPortState state = drive->bus->Read(false);
+    return state.dataLine | (state.clockLine << 2) | (state.atnLine << 7);
+}
+
+void DriveVIA1::portBChanged(uint8_t pins) {
+    drive->updateIec(pins);
+}
+
+uint8_t DriveVIA2::portAInput() {
+    return drive->readLatch;
+}
+
+uint8_t DriveVIA2::portBInput() {
+    // bit 4 write protect sense, bit 7 SYNC, both active low
+    return 0x10 | (!drive->sync << 7);
+}
+
+void DriveVIA2::portBChanged(uint8_t pins) {
+    drive->updateDiskController(pins);
+}
+
+DriveBus::DriveBus(Drive1541* drive) : drive(drive) {
+    for(int i = 0; i < 0x800; i++) {
+        ram[i] = 0x00;
+    }
+    for(int i = 0; i < 0x4000; i++) {
+        rom[i] = 0x00;
+    }
+}
+
+void DriveBus::write(uint16_t addr, uint8_t data) {
+    if(addr & 0x8000) {
+        return;
+    }
+    switch(addr & 0x1C00) {
+    case 0x1800:
+        drive->via1->write(addr, data);
+        return;
+    case 0x1C00:
+        drive->via2->write(addr, data);
+        return;
+    }
+    if(!(addr & 0x1800)) {
+        ram[addr & 0x7FF] = data;
+    }
+}
+
+uint8_t DriveBus::read(uint16_t addr) {
+    // the ROM is mirrored at $8000
+    if(addr & 0x8000) {
+        return rom[addr & 0x3FFF];
+    }
+    switch(addr & 0x1C00) {
+    case 0x1800:
+        return drive->via1->read(addr);
+    case 0x1C00:
+        return drive->via2->read(addr);
+    }
+    if(!(addr & 0x1800)) {
+        return ram[addr & 0x7FF];
+    }
+    return addr >> 8;
+}
+
+Drive1541::Drive1541(SerialBus* bus) : SerialDevice(bus) {
+    driveBus = new DriveBus(this);
+    via1 = new DriveVIA1(this);
+    via2 = new DriveVIA2(this);
+    cpu = new CPUCore<Bus>(driveBus);
+
+    cpu->setCycleCallback([this]() {
+        via1->tick();
+        via2->tick();
+        rotateDisk();
+        // both VIA interrupt outputs are wired to the IRQ line
+        cpu->setIRQ(IRQ_VIA1, via1->irqAsserted());
+        cpu->setIRQ(IRQ_VIA2, via2->irqAsserted());
+    });
+}
+
+Drive1541::~Drive1541() {
+    delete cpu;
+    delete via1;
+    delete via2;
+    delete driveBus;
+}
+
+bool Drive1541::loadRom(const std::string& path, uint16_t address) {
+    std::ifstream file(path, std::ios::binary | std::ios::in | std::ios::ate);
+    if(!file.is_open()) {
+        std::cerr << "Failed to open file: " << path << "\n";
+        return false;
+    }
+
+    std::vector<uint8_t> data(file.tellg());
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(data.data()), data.size());
+    file.close();
+
+    if(!loadRom(data.data(), data.size(), address)) {
+        std::cerr << "Invalid 1541 ROM size: " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool Drive1541::loadRom(const uint8_t* data, size_t size, uint16_t address) {
+    if((size != 0x2000 && size != 0x4000) || address < 0xC000 || address + size > 0x10000) {
+        return false;
+    }
+    std::copy(data, data + size, driveBus->rom + (address - 0xC000));
+
+    for(size_t offset = 0; offset < size; offset += 0x2000) {
+        romHalves |= 1 << ((address - 0xC000 + offset) / 0x2000);
+    }
+    return true;
+}
+
+void Drive1541::powerOn() {
+    via1->reset();
+    via2->reset();
+    motorOn = false;
+    ledOn = false;
+    idleCycles = 0;
+    cpu->powerOn();
+    cpu->cycles = cycle;
+}
+
+void Drive1541::reset() {
+    via1->reset();
+    via2->reset();
+    idleCycles = 0;
+    cpu->reset();
+    cpu->cycles = cycle;
+}
+
+void Drive1541::insertDisk(DiskImage* disk) {
+    this->disk = disk;
+    loadTrack();
+}
+
+void Drive1541::ejectDisk() {
+    disk = nullptr;
+    loadTrack();
+}
+
+bool Drive1541::isActive() const {
+    return motorOn || atnAsserted || idleCycles < DRIVE_IDLE_CYCLES;
+}
+
+void Drive1541::clock() {
+    cycle++;
+    // without the reset vectors in $E000-$FFFF there is nothing to run
+    if(!isRomComplete()) {
+        return;
+    }
+
+    // With the motor off and no ATN for a while DOS is in its idle loop, which runs the job
+    // queue from the VIA2 timer interrupt and otherwise waits for ATN. The CPU and the VIAs
+    // are not run then. When the drive wakes the timers catch up so they keep their phase,
+    // and the interrupts they raised in the meantime are taken once.
+    if(!isActive()) {
+        return;
+    }
+    if(cpu->cycles + 1 < cycle) {
+        size_t skipped = cycle - 1 - cpu->cycles;
+        via1->skip(skipped);
+        via2->skip(skipped);
+        cpu->cycles += skipped;
+        cpu->setIRQ(IRQ_VIA1, via1->irqAsserted());
+        cpu->setIRQ(IRQ_VIA2, via2->irqAsserted());
+    }
+
+    while(cpu->cycles < cycle) {
+        cpu->executeOnce();
+    }
+    idleCycles++;
+}
+
+SerialPortState Drive1541::getIndividualState() {
+    // the ATN acknowledge circuit pulls DATA until DOS answers ATN
+    bool data = dataOut || (atnAsserted != atnAcknowledge);
+    return {data, clockOut, false};
+}
+
+void Drive1541::tick() {
+    idleCycles = 0;
+    bool atn = bus->Read(false).atnLine;
+    if(atn != atnAsserted) {
+        atnAsserted = atn;
+        via1->setCA1(atn);
+    }
+}
+
+void Drive1541::updateIec(uint8_t pins) {
+    // bit 1 DATA out, bit 3 CLK out, bit 4 ATN acknowledge
+    dataOut = pins & 0x02;
+    clockOut = pins & 0x08;
+    atnAcknowledge = pins & 0x10;
+}
+
+void Drive1541::updateDiskController(uint8_t pins) {
+    // bits 0-1 are the stepper motor phase, each step moves the head half a track
+    uint8_t phase = pins & 0x03;
+    uint8_t direction = (phase - stepperPhase) & 0x03;
+    if(direction == 1 && halfTrack < 84) {
+        halfTrack++;
+    } else if(direction == 3 && halfTrack > 2) {
+        halfTrack--;
+    }
+    if(phase != stepperPhase) {
+        stepperPhase = phase;
+        loadTrack();
+    }
+
+    motorOn = pins & 0x04;
+    ledOn = pins & 0x08;
+    // bits 5-6 select the bit rate for the speed zone
+    density = (pins >> 5) & 0x03;
+}
+
+void Drive1541::loadTrack() {
+    trackData = disk ? disk->getTrack(halfTrack, trackLength) : nullptr;
+    if(trackData) {
+        headPosition %= trackLength;
+    }
+}
+
+void Drive1541::rotateDisk() {
+    if(!motorOn || !trackData) {
+        sync = false;
+        return;
+    }
+    if(--byteCycles > 0) {
+        return;
+    }
+    // 32 cycles per byte on the inner tracks down to 26 on the outer ones
+    byteCycles = 32 - density * 2;
+
+    headPosition = (headPosition + 1) % trackLength;
+    uint8_t byte = trackData[headPosition];
+    // SYNC is active while the head reads the run of one bits of a sync mark
+    sync = byte == 0xFF && lastByte == 0xFF;
+    lastByte = byte;
+    if(sync) {
+        return;
+    }
+
+    readLatch = byte;
+    // byte ready sets the overflow flag while SOE on CA2 is high and pulses CA1
+    if(via2->ca2Output()) {
+        cpu->setOverflow();
+    }
+    via2->setCA1(false);
+    via2->setCA1(true);
+}
+
+void Drive1541::saveState(StateWriter& state) const {
+    cpu->saveState(state);
+    state.writeBytes(driveBus->ram, sizeof(driveBus->ram));
+    via1->saveState(state);
+    via2->saveState(state);
+    state.write(cycle);
+    state.write(idleCycles);
+    state.write(atnAsserted);
+    state.write(atnAcknowledge);
+    state.write(dataOut);
+    state.write(clockOut);
+    state.write(motorOn);
+    state.write(ledOn);
+    state.write(stepperPhase);
+    state.write(halfTrack);
+    state.write(density);
+    state.write(headPosition);
+    state.write(byteCycles);
+    state.write(lastByte);
+    state.write(readLatch);
+    state.write(sync);
+}
+
+void Drive1541::loadState(StateReader& state) {
+    cpu->loadState(state);
+    state.readBytes(driveBus->ram, sizeof(driveBus->ram));
+    via1->loadState(state);
+    via2->loadState(state);
+    state.read(cycle);
+    state.read(idleCycles);
+    state.read(atnAsserted);
+    state.read(atnAcknowledge);
+    state.read(dataOut);
+    state.read(clockOut);
+    state.read(motorOn);
+    state.read(ledOn);
+    state.read(stepperPhase);
+    state.read(halfTrack);
+    state.read(density);
+    state.read(headPosition);
+    state.read(byteCycles);
+    state.read(lastByte);
+    state.read(readLatch);
+    state.read(sync);
+    loadTrack();
+}
@@ -1,13 +1,8 @@
 #include <bitset>
 #include <floppy.hpp>
-#include <iostream>
 
 Floppy::Floppy(SerialBus* bus) : SerialDevice(bus) {
     state = {true, false, false};
-    loggingFile.open("floppy.log", std::ios::out | std::ios::trunc);
-    if (!loggingFile.is_open()) {
-        std::cerr << "Failed to open floppy.log" << std::endl;
-    }
 }
 
 SerialPortState Floppy::getIndividualState() {
@@ -24,12 +19,7 @@ void Floppy::shiftBit(bool bit) {
 }
 
 void Floppy::tick() {
-    std::cout << std::endl;
     SerialPortState busState = bus->Read(false);
-    // put the bus state into the logging file
-    loggingFile << static_cast<int>(busState.dataLine) << ","
-                << static_cast<int>(busState.clockLine) << ","
-                << static_cast<int>(busState.atnLine) << std::endl;
     if(!byteTransferInitiated) {
         state.dataLine = true;
         state.clockLine = false;
@@ -37,12 +27,7 @@ void Floppy::tick() {
 
     bool clockLineSwitchOff = !busState.clockLine && lastClockLine != busState.clockLine;
 
-    if (clockLineSwitchOff) {
-        std::cout << "Floppy: clock line changed" << std::endl;
-    }
-
     if(!byteTransferInitiated && !byteTransferComplete && clockLineSwitchOff) {
-        std::cout << "Floppy: clock line low" << std::endl;
         byteTransferInitiated = true;
         shiftRegister = 0;
         bitTransfered = 0;
@@ -50,5 +35,22 @@ void Floppy::tick() {
     }
 
     lastClockLine = busState.clockLine;
-    std::cout << std::endl;
+}
+
+void Floppy::saveState(StateWriter& state) const {
+    state.write(byteTransferInitiated);
+    state.write(byteTransferComplete);
+    state.write(lastClockLine);
+    state.write(bitTransfered);
+    state.write(shiftRegister);
+    state.write(this->state);
+}
+
+void Floppy::loadState(StateReader& state) {
+    state.read(byteTransferInitiated);
+    state.read(byteTransferComplete);
+    state.read(lastClockLine);
+    state.read(bitTransfered);
+    state.read(shiftRegister);
+    state.read(this->state);
 }
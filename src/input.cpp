@@ -1,161 +1,331 @@
 #include <algorithm>
-#include <bitset>
-#include <chrono>
+#include <cpu.hpp>
 #include <input.hpp>
 #include <iostream>
-#include <thread>
+#include <unordered_map>
 
-Input::Input(C64Bus* bus) : bus(bus) {
-    for(int i = 0; i < 8; i++) {
-        keyMatrix[i] = 0xFF;
+static bool findKey(const std::string& name, Key& key) {
+    static std::unordered_map<std::string, Key> indices = []() {
+        std::unordered_map<std::string, Key> map;
+        for(size_t i = 0; i < keys.size(); i++) {
+            map[keys[i]] = static_cast<Key>(i);
+        }
+        return map;
+    }();
+    auto it = indices.find(name);
+    if(it == indices.end()) {
+        std::cerr << "Key not found: " << name << std::endl;
+        return false;
+    }
+    key = it->second;
+    return true;
+}
+
+static uint8_t toPetscii(char c) {
+    c = std::toupper(c);
+    uint8_t petscii = 0;
+    switch(c) {
+    case '\n':
+    case '\r':
+        petscii = 0x0D;
+        break;
+    case 0x0b:
+        petscii = 0x14;
+        break;
+    case ' ':
+        petscii = 0x20;
+        break;
+    case '!':
+        petscii = 0x21;
+        break;
+    case '"':
+        petscii = 0x22;
+        break;
+    case '#':
+        petscii = 0x23;
+        break;
+    case '$':
+        petscii = 0x24;
+        break;
+    case '%':
+        petscii = 0x25;
+        break;
+    case '&':
+        petscii = 0x26;
+        break;
+    case '\'':
+        petscii = 0x27;
+        break;
+    case '(':
+        petscii = 0x28;
+        break;
+    case ')':
+        petscii = 0x29;
+        break;
+    case '*':
+        petscii = 0x2A;
+        break;
+    case '+':
+        petscii = 0x2B;
+        break;
+    case ',':
+        petscii = 0x2C;
+        break;
+    case '-':
+        petscii = 0x2D;
+        break;
+    case '.':
+        petscii = 0x2E;
+        break;
+    case '/':
+        petscii = 0x2F;
+        break;
+    case '\xA3':
+        petscii = 0x5c;
+        break;
+    default:
+        petscii = c;
+        break;
     }
+    return petscii;
+}
+
+Input::Input(C64Bus* bus) : bus(bus) {
+    updateMatrixCache();
 }
 
 Input::~Input() {
-    stopWriteStringThread();
-    if(writeThread.joinable()) {
-        writeThread.join();
+}
+
+void Input::keyDown(Key key, size_t cycle) {
+    post({cycle, InputEventType::KEY_DOWN, key, ""});
+}
+
+void Input::keyUp(Key key, size_t cycle) {
+    post({cycle, InputEventType::KEY_UP, key, ""});
+}
+
+void Input::keyDown(const std::string& name, size_t cycle) {
+    Key key;
+    if(findKey(name, key)) {
+        keyDown(key, cycle);
     }
 }
 
-void Input::setKeyPressed(std::string key, bool pressed) {
-    auto it = std::find(keys.begin(), keys.end(), key);
-    if(it == keys.end()) {
-        std::cerr << "Key not found: " << key << std::endl;
-        return;
+void Input::keyUp(const std::string& name, size_t cycle) {
+    Key key;
+    if(findKey(name, key)) {
+        keyUp(key, cycle);
     }
+}
+
+void Input::typeText(const std::string& text, size_t cycle) {
+    post({cycle, InputEventType::TEXT, Key::COUNT, text});
+}
+
+void Input::setJoystick(uint8_t port, uint8_t bits, size_t cycle) {
+    InputEvent event = {cycle, InputEventType::JOYSTICK, Key::COUNT, ""};
+    event.port = port;
+    event.value = bits;
+    post(event);
+}
+
+void Input::setPaddle(uint8_t port, uint8_t paddle, uint8_t position, size_t cycle) {
+    InputEvent event = {cycle, InputEventType::PADDLE, Key::COUNT, ""};
+    event.port = port;
+    event.paddle = paddle;
+    event.value = position;
+    post(event);
+}
 
+void Input::moveMouse(int16_t dx, int16_t dy, size_t cycle) {
+    InputEvent event = {cycle, InputEventType::MOUSE_MOVE, Key::COUNT, ""};
+    event.dx = dx;
+    event.dy = dy;
+    post(event);
+}
+
+void Input::post(const InputEvent& event) {
+    std::lock_guard<std::mutex> lock(inboxMutex);
+    inbox.push_back(event);
+    inboxPending.store(true, std::memory_order_release);
+}
+
+void Input::setKeyPressed(std::string key, bool pressed) {
     if(pressed) {
-        pressedKeys.insert(key);
+        keyDown(key);
     } else {
-        pressedKeys.erase(key);
+        keyUp(key);
     }
 }
 
 void Input::writeString(std::string str) {
-    // std::lock_guard<std::mutex> lock(writeMutex);
-    // writeStringInternal(str);
-    startWriteStringThread(str);
+    typeText(str);
 }
 
-void Input::startWriteStringThread(std::string str) {
-    stopWriteStringThread();
-    stopThread = false;
-    writeThread = std::thread(&Input::writeStringInternal, this, str);
+// most cycles only compare the cycle counter and check the inbox flag
+void Input::tick() {
+    size_t cycle = cpu->cycles;
+    if(inboxPending.load(std::memory_order_acquire)) {
+        drainInbox(cycle);
+    }
+    if(cycle >= nextEventCycle) {
+        handleEvents(cycle);
+    }
 }
 
-void Input::stopWriteStringThread() {
-    stopThread = true;
-    if(writeThread.joinable()) {
-        writeThread.join();
+void Input::drainInbox(size_t cycle) {
+    std::vector<InputEvent> received;
+    {
+        std::lock_guard<std::mutex> lock(inboxMutex);
+        received.swap(inbox);
+        inboxPending.store(false, std::memory_order_relaxed);
     }
+    for(InputEvent& event : received) {
+        // events from the past or without a cycle happen now
+        event.cycle = std::max(event.cycle, cycle);
+        events.emplace(event.cycle, event);
+    }
+    updateNextEvent(cycle);
 }
 
-void Input::writeStringInternal(std::string str) {
-    const int chunkSize = 10;
-    int length = str.length();
-    int index = 0;
-
-    while(index < length && !stopThread) {
-        if(bus->read(198) != 0) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-            continue;
+void Input::handleEvents(size_t cycle) {
+    while(!events.empty() && events.begin()->first <= cycle) {
+        const InputEvent& event = events.begin()->second;
+        if(eventCallback) {
+            InputEvent applied = event;
+            applied.cycle = cycle;
+            eventCallback(applied);
         }
-
-        int chunkLength = std::min(chunkSize, length - index);
-        for(int i = 0; i < chunkLength; i++) {
-            char c = str[index + i];
-            c = std::toupper(c);
-            uint8_t petscii = 0;
-            switch(c) {
-            case '\n':
-            case '\r':
-                petscii = 0x0D;
-                break;
-            case 0x0b:
-                petscii = 0x14;
-                break;
-            case ' ':
-                petscii = 0x20;
-                break;
-            case '!':
-                petscii = 0x21;
-                break;
-            case '"':
-                petscii = 0x22;
-                break;
-            case '#':
-                petscii = 0x23;
-                break;
-            case '$':
-                petscii = 0x24;
-                break;
-            case '%':
-                petscii = 0x25;
-                break;
-            case '&':
-                petscii = 0x26;
-                break;
-            case '\'':
-                petscii = 0x27;
-                break;
-            case '(':
-                petscii = 0x28;
-                break;
-            case ')':
-                petscii = 0x29;
-                break;
-            case '*':
-                petscii = 0x2A;
-                break;
-            case '+':
-                petscii = 0x2B;
-                break;
-            case ',':
-                petscii = 0x2C;
-                break;
-            case '-':
-                petscii = 0x2D;
-                break;
-            case '.':
-                petscii = 0x2E;
-                break;
-            case '/':
-                petscii = 0x2F;
-                break;
-            case '\xA3':
-                petscii = 0x5c;
-                break;
-            default:
-                petscii = c;
-                break;
+        switch(event.type) {
+        case InputEventType::KEY_DOWN:
+            setKey(event.key, true);
+            break;
+        case InputEventType::KEY_UP:
+            setKey(event.key, false);
+            break;
+        case InputEventType::TEXT:
+            for(char c : event.text) {
+                pendingText.push_back(toPetscii(c));
             }
-            bus->write(631 + i, petscii);
+            break;
+        case InputEventType::JOYSTICK:
+            joysticks[(event.port - 1) & 1] = event.value & 0x1F;
+            break;
+        case InputEventType::PADDLE:
+            paddles[(event.port - 1) & 1][event.paddle & 1] = event.value;
+            break;
+        case InputEventType::MOUSE_MOVE:
+            // the 1351 counts up when moved up
+            mouseX += event.dx;
+            mouseY -= event.dy;
+            break;
         }
-        bus->write(198, chunkLength);
-        index += chunkLength;
+        events.erase(events.begin());
     }
+    typeBufferedText();
+    updateNextEvent(cycle);
 }
 
-uint8_t reverseBits(uint8_t n) {
-    n = ((n & 0xF0) >> 4) | ((n & 0x0F) << 4);
-    n = ((n & 0xCC) >> 2) | ((n & 0x33) << 2);
-    n = ((n & 0xAA) >> 1) | ((n & 0x55) << 1);
-    return n;
+void Input::updateNextEvent(size_t cycle) {
+    nextEventCycle = events.empty() ? SIZE_MAX : events.begin()->first;
+    if(!pendingText.empty()) {
+        nextEventCycle = std::min(nextEventCycle, cycle + INPUT_TEXT_POLL_CYCLES);
+    }
 }
 
-uint8_t Input::readKeyMatrix(uint8_t row) {
-    uint8_t output = 0xFF;
-    for(int i = 0; i < 8; i++) {
-        if((row & (1 << i)) == 0) {
-            int keysRow = 7 - i;
-            for(int col = 0; col < 8; col++) {
-                int keyIndex = keysRow * 8 + col;
-                if(pressedKeys.find(keys[keyIndex]) != pressedKeys.end()) {
-                    output &= ~(1 << (7 - col));
-                }
-            }
-        }
+void Input::typeBufferedText() {
+    if(pendingText.empty() || bus->ram[KEYBOARD_BUFFER_LENGTH] != 0) {
+        return;
+    }
+    uint8_t length = 0;
+    while(length < KEYBOARD_BUFFER_SIZE && !pendingText.empty()) {
+        bus->ram[KEYBOARD_BUFFER + length++] = pendingText.front();
+        pendingText.pop_front();
+    }
+    bus->ram[KEYBOARD_BUFFER_LENGTH] = length;
+}
+
+void Input::saveState(StateWriter& state) const {
+    state.write(keyMatrix);
+    state.writeBytes(joysticks, sizeof(joysticks));
+    state.writeBytes(paddles, sizeof(paddles));
+    state.write(mousePort);
+    state.write(mouseX);
+    state.write(mouseY);
+    state.write(potSelect);
+    state.writeString(std::string(pendingText.begin(), pendingText.end()));
+}
+
+void Input::loadState(StateReader& state) {
+    state.read(keyMatrix);
+    state.readBytes(joysticks, sizeof(joysticks));
+    state.readBytes(paddles, sizeof(paddles));
+    state.read(mousePort);
+    state.read(mouseX);
+    state.read(mouseY);
+    state.read(potSelect);
+    std::string text = state.readString();
+    pendingText.assign(text.begin(), text.end());
+
+    {
+        std::lock_guard<std::mutex> lock(inboxMutex);
+        inbox.clear();
+        inboxPending.store(false, std::memory_order_relaxed);
+    }
+    events.clear();
+    updateMatrixCache();
+    updateNextEvent(cpu->cycles);
+}
+
+uint8_t Input::readPot(uint8_t axis) const {
+    // CIA1 port A bit 6 selects port 1 and bit 7 port 2, nothing is connected otherwise
+    uint8_t port;
+    if(potSelect == 0x01) {
+        port = 1;
+    } else if(potSelect == 0x02) {
+        port = 2;
+    } else {
+        return 0xFF;
+    }
+
+    if(port == mousePort) {
+        // the 1351 reports the position modulo 64 in bits 1-6
+        uint16_t position = axis ? mouseY : mouseX;
+        return (position & 0x3F) << 1;
+    }
+    return paddles[port - 1][axis & 1];
+}
+
+void Input::setKey(Key key, bool pressed) {
+    if(key >= Key::COUNT) {
+        return;
+    }
+    if(key == Key::RESTORE) {
+        cpu->setNMI(NMI_RESTORE, pressed);
+        return;
+    }
+    int index = static_cast<int>(key);
+    int row = 7 - index / 8;
+    int column = 7 - index % 8;
+    uint64_t bit = 1ull << (row * 8 + column);
+    uint64_t matrix = pressed ? keyMatrix | bit : keyMatrix & ~bit;
+    if(matrix != keyMatrix) {
+        keyMatrix = matrix;
+        updateMatrixCache();
+    }
+}
+
+// precomputes port B for every port A value, so reading the keyboard is a table lookup
+void Input::updateMatrixCache() {
+    uint8_t pressedColumns[256];
+    pressedColumns[0xFF] = 0;
+    for(int select = 0xFE; select >= 0; select--) {
+        // add the lowest selected row to the result for the same selection without it
+        int row = __builtin_ctz(~select);
+        uint8_t columns = (keyMatrix >> (row * 8)) & 0xFF;
+        pressedColumns[select] = pressedColumns[select | (1 << row)] | columns;
+        matrixCache[select] = ~pressedColumns[select];
     }
-    return output;
+    matrixCache[0xFF] = 0xFF;
 }
@@ -0,0 +1,133 @@
+#include <cstring>
+#include <lz4.hpp>
+
+namespace lz4 {
+
+static uint32_t hash(const uint8_t* data) {
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return (value * 2654435761U) >> (32 - LZ4_HASH_BITS);
+}
+
+// lengths that do not fit the token continue in bytes of 255 and a final smaller byte
+static void writeLength(std::vector<uint8_t>& output, size_t length) {
+    while(length >= 255) {
+        output.push_back(255);
+        length -= 255;
+    }
+    output.push_back(length);
+}
+
+static bool readLength(const uint8_t* input, size_t inputSize, size_t& ip, size_t& length) {
+    uint8_t extra;
+    do {
+        if(ip >= inputSize) {
+            return false;
+        }
+        extra = input[ip++];
+        length += extra;
+    } while(extra == 255);
+    return true;
+}
+
+static void writeLiterals(std::vector<uint8_t>& output, const uint8_t* literals, size_t length,
+                          uint8_t matchToken) {
+    output.push_back((length < 15 ? length : 15) << 4 | matchToken);
+    if(length >= 15) {
+        writeLength(output, length - 15);
+    }
+    output.insert(output.end(), literals, literals + length);
+}
+
+void compress(const uint8_t* input, size_t size, std::vector<uint8_t>& output) {
+    // positions plus one, zero is an empty slot
+    uint32_t table[1 << LZ4_HASH_BITS];
+    memset(table, 0, sizeof(table));
+
+    size_t literalStart = 0;
+    size_t ip = 0;
+    while(ip + LZ4_MIN_MATCH <= size) {
+        uint32_t h = hash(input + ip);
+        size_t ref = table[h];
+        table[h] = ip + 1;
+        if(ref == 0 || ip + 1 - ref > LZ4_MAX_DISTANCE ||
+           memcmp(input + ref - 1, input + ip, LZ4_MIN_MATCH) != 0) {
+            // step faster through data that does not compress
+            ip += 1 + ((ip - literalStart) >> 6);
+            continue;
+        }
+        ref--;
+
+        size_t length = LZ4_MIN_MATCH;
+        while(ip + length < size && input[ref + length] == input[ip + length]) {
+            length++;
+        }
+
+        size_t matchLength = length - LZ4_MIN_MATCH;
+        writeLiterals(output, input + literalStart, ip - literalStart,
+                      matchLength < 15 ? matchLength : 15);
+        size_t offset = ip - ref;
+        output.push_back(offset & 0xFF);
+        output.push_back(offset >> 8);
+        if(matchLength >= 15) {
+            writeLength(output, matchLength - 15);
+        }
+
+        ip += length;
+        literalStart = ip;
+    }
+
+    // the last sequence only has literals and ends the block
+    writeLiterals(output, input + literalStart, size - literalStart, 0);
+}
+
+bool decompress(const uint8_t* input, size_t inputSize, uint8_t* output, size_t size) {
+    size_t ip = 0;
+    size_t op = 0;
+    while(ip < inputSize) {
+        uint8_t token = input[ip++];
+
+        size_t literals = token >> 4;
+        if(literals == 15 && !readLength(input, inputSize, ip, literals)) {
+            return false;
+        }
+        if(literals > inputSize - ip || literals > size - op) {
+            return false;
+        }
+        memcpy(output + op, input + ip, literals);
+        ip += literals;
+        op += literals;
+        if(ip == inputSize) {
+            break;
+        }
+
+        if(inputSize - ip < 2) {
+            return false;
+        }
+        size_t offset = input[ip] | (input[ip + 1] << 8);
+        ip += 2;
+        size_t length = (token & 0x0F) + LZ4_MIN_MATCH;
+        if((token & 0x0F) == 15 && !readLength(input, inputSize, ip, length)) {
+            return false;
+        }
+        if(offset == 0 || offset > op || length > size - op) {
+            return false;
+        }
+
+        // a match closer than its length repeats the bytes it is writing
+        uint8_t* match = output + op - offset;
+        if(offset >= length) {
+            memcpy(output + op, match, length);
+        } else if(offset == 1) {
+            memset(output + op, *match, length);
+        } else {
+            for(size_t i = 0; i < length; i++) {
+                output[op + i] = match[i];
+            }
+        }
+        op += length;
+    }
+    return op == size;
+}
+
+} // namespace lz4
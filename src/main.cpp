@@ -5,7 +5,10 @@
 #include <fstream>
 #include <iostream>
 #include <sys/types.h>
+#include <profiler.hpp>
+#include <replay.hpp>
 #include <system.hpp>
+#include <sid_player.hpp>
 #include <cctype>
 
 void write_bmp(const std::array<uint32_t, 40 * 25 * 8 * 8>& screen,
@@ -106,9 +109,54 @@ void write_bmp(const std::array<uint32_t, 40 * 25 * 8 * 8>& screen,
     ofs.close();
 }
 
-int main() {
+// usage: C64 --sid <file.sid> [song] [seconds]
+int playSid(int argc, char** argv) {
+    System system;
+    SidPlayer player(&system);
+    if(!player.load(argv[2])) {
+        return 1;
+    }
+
+    uint16_t song = argc > 3 ? std::stoi(argv[3]) : 0;
+    size_t seconds = argc > 4 ? std::stoul(argv[4]) : 180;
+
+    const SidHeader& header = player.getHeader();
+    std::cout << header.name << " - " << header.author << " (" << header.released << ")"
+              << std::endl;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    player.start(song);
+    player.run(seconds * SID_CLOCK_SPEED);
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+    std::cout << "Played song " << player.getCurrentSong() << "/" << header.songs << " for "
+              << seconds << "s in " << elapsed.count() << "s" << std::endl;
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if(argc > 2 && std::string(argv[1]) == "--sid") {
+        return playSid(argc, argv);
+    }
+
     bool running = true;
     System system;
+    // usage: C64 --1541 <rom> [upper rom], C64 --drive <directory or disk image> or
+    // C64 --crt <file>. The true drive needs the whole 16K DOS, 1541-c000.325302-01.bin in the
+    // repository is only the $C000 half, the $E000 half is 901229-05.
+    if(argc > 2 && std::string(argv[1]) == "--1541") {
+        if(!system.enableTrueDrive(argv[2], argc > 3 ? argv[3] : "")) {
+            return 1;
+        }
+    } else if(argc > 2 && std::string(argv[1]) == "--drive") {
+        if(!system.enableVirtualDrive(argv[2])) {
+            return 1;
+        }
+    } else if(argc > 2 && std::string(argv[1]) == "--crt") {
+        if(!system.bus->loadCartridge(argv[2])) {
+            return 1;
+        }
+    }
     int i = 0;
     system.vic->setFramebufferCallback([&i](std::array<uint32_t, 40 * 25 * 8 * 8>& screen) {
         write_bmp(screen, "../output/" + std::to_string(i % 2) + ".bmp");
@@ -116,9 +164,54 @@ int main() {
     });
 
     system.powerOn();
+    // usage: C64 --prg <file>
+    if(argc > 2 && std::string(argv[1]) == "--prg") {
+        if(!system.loadPrg(argv[2])) {
+            return 1;
+        }
+    }
+    // usage: C64 --trace <file>, decode it with tracedump
+    if(argc > 2 && std::string(argv[1]) == "--trace") {
+        if(!system.cpu->startTrace(argv[2])) {
+            return 1;
+        }
+    }
+    // usage: C64 --profile <file>, rewrites the collapsed stacks every second for flamegraph.pl
+    Profiler profiler;
+    std::string profilePath;
+    if(argc > 2 && std::string(argv[1]) == "--profile") {
+        profilePath = argv[2];
+        if(!profiler.writeCollapsedStacks(profilePath)) {
+            return 1;
+        }
+        system.cpu->setProfiler(&profiler);
+    }
+    // usage: C64 --metrics <file>, appends the counters as a JSON line every second
+    if(argc > 2 && std::string(argv[1]) == "--metrics") {
+        system.setMetricsTiming(true);
+        if(!system.setMetricsLog(argv[2])) {
+            return 1;
+        }
+    }
+    // usage: C64 --cycle-stepped
+    if(argc > 1 && std::string(argv[1]) == "--cycle-stepped") {
+        system.setCycleStepped(true);
+    }
+    // usage: C64 --replay <file>, plays the recording and continues from its end
+    Replay replay;
+    if(argc > 2 && std::string(argv[1]) == "--replay") {
+        if(!replay.load(argv[2])) {
+            return 1;
+        }
+        ReplayPlayer player(&system, replay);
+        if(!player.seek(replay.endCycle)) {
+            return 1;
+        }
+    }
 
     std::chrono::time_point<std::chrono::high_resolution_clock> lastTime =
         std::chrono::high_resolution_clock::now();
+    auto lastProfileTime = lastTime;
     bool written = false;
     while(running) {
         if(lastTime + std::chrono::milliseconds(100) < std::chrono::high_resolution_clock::now()) {
@@ -128,255 +221,12 @@ int main() {
             }
             lastTime = std::chrono::high_resolution_clock::now();
         }
+        if(!profilePath.empty() && lastProfileTime + std::chrono::seconds(1) < lastTime) {
+            profiler.writeCollapsedStacks(profilePath);
+            lastProfileTime = lastTime;
+        }
         system.step();
     }
     return 0;
 }
 #endif
-
-// #include <iostream>
-// #include <vector>
-// #include <cstring>
-// #include <algorithm>
-// #include <cstdint>
-
-// #include <cstdint>
-// #include <cstring>
-// #include <vector>
-// #include <string>
-// #include <stdexcept>
-
-// namespace lz4 {
-
-// constexpr int HASH_TABLE_SIZE = 1 << 16;
-// constexpr int MIN_MATCH = 4;
-// constexpr int MAX_MATCH = 0x7F + MIN_MATCH;
-// constexpr int MAX_DISTANCE = 0xFFFF;
-
-// inline uint32_t hash(const uint8_t* data) {
-//     // Handle unaligned memory access more safely
-//     uint32_t val;
-//     std::memcpy(&val, data, sizeof(uint32_t));
-//     return (val * 2654435761U) >> 16;
-// }
-
-// std::vector<uint8_t> compress(const uint8_t* input, size_t input_size) {
-//     std::vector<uint8_t> output;
-//     output.reserve(input_size * 1.1);
-
-//     std::vector<uint32_t> hash_table(HASH_TABLE_SIZE, 0);
-
-//     size_t ip = 0;
-
-//     while (ip < input_size) {
-//         size_t token_pos = output.size();
-//         output.push_back(0);
-
-//         size_t literal_start = ip;
-
-//         size_t matched = 0;
-//         while (ip + MIN_MATCH <= input_size && !matched) {
-//             uint32_t h = hash(&input[ip]);
-//             size_t ref = hash_table[h];
-//             hash_table[h] = ip;
-
-//             size_t distance = (ref > 0) ? ip - ref : 0;
-
-//             if (distance > 0 && distance < MAX_DISTANCE &&
-//                 memcmp(&input[ref], &input[ip], MIN_MATCH) == 0) {
-
-//                 size_t match_len = MIN_MATCH;
-//                 while (match_len < MAX_MATCH &&
-//                        ip + match_len < input_size &&
-//                        input[ref + match_len] == input[ip + match_len]) {
-//                     match_len++;
-//                 }
-
-//                 size_t literal_len = ip - literal_start;
-//                 if (literal_len < 15) {
-//                     output[token_pos] = literal_len << 4;
-//                 } else {
-//                     output[token_pos] = 15 << 4;
-//                     size_t remain = literal_len - 15;
-//                     while (remain >= 255) {
-//                         output.push_back(255);
-//                         remain -= 255;
-//                     }
-//                     output.push_back(static_cast<uint8_t>(remain));
-//                 }
-
-//                 output.insert(output.end(), &input[literal_start], &input[literal_start +
-//                 literal_len]);
-
-//                 if (match_len < 15 + MIN_MATCH) {
-//                     output[token_pos] |= (match_len - MIN_MATCH);
-//                 } else {
-//                     output[token_pos] |= 15;
-//                     size_t remain = match_len - MIN_MATCH - 15;
-//                     while (remain >= 255) {
-//                         output.push_back(255);
-//                         remain -= 255;
-//                     }
-//                     output.push_back(static_cast<uint8_t>(remain));
-//                 }
-
-//                 output.push_back(distance & 0xFF);
-//                 output.push_back((distance >> 8) & 0xFF);
-
-//                 ip += match_len;
-//                 matched = 1;
-//             } else {
-//                 ip++;
-//             }
-//         }
-
-//         if (!matched) {
-//             size_t literal_len = input_size - literal_start;
-
-//             if (literal_len < 15) {
-//                 output[token_pos] = literal_len << 4;
-//             } else {
-//                 output[token_pos] = 15 << 4;
-//                 size_t remain = literal_len - 15;
-//                 while (remain >= 255) {
-//                     output.push_back(255);
-//                     remain -= 255;
-//                 }
-//                 output.push_back(static_cast<uint8_t>(remain));
-//             }
-
-//             output.insert(output.end(), &input[literal_start], &input[literal_start +
-//             literal_len]); ip = input_size;
-//         }
-//     }
-
-//     return output;
-// }
-
-// std::vector<uint8_t> decompress(const uint8_t* input, size_t input_size, size_t max_output_size)
-// {
-//     std::vector<uint8_t> output;
-//     output.reserve(max_output_size);
-
-//     size_t ip = 0;
-
-//     while (ip < input_size) {
-//         if (ip >= input_size) break;
-//         uint8_t token = input[ip++];
-
-//         size_t literal_len = token >> 4;
-//         if (literal_len == 15) {
-//             uint8_t extra_len;
-//             do {
-//                 if (ip >= input_size)
-//                     throw std::runtime_error("Unexpected end of input");
-
-//                 extra_len = input[ip++];
-//                 literal_len += extra_len;
-//             } while (extra_len == 255 && ip < input_size);
-//         }
-
-//         if (ip + literal_len > input_size) {
-//             throw std::runtime_error("Literal length exceeds input buffer");
-//         }
-
-//         output.insert(output.end(), &input[ip], &input[ip + literal_len]);
-//         ip += literal_len;
-
-//         if (ip >= input_size) break;
-
-//         if (ip + 2 > input_size) {
-//             throw std::runtime_error("Unexpected end of input");
-//         }
-
-//         uint16_t offset = input[ip] | (input[ip + 1] << 8);
-//         ip += 2;
-
-//         if (offset == 0 || offset > output.size()) {
-//             throw std::runtime_error("Invalid match offset: " + std::to_string(offset) +
-//                                      ", output size: " + std::to_string(output.size()));
-//         }
-
-//         size_t match_len = (token & 0x0F) + MIN_MATCH;
-//         if (match_len == 15 + MIN_MATCH) {
-//             uint8_t extra_len;
-//             do {
-//                 if (ip >= input_size)
-//                     throw std::runtime_error("Unexpected end of input");
-
-//                 extra_len = input[ip++];
-//                 match_len += extra_len;
-//             } while (extra_len == 255 && ip < input_size);
-//         }
-
-//         size_t match_pos = output.size() - offset;
-//         if (output.size() + match_len > max_output_size) {
-//             throw std::runtime_error("Decompressed data exceeds max output size");
-//         }
-
-//         for (size_t i = 0; i < match_len; i++) {
-//             output.push_back(output[match_pos + i]);
-//         }
-//     }
-
-//     return output;
-// }
-
-// std::vector<uint8_t> compress(const std::vector<uint8_t>& input) {
-//     return compress(input.data(), input.size());
-// }
-
-// std::vector<uint8_t> decompress(const std::vector<uint8_t>& input, size_t max_output_size) {
-//     return decompress(input.data(), input.size(), max_output_size);
-// }
-
-// std::vector<uint8_t> compress(const std::string& input) {
-//     return compress((const uint8_t*)input.data(), input.size());
-// }
-
-// std::string decompress_to_string(const std::vector<uint8_t>& input, size_t max_output_size) {
-//     auto decompressed = decompress(input, max_output_size);
-//     return std::string(decompressed.begin(), decompressed.end());
-// }
-
-// }
-
-// #include <chrono>
-
-// int main() {
-//     std::string message = "This is a test message for LZ4 compression. "
-//                          "It contains repeated patterns like this this this to demonstrate
-//                          compression.";
-
-//     auto compressed = lz4::compress(message);
-//     std::cout << "Compressed size: " << compressed.size() << " bytes\n";
-
-//     auto decompressed = lz4::decompress_to_string(compressed, message.size());
-//     std::cout << "Decompressed message: " << decompressed << "\n";
-//     std::cout << "Decompressed size: " << decompressed.size() << " bytes\n";
-//     std::cout << "Original message: " << message << "\n";
-//     std::cout << "Original size: " << message.size() << " bytes\n";
-//     if (message == decompressed) {
-//         std::cout << "Decompression successful!\n";
-//     } else {
-//         std::cout << "Decompression failed!\n";
-//     }
-
-//     // now test performance
-//     auto start = std::chrono::high_resolution_clock::now();
-//     for (int i = 0; i < 100000; i++) {
-//         auto compressed = lz4::compress(message);
-//         auto decompressed = lz4::decompress_to_string(compressed, message.size());
-//         if (message != decompressed) {
-//             std::cout << "Decompression failed!\n";
-//             return 1;
-//         }
-//     }
-//     auto end = std::chrono::high_resolution_clock::now();
-//     std::chrono::duration<double> elapsed = end - start;
-//     std::cout << "Elapsed time: " << elapsed.count() << " seconds\n";
-//     std::cout << "Compression speed: " << (100000.0 / elapsed.count()) << " compressions per
-//     second\n";
-
-//     return 0;
-// }
@@ -0,0 +1,50 @@
+#include <fcntl.h>
+#include <iostream>
+#include <mapped_file.hpp>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile() {
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string& path) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        std::cerr << "Failed to open file: " << path << "\n";
+        return false;
+    }
+
+    struct stat info;
+    if(fstat(fd, &info) != 0 || info.st_size == 0) {
+        std::cerr << "Failed to stat file: " << path << "\n";
+        ::close(fd);
+        return false;
+    }
+
+    void* address = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    // the mapping keeps its own reference to the file
+    ::close(fd);
+    if(address == MAP_FAILED) {
+        std::cerr << "Failed to map file: " << path << "\n";
+        return false;
+    }
+
+    mapping = static_cast<uint8_t*>(address);
+    length = info.st_size;
+    return true;
+}
+
+void MappedFile::close() {
+    if(mapping) {
+        munmap(mapping, length);
+        mapping = nullptr;
+        length = 0;
+    }
+}
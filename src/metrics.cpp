@@ -0,0 +1,23 @@
+#include <metrics.hpp>
+
+static const char* regionNames[METRICS_REGIONS] = {"ram", "rom", "io", "colorRam"};
+
+static void writeRegions(std::ostream& out, const char* name, const uint64_t* counters) {
+    out << "\"" << name << "\":{";
+    for(int i = 0; i < METRICS_REGIONS; i++) {
+        out << (i ? "," : "") << "\"" << regionNames[i] << "\":" << counters[i];
+    }
+    out << "}";
+}
+
+void Metrics::writeJson(std::ostream& out) const {
+    out << "{\"time\":" << time << ",\"instructions\":" << instructions
+        << ",\"cycles\":" << cycles << ",\"frames\":" << frames << ",\"irqs\":" << irqs
+        << ",\"nmis\":" << nmis << ",\"clockSpeed\":" << clockSpeed
+        << ",\"frameNs\":" << frameNanoseconds << ",\"renderNs\":" << renderNanoseconds
+        << ",\"sidNs\":" << sidNanoseconds << ",";
+    writeRegions(out, "reads", bus.reads);
+    out << ",";
+    writeRegions(out, "writes", bus.writes);
+    out << "}";
+}
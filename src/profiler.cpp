@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <profiler.hpp>
+
+Profiler::Profiler() {
+    reset();
+}
+
+void Profiler::reset() {
+    pcCycles.assign(0x10000, 0);
+    nodes.clear();
+    for(uint32_t root : {PROFILE_MAIN, PROFILE_IRQ, PROFILE_NMI}) {
+        nodes.push_back({root, 0, 0, 0});
+    }
+    children.clear();
+    stack.clear();
+    current = PROFILE_MAIN;
+}
+
+void Profiler::call(uint16_t routine, uint8_t sp, uint32_t parent) {
+    uint64_t key = (static_cast<uint64_t>(parent) << 16) | routine;
+    auto child = children.find(key);
+    uint32_t node;
+    if(child != children.end()) {
+        node = child->second;
+    } else {
+        node = nodes.size();
+        nodes.push_back({parent, routine, 0, 0});
+        children.emplace(key, node);
+    }
+    nodes[node].calls++;
+    stack.push_back({node, sp});
+    current = node;
+}
+
+void Profiler::unwind(uint8_t sp) {
+    // the caller's stack pointer is above the return address, so any frame at or below
+    // the current stack pointer has returned
+    while(!stack.empty() && stack.back().sp <= sp) {
+        stack.pop_back();
+    }
+    current = stack.empty() ? PROFILE_MAIN : stack.back().node;
+}
+
+// cycles of every node including its callees, children are always created after their parent
+std::vector<uint64_t> Profiler::getTotals() const {
+    std::vector<uint64_t> totals(nodes.size());
+    for(size_t i = 0; i < nodes.size(); i++) {
+        totals[i] = nodes[i].exclusive;
+    }
+    for(size_t i = nodes.size() - 1; i > PROFILE_NMI; i--) {
+        totals[nodes[i].parent] += totals[i];
+    }
+    return totals;
+}
+
+uint64_t Profiler::getInterruptCycles() const {
+    std::vector<uint64_t> totals = getTotals();
+    return totals[PROFILE_IRQ] + totals[PROFILE_NMI];
+}
+
+std::vector<ProfileRoutine> Profiler::getRoutines() const {
+    std::vector<uint64_t> totals = getTotals();
+    std::map<uint16_t, ProfileRoutine> routines;
+    for(size_t i = PROFILE_NMI + 1; i < nodes.size(); i++) {
+        const ProfileNode& node = nodes[i];
+        ProfileRoutine& routine = routines[node.routine];
+        routine.routine = node.routine;
+        routine.calls += node.calls;
+        routine.exclusive += node.exclusive;
+
+        // recursive calls are already part of the outermost one
+        bool recursive = false;
+        for(uint32_t parent = node.parent; parent > PROFILE_NMI; parent = nodes[parent].parent) {
+            if(nodes[parent].routine == node.routine) {
+                recursive = true;
+                break;
+            }
+        }
+        if(!recursive) {
+            routine.inclusive += totals[i];
+        }
+    }
+
+    std::vector<ProfileRoutine> sorted;
+    for(const auto& routine : routines) {
+        sorted.push_back(routine.second);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const ProfileRoutine& a, const ProfileRoutine& b) {
+        return a.inclusive > b.inclusive;
+    });
+    return sorted;
+}
+
+std::string Profiler::getStack(uint32_t node) const {
+    static const char* roots[] = {"main", "IRQ", "NMI"};
+    std::string stack;
+    for(; node > PROFILE_NMI; node = nodes[node].parent) {
+        char name[8];
+        snprintf(name, sizeof(name), ";$%04X", nodes[node].routine);
+        stack.insert(0, name);
+    }
+    return roots[node] + stack;
+}
+
+bool Profiler::writeCollapsedStacks(const std::string& path) const {
+    std::ofstream file(path, std::ios::out | std::ios::trunc);
+    if(!file.is_open()) {
+        std::cerr << "Failed to open file: " << path << "\n";
+        return false;
+    }
+    for(size_t i = 0; i < nodes.size(); i++) {
+        if(nodes[i].exclusive) {
+            file << getStack(i) << " " << nodes[i].exclusive << "\n";
+        }
+    }
+    return file.good();
+}
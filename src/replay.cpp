@@ -0,0 +1,309 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <replay.hpp>
+#include <system.hpp>
+
+#define FNV_OFFSET_BASIS 0xCBF29CE484222325ULL
+#define FNV_PRIME 0x100000001B3ULL
+
+// FNV-1a of the whole file, 0 for a directory or a file that cannot be read
+static uint64_t hashFile(const std::string& path) {
+    if(!std::filesystem::is_regular_file(path)) {
+        return 0;
+    }
+    std::ifstream file(path, std::ios::binary | std::ios::in);
+    uint64_t hash = FNV_OFFSET_BASIS;
+    char buffer[4096];
+    while(file.read(buffer, sizeof(buffer)) || file.gcount() > 0) {
+        for(std::streamsize i = 0; i < file.gcount(); i++) {
+            hash = (hash ^ static_cast<uint8_t>(buffer[i])) * FNV_PRIME;
+        }
+    }
+    return hash;
+}
+
+bool Replay::save(const std::string& path) const {
+    std::vector<uint8_t> data;
+    StateWriter writer(data);
+    writer.write<uint32_t>(REPLAY_MAGIC);
+    writer.write<uint16_t>(REPLAY_VERSION);
+    writer.write(keyframeFrames);
+    writer.write(endCycle);
+
+    writer.write<uint64_t>(events.size());
+    for(const ReplayEvent& event : events) {
+        writer.write(event.cycle);
+        writer.write(event.type);
+        if(event.type == ReplayEventType::INPUT) {
+            const InputEvent& input = event.input;
+            writer.write(input.type);
+            writer.write(input.key);
+            writer.writeString(input.text);
+            writer.write(input.port);
+            writer.write(input.value);
+            writer.write(input.paddle);
+            writer.write(input.dx);
+            writer.write(input.dy);
+        } else {
+            writer.writeString(event.path);
+            writer.write(event.hash);
+            writer.write(event.argument);
+        }
+    }
+
+    writer.write<uint64_t>(keyframes.size());
+    for(const ReplayKeyframe& keyframe : keyframes) {
+        writer.write(keyframe.cycle);
+        writer.write(keyframe.nextEvent);
+        writer.write<uint64_t>(keyframe.state.size());
+        writer.writeBytes(keyframe.state.data(), keyframe.state.size());
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::out | std::ios::trunc);
+    if(!file.is_open()) {
+        std::cerr << "Failed to open file: " << path << "\n";
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(data.data()), data.size());
+    return file.good();
+}
+
+bool Replay::load(const std::string& path) {
+    std::ifstream file(path, std::ios::binary | std::ios::in);
+    if(!file.is_open()) {
+        std::cerr << "Failed to open file: " << path << "\n";
+        return false;
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),
+                              std::istreambuf_iterator<char>());
+
+    StateReader reader(data);
+    if(reader.read<uint32_t>() != REPLAY_MAGIC || reader.read<uint16_t>() != REPLAY_VERSION) {
+        std::cerr << "Not a replay of this version: " << path << "\n";
+        return false;
+    }
+    reader.read(keyframeFrames);
+    reader.read(endCycle);
+
+    events.clear();
+    uint64_t count = reader.read<uint64_t>();
+    for(uint64_t i = 0; i < count && reader.isValid(); i++) {
+        ReplayEvent event;
+        reader.read(event.cycle);
+        reader.read(event.type);
+        if(event.type == ReplayEventType::INPUT) {
+            InputEvent& input = event.input;
+            input.cycle = event.cycle;
+            reader.read(input.type);
+            reader.read(input.key);
+            input.text = reader.readString();
+            reader.read(input.port);
+            reader.read(input.value);
+            reader.read(input.paddle);
+            reader.read(input.dx);
+            reader.read(input.dy);
+        } else {
+            event.path = reader.readString();
+            reader.read(event.hash);
+            reader.read(event.argument);
+        }
+        events.push_back(event);
+    }
+
+    keyframes.clear();
+    count = reader.read<uint64_t>();
+    for(uint64_t i = 0; i < count && reader.isValid(); i++) {
+        ReplayKeyframe keyframe;
+        reader.read(keyframe.cycle);
+        reader.read(keyframe.nextEvent);
+        uint64_t size = reader.read<uint64_t>();
+        if(size > data.size()) {
+            break;
+        }
+        keyframe.state.resize(size);
+        reader.readBytes(keyframe.state.data(), size);
+        keyframes.push_back(std::move(keyframe));
+    }
+
+    if(!reader.isValid() || !reader.atEnd() || keyframes.empty()) {
+        std::cerr << "Replay is truncated or corrupt: " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+ReplayRecorder::ReplayRecorder(System* system, uint32_t keyframeFrames) : system(system) {
+    replay.keyframeFrames = keyframeFrames;
+    // so seeking puts them back in before loading a keyframe
+    if(system->bus->cartridge) {
+        recordMedia(ReplayEventType::CARTRIDGE, system->bus->cartridge->getPath());
+    }
+    if(system->virtualDrive && !system->virtualDrive->getPath().empty()) {
+        recordMedia(ReplayEventType::VIRTUAL_DRIVE, system->virtualDrive->getPath(),
+                    system->virtualDrive->getDevice());
+    }
+    addKeyframe();
+    nextKeyframeFrame = system->vic->frameCount + keyframeFrames;
+
+    system->recorder = this;
+    system->input->setEventCallback([this](const InputEvent& input) {
+        ReplayEvent event;
+        event.cycle = input.cycle;
+        event.type = ReplayEventType::INPUT;
+        event.input = input;
+        replay.events.push_back(event);
+    });
+}
+
+ReplayRecorder::~ReplayRecorder() {
+    if(system->recorder == this) {
+        system->recorder = nullptr;
+        system->input->setEventCallback(nullptr);
+    }
+}
+
+void ReplayRecorder::update() {
+    if(system->vic->frameCount >= nextKeyframeFrame) {
+        addKeyframe();
+        nextKeyframeFrame = system->vic->frameCount + replay.keyframeFrames;
+    }
+}
+
+void ReplayRecorder::recordMedia(ReplayEventType type, const std::string& path, uint8_t argument) {
+    ReplayEvent event;
+    event.cycle = system->cpu->cycles;
+    event.type = type;
+    event.path = path;
+    event.hash = hashFile(path);
+    event.argument = argument;
+    replay.events.push_back(event);
+}
+
+const Replay& ReplayRecorder::getReplay() {
+    replay.endCycle = system->cpu->cycles;
+    return replay;
+}
+
+bool ReplayRecorder::save(const std::string& path) {
+    return getReplay().save(path);
+}
+
+void ReplayRecorder::addKeyframe() {
+    ReplayKeyframe keyframe;
+    keyframe.cycle = system->cpu->cycles;
+    keyframe.nextEvent = replay.events.size();
+    system->saveState(keyframe.state);
+    replay.keyframes.push_back(std::move(keyframe));
+}
+
+ReplayPlayer::ReplayPlayer(System* system, const Replay& replay)
+    : system(system), replay(replay) {
+}
+
+bool ReplayPlayer::seek(size_t cycle) {
+    auto after = std::upper_bound(
+        replay.keyframes.begin(), replay.keyframes.end(), cycle,
+        [](size_t cycle, const ReplayKeyframe& keyframe) { return cycle < keyframe.cycle; });
+    if(after == replay.keyframes.begin()) {
+        std::cerr << "Replay starts after cycle " << cycle << std::endl;
+        return false;
+    }
+    const ReplayKeyframe& keyframe = *(after - 1);
+
+    size_t now = system->cpu->cycles;
+    if(!started || now > cycle || now < keyframe.cycle) {
+        // the snapshot only fits the cartridge it was taken with
+        if(!restoreMedia(keyframe.nextEvent) || !system->loadState(keyframe.state)) {
+            return false;
+        }
+        started = true;
+        nextEvent = keyframe.nextEvent;
+        // Input applies them on their cycle, also while a PRG load runs the KERNAL
+        for(size_t i = nextEvent; i < replay.events.size(); i++) {
+            if(replay.events[i].type == ReplayEventType::INPUT) {
+                system->input->post(replay.events[i].input);
+            }
+        }
+    }
+    return runUntil(cycle);
+}
+
+bool ReplayPlayer::runUntil(size_t cycle) {
+    CPU* cpu = system->cpu;
+    while(true) {
+        while(nextEvent < replay.events.size() && replay.events[nextEvent].cycle <= cpu->cycles) {
+            const ReplayEvent& event = replay.events[nextEvent++];
+            if(event.type != ReplayEventType::INPUT && !checkMedia(event)) {
+                return false;
+            }
+            switch(event.type) {
+            case ReplayEventType::INPUT:
+                break;
+            case ReplayEventType::PRG:
+                system->loadPrg(event.path, event.argument);
+                break;
+            case ReplayEventType::CARTRIDGE:
+                system->insertCartridge(event.path);
+                cartridgeEvent = nextEvent - 1;
+                break;
+            case ReplayEventType::VIRTUAL_DRIVE:
+                system->enableVirtualDrive(event.path, event.argument);
+                driveEvent = nextEvent - 1;
+                break;
+            }
+        }
+        if(cpu->cycles >= cycle) {
+            break;
+        }
+        cpu->executeOnce();
+    }
+    return true;
+}
+
+bool ReplayPlayer::restoreMedia(size_t event) {
+    size_t cartridge = SIZE_MAX;
+    size_t drive = SIZE_MAX;
+    for(size_t i = 0; i < event; i++) {
+        if(replay.events[i].type == ReplayEventType::CARTRIDGE) {
+            cartridge = i;
+        } else if(replay.events[i].type == ReplayEventType::VIRTUAL_DRIVE) {
+            drive = i;
+        }
+    }
+
+    // with nothing recorded before the keyframe the setup the player started with stays
+    if(cartridge != cartridgeEvent) {
+        if(cartridge == SIZE_MAX) {
+            system->bus->removeCartridge();
+        } else if(!checkMedia(replay.events[cartridge]) ||
+                  !system->bus->loadCartridge(replay.events[cartridge].path.c_str())) {
+            return false;
+        }
+        cartridgeEvent = cartridge;
+    }
+    if(drive != driveEvent) {
+        if(drive == SIZE_MAX) {
+            system->disableVirtualDrive();
+        } else if(!checkMedia(replay.events[drive]) ||
+                  !system->enableVirtualDrive(replay.events[drive].path,
+                                              replay.events[drive].argument)) {
+            return false;
+        }
+        driveEvent = drive;
+    }
+    return true;
+}
+
+bool ReplayPlayer::checkMedia(const ReplayEvent& event) const {
+    if(hashFile(event.path) != event.hash) {
+        std::cerr << "File changed since it was recorded: " << event.path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool ReplayPlayer::isFinished() const {
+    return started && system->cpu->cycles >= replay.endCycle;
+}
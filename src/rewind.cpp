@@ -0,0 +1,116 @@
+#include <iostream>
+#include <lz4.hpp>
+#include <rewind.hpp>
+#include <system.hpp>
+
+RewindBuffer::RewindBuffer(System* system, size_t frames, size_t keyframeFrames)
+    : system(system), capacity(frames), keyframeFrames(keyframeFrames) {
+    lastFrame = system->vic->frameCount;
+    system->rewind = this;
+}
+
+RewindBuffer::~RewindBuffer() {
+    if(system->rewind == this) {
+        system->rewind = nullptr;
+    }
+}
+
+void RewindBuffer::update() {
+    if(system->vic->frameCount != lastFrame) {
+        lastFrame = system->vic->frameCount;
+        capture();
+    }
+}
+
+bool RewindBuffer::stepBack() {
+    // the newest frame is where the machine already is until it runs on
+    if(!frames.empty() && frames.back().cycle >= system->cpu->cycles) {
+        frames.pop_back();
+    }
+    if(frames.empty()) {
+        return false;
+    }
+    return restore(frames.size() - 1);
+}
+
+void RewindBuffer::clear() {
+    frames.clear();
+    keyframeCycle = SIZE_MAX;
+}
+
+size_t RewindBuffer::getMemoryUsage() const {
+    size_t usage = keyframe.capacity() + state.capacity() + delta.capacity();
+    for(const RewindFrame& frame : frames) {
+        usage += sizeof(RewindFrame) + frame.data.capacity();
+    }
+    return usage;
+}
+
+void RewindBuffer::capture() {
+    system->saveState(state);
+
+    RewindFrame frame;
+    frame.cycle = system->cpu->cycles;
+    frame.size = state.size();
+    // a snapshot can change size with the text waiting in the keyboard queue
+    bool isKeyframe = frames.empty() || frames.back().distance + 1 >= keyframeFrames ||
+                      getKeyframe(frames.size() - 1).size() != state.size();
+
+    delta.clear();
+    if(isKeyframe) {
+        frame.distance = 0;
+        lz4::compress(state.data(), state.size(), delta);
+        keyframe = state;
+        keyframeCycle = frame.cycle;
+    } else {
+        frame.distance = frames.back().distance + 1;
+        for(size_t i = 0; i < state.size(); i++) {
+            state[i] ^= keyframe[i];
+        }
+        lz4::compress(state.data(), state.size(), delta);
+    }
+    frame.data.assign(delta.begin(), delta.end());
+    frames.push_back(std::move(frame));
+
+    // frames after a keyframe need it, so the oldest ones are dropped a keyframe at a time
+    if(frames.size() > capacity) {
+        do {
+            frames.pop_front();
+        } while(!frames.empty() && frames.front().distance != 0);
+    }
+}
+
+bool RewindBuffer::restore(size_t index) {
+    const RewindFrame& frame = frames[index];
+    const std::vector<uint8_t>& base = getKeyframe(index);
+    if(frame.distance == 0) {
+        state = base;
+    } else {
+        state.resize(frame.size);
+        if(!lz4::decompress(frame.data.data(), frame.data.size(), state.data(), frame.size)) {
+            std::cerr << "Rewind frame is corrupt" << std::endl;
+            return false;
+        }
+        for(size_t i = 0; i < state.size(); i++) {
+            state[i] ^= base[i];
+        }
+    }
+
+    if(!system->loadState(state)) {
+        return false;
+    }
+    lastFrame = system->vic->frameCount;
+    return true;
+}
+
+const std::vector<uint8_t>& RewindBuffer::getKeyframe(size_t index) {
+    const RewindFrame& frame = frames[index - frames[index].distance];
+    if(keyframeCycle != frame.cycle) {
+        keyframe.resize(frame.size);
+        if(!lz4::decompress(frame.data.data(), frame.data.size(), keyframe.data(), frame.size)) {
+            std::cerr << "Rewind keyframe is corrupt" << std::endl;
+        }
+        keyframeCycle = frame.cycle;
+    }
+    return keyframe;
+}
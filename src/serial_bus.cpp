@@ -2,8 +2,8 @@
 #include <iostream>
 
 SerialBus::SerialBus() {
-    state = {false, false, true};
-    ciaState = {false, false, true};
+    state = {false, false, false};
+    ciaState = {false, false, false};
 }
 
 SerialBus::~SerialBus() {
@@ -22,8 +22,6 @@ void SerialBus::CIAWrite(SerialPortState data) {
     for(SerialDevice* device : devices) {
         device->tick();
     }
-
-    printState();
 }
 
 SerialPortState SerialBus::Read(bool tick) {
@@ -51,4 +49,20 @@ void SerialBus::printState() {
               << ", clockLine: " << state.clockLine
               << ", atnLine: " << state.atnLine
               << std::endl;
-}
\ No newline at end of file
+}
+
+void SerialBus::saveState(StateWriter& state) const {
+    state.write(ciaState);
+    state.write(this->state);
+    for(SerialDevice* device : devices) {
+        device->saveState(state);
+    }
+}
+
+void SerialBus::loadState(StateReader& state) {
+    state.read(ciaState);
+    state.read(this->state);
+    for(SerialDevice* device : devices) {
+        device->loadState(state);
+    }
+}
@@ -118,8 +118,6 @@ int decodeAttackTime(uint8_t value) {
 
 void SID::write(uint16_t addr, uint8_t value) {
     addr &= 0x1F; // 5 bits
-    std::cout << "SID write to address: " << std::hex << addr
-              << " with data: " << static_cast<int>(value) << std::dec << std::endl;
     if(writeCallback) {
         writeCallback();
     }
@@ -262,6 +260,22 @@ void SID::write(uint16_t addr, uint8_t value) {
 
 uint8_t SID::read(uint16_t addr) {
     addr &= 0x1F;
-    std::cout << "SID read from address: " << std::hex << addr << std::dec << std::endl;
+    if((addr == 0x19 || addr == 0x1A) && potCallback) {
+        return potCallback(addr - 0x19);
+    }
     return 0;
-}
\ No newline at end of file
+}
+
+void SID::saveState(StateWriter& state) const {
+    state.write(voice1);
+    state.write(voice2);
+    state.write(voice3);
+    state.write(filter);
+}
+
+void SID::loadState(StateReader& state) {
+    state.read(voice1);
+    state.read(voice2);
+    state.read(voice3);
+    state.read(filter);
+}
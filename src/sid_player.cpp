@@ -0,0 +1,233 @@
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sid_player.hpp>
+
+#define SID_HEADER_V1_SIZE 0x76
+#define DRIVER_SIZE 0x80
+
+static uint16_t readBigEndian16(const uint8_t* data) {
+    return (data[0] << 8) | data[1];
+}
+
+static uint32_t readBigEndian32(const uint8_t* data) {
+    return (data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+}
+
+static std::string readString(const uint8_t* data, size_t maxLength) {
+    size_t length = strnlen(reinterpret_cast<const char*>(data), maxLength);
+    return std::string(reinterpret_cast<const char*>(data), length);
+}
+
+SidPlayer::SidPlayer(System* system) : system(system) {
+}
+
+bool SidPlayer::load(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary | std::ios::in);
+    if(!file.is_open()) {
+        std::cerr << "Failed to open file: " << filename << "\n";
+        return false;
+    }
+
+    std::vector<uint8_t> contents((std::istreambuf_iterator<char>(file)),
+                                  std::istreambuf_iterator<char>());
+    if(contents.size() < SID_HEADER_V1_SIZE) {
+        std::cerr << "Invalid SID file: " << filename << "\n";
+        return false;
+    }
+
+    if(std::memcmp(contents.data(), "PSID", 4) == 0) {
+        header.rsid = false;
+    } else if(std::memcmp(contents.data(), "RSID", 4) == 0) {
+        header.rsid = true;
+    } else {
+        std::cerr << "Invalid SID file: " << filename << "\n";
+        return false;
+    }
+
+    header.version = readBigEndian16(&contents[0x04]);
+    header.dataOffset = readBigEndian16(&contents[0x06]);
+    header.loadAddress = readBigEndian16(&contents[0x08]);
+    header.initAddress = readBigEndian16(&contents[0x0A]);
+    header.playAddress = readBigEndian16(&contents[0x0C]);
+    header.songs = readBigEndian16(&contents[0x0E]);
+    header.startSong = readBigEndian16(&contents[0x10]);
+    header.speed = readBigEndian32(&contents[0x12]);
+    header.name = readString(&contents[0x16], 32);
+    header.author = readString(&contents[0x36], 32);
+    header.released = readString(&contents[0x56], 32);
+    header.flags = 0;
+    header.startPage = 0;
+    header.pageLength = 0;
+    if(header.version >= 2 && contents.size() >= 0x7C) {
+        header.flags = readBigEndian16(&contents[0x76]);
+        header.startPage = contents[0x78];
+        header.pageLength = contents[0x79];
+    }
+
+    if(header.dataOffset > contents.size()) {
+        std::cerr << "Invalid SID data offset: " << filename << "\n";
+        return false;
+    }
+
+    data.assign(contents.begin() + header.dataOffset, contents.end());
+    if(header.loadAddress == 0) {
+        // the real load address is stored in the first two bytes of the data
+        if(data.size() < 2) {
+            std::cerr << "Invalid SID data: " << filename << "\n";
+            return false;
+        }
+        header.loadAddress = data[0] | (data[1] << 8);
+        data.erase(data.begin(), data.begin() + 2);
+    }
+    if(header.initAddress == 0) {
+        header.initAddress = header.loadAddress;
+    }
+    if(header.loadAddress + data.size() > 0x10000) {
+        data.resize(0x10000 - header.loadAddress);
+    }
+    if(header.songs == 0) {
+        header.songs = 1;
+    }
+    if(header.startSong == 0 || header.startSong > header.songs) {
+        header.startSong = 1;
+    }
+
+    loaded = true;
+    return true;
+}
+
+void SidPlayer::bootKernal() {
+    // the KERNAL environment is needed by RSID tunes and by the IRQ vector at $0314
+    system->powerOn();
+    system->runUntilReady();
+}
+
+void SidPlayer::start(uint16_t song) {
+    if(!loaded) {
+        std::cerr << "No SID file loaded" << std::endl;
+        return;
+    }
+    if(song == 0 || song > header.songs) {
+        song = header.startSong;
+    }
+    currentSong = song;
+
+    system->vic->setRenderingEnabled(false);
+    bootKernal();
+
+    std::memcpy(system->bus->ram + header.loadAddress, data.data(), data.size());
+    installDriver(song);
+}
+
+void SidPlayer::run(size_t cycles) {
+    size_t target = system->cpu->cycles + cycles;
+    while(system->cpu->cycles < target) {
+        system->cpu->executeOnce();
+    }
+}
+
+uint8_t SidPlayer::bankFor(uint16_t addr) const {
+    if(addr < 0xA000) return 0x37;
+    if(addr < 0xD000) return 0x36;
+    if(addr >= 0xE000) return 0x35;
+    return 0x34;
+}
+
+uint8_t SidPlayer::speedFor(uint16_t song) const {
+    uint8_t bit = song > 32 ? 31 : song - 1;
+    return (header.speed >> bit) & 0x01;
+}
+
+uint16_t SidPlayer::findDriverAddress(uint16_t driverSize) {
+    uint32_t loadStart = header.loadAddress;
+    uint32_t loadEnd = header.loadAddress + data.size();
+    auto isFree = [&](uint32_t addr) {
+        return addr + driverSize <= loadStart || addr >= loadEnd;
+    };
+
+    if(header.startPage != 0 && header.startPage != 0xFF && header.pageLength > 0) {
+        return header.startPage << 8;
+    }
+    // cassette buffer
+    if(isFree(0x0334)) {
+        return 0x0334;
+    }
+    for(uint32_t addr = 0x0400; addr + driverSize <= 0xD000; addr += 0x100) {
+        if(isFree(addr)) {
+            return addr;
+        }
+    }
+    return 0x0334;
+}
+
+void SidPlayer::installDriver(uint16_t song) {
+    const uint16_t driver = findDriverAddress(DRIVER_SIZE);
+    const uint16_t init = header.initAddress;
+    const uint16_t play = header.playAddress;
+    const bool hasPlay = !header.rsid && play != 0;
+    const uint8_t initBank = header.rsid ? 0x37 : bankFor(init);
+    const uint8_t playBank = hasPlay ? bankFor(play) : initBank;
+    // IO has to stay visible while idling so the IRQ handler can acknowledge
+    const uint8_t loopBank = playBank == 0x34 ? 0x35 : playBank;
+
+    std::vector<uint8_t> code;
+    auto emit = [&code](std::initializer_list<uint8_t> bytes) {
+        code.insert(code.end(), bytes);
+    };
+    auto here = [&code, driver]() { return static_cast<uint16_t>(driver + code.size()); };
+
+    // init
+    emit({0x78});                   // SEI
+    if(hasPlay) {
+        if(speedFor(song) == SID_SPEED_CIA) {
+            // default to the KERNAL's 60Hz timer, init may override it
+            emit({0xA9, 0x25, 0x8D, 0x04, 0xDC}); // LDA #$25 : STA $DC04
+            emit({0xA9, 0x40, 0x8D, 0x05, 0xDC}); // LDA #$40 : STA $DC05
+        } else {
+            emit({0xA9, 0x00, 0x8D, 0x0E, 0xDC}); // LDA #$00 : STA $DC0E
+            emit({0xA9, 0x7F, 0x8D, 0x0D, 0xDC}); // LDA #$7F : STA $DC0D
+        }
+    }
+    emit({0xA9, initBank, 0x85, 0x01});                    // LDA #bank : STA $01
+    emit({0xA9, static_cast<uint8_t>(song - 1)});          // LDA #song
+    emit({0x20, static_cast<uint8_t>(init), static_cast<uint8_t>(init >> 8)}); // JSR init
+    emit({0xA9, loopBank, 0x85, 0x01});                    // LDA #bank : STA $01
+    if(hasPlay) {
+        if(speedFor(song) == SID_SPEED_CIA) {
+            emit({0xA9, 0x81, 0x8D, 0x0D, 0xDC}); // LDA #$81 : STA $DC0D
+            emit({0xA9, 0x11, 0x8D, 0x0E, 0xDC}); // LDA #$11 : STA $DC0E
+        } else {
+            emit({0xA9, 0x1B, 0x8D, 0x11, 0xD0}); // LDA #$1B : STA $D011
+            emit({0xA9, 0x80, 0x8D, 0x12, 0xD0}); // LDA #$80 : STA $D012
+            emit({0xA9, 0x01, 0x8D, 0x1A, 0xD0}); // LDA #$01 : STA $D01A
+        }
+    }
+    emit({0x58}); // CLI
+    const uint16_t loop = here();
+    emit({0x4C, static_cast<uint8_t>(loop), static_cast<uint8_t>(loop >> 8)}); // JMP loop
+
+    if(hasPlay) {
+        // entered through $FFFE when the KERNAL is banked out
+        const uint16_t irqRam = here();
+        emit({0x48, 0x8A, 0x48, 0x98, 0x48}); // PHA : TXA : PHA : TYA : PHA
+        // entered through $0314 after the KERNAL has saved the registers
+        const uint16_t irqKernal = here();
+        emit({0xAD, 0x0D, 0xDC});             // LDA $DC0D
+        emit({0xA9, 0xFF, 0x8D, 0x19, 0xD0}); // LDA #$FF : STA $D019
+        emit({0xA9, playBank, 0x85, 0x01});   // LDA #bank : STA $01
+        emit({0x20, static_cast<uint8_t>(play), static_cast<uint8_t>(play >> 8)}); // JSR play
+        emit({0xA9, loopBank, 0x85, 0x01});   // LDA #bank : STA $01
+        emit({0x68, 0xA8, 0x68, 0xAA, 0x68}); // PLA : TAY : PLA : TAX : PLA
+        emit({0x40});                         // RTI
+
+        system->bus->ram[0x0314] = irqKernal & 0xFF;
+        system->bus->ram[0x0315] = irqKernal >> 8;
+        system->bus->ram[0xFFFE] = irqRam & 0xFF;
+        system->bus->ram[0xFFFF] = irqRam >> 8;
+    }
+
+    std::memcpy(system->bus->ram + driver, code.data(), code.size());
+    system->cpu->PC = driver;
+}
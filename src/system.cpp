@@ -1,17 +1,25 @@
+#include <algorithm>
 #include <chrono>
+#include <cstring>
 #include <floppy.hpp>
+#include <fstream>
 #include <iostream>
+#include <replay.hpp>
+#include <rewind.hpp>
 #include <system.hpp>
 
-System::System() {
-    bus = new C64Bus();
-    serialBus = new SerialBus();
-    cpu = new CPU(bus);
-    cia1 = new CIA1(bus);
-    cia2 = new CIA2(bus, serialBus);
-    vic = new VIC(bus);
-    sid = new SID();
-    input = new Input(bus);
+System::System() : System(nullptr, 0) {
+}
+
+System::System(MachineArena* arena, size_t instance) : arena(arena), instance(instance) {
+    bus = create<C64Bus>(ARENA_BUS);
+    serialBus = create<SerialBus>(ARENA_SERIAL_BUS);
+    cpu = create<CPUCore<C64Bus>>(ARENA_CPU, bus);
+    cia1 = create<CIA1>(ARENA_CIA1, bus);
+    cia2 = create<CIA2>(ARENA_CIA2, bus, serialBus);
+    vic = create<VIC>(ARENA_VIC, bus);
+    sid = create<SID>(ARENA_SID);
+    input = create<Input>(ARENA_INPUT, bus);
     bus->cia1 = cia1;
     bus->cia2 = cia2;
     bus->vic = vic;
@@ -21,17 +29,10 @@ System::System() {
     cia1->setCpu(cpu);
     cia2->setCpu(cpu);
     vic->setCpu(cpu);
+    input->setCpu(cpu);
+    sid->setPotCallback([this](uint8_t axis) { return input->readPot(axis); });
 
-    #ifndef NO_MMIO
-    cpu->setCycleCallback([this]() {
-        cia1->tick();
-        cia2->tick();
-        vic->tick();
-        sid->tick();
-    });
-    #endif
-
-    Floppy* floppy = new Floppy(serialBus);
+    floppy = create<Floppy>(ARENA_FLOPPY, serialBus);
     serialBus->devices.push_back(floppy);
 
     // Initialize clock speed tracking
@@ -40,16 +41,22 @@ System::System() {
     cycles = 0;
     timeThreshold = std::chrono::duration<double>(1);
     clockSpeed = 0;
+    startTime = frameStart = lastTime;
 }
 
 System::~System() {
-    delete bus;
-    delete cpu;
-    delete cia1;
-    delete cia2;
-    delete vic;
-    delete sid;
-    delete input;
+    // the virtual drive removes its traps from the CPU
+    delete virtualDrive;
+    destroy(bus);
+    destroy(cpu);
+    destroy(cia1);
+    destroy(cia2);
+    destroy(vic);
+    destroy(sid);
+    destroy(input);
+    delete drive;
+    destroy(floppy);
+    destroy(serialBus);
 }
 
 void System::loadRoms(const std::string& kernalAndBasicRom, const std::string& characterRom) {
@@ -57,12 +64,76 @@ void System::loadRoms(const std::string& kernalAndBasicRom, const std::string& c
     bus->loadCharacterRom(characterRom.c_str());
 }
 
+bool System::enableTrueDrive(const std::string& rom, const std::string& upperRom) {
+    Drive1541* newDrive = new Drive1541(serialBus);
+    bool loaded = newDrive->loadRom(rom) && (upperRom.empty() || newDrive->loadRom(upperRom, 0xE000));
+    if(!loaded || !newDrive->isRomComplete()) {
+        // the repository only has the $C000 half, 325302-01
+        std::cerr << "1541 ROM incomplete, $C000-$FFFF is needed: pass the 16K image or add the "
+                     "$E000 half, 901229-05, as the upper ROM" << std::endl;
+        delete newDrive;
+        return false;
+    }
+
+    for(SerialDevice*& device : serialBus->devices) {
+        if(device == floppy) {
+            device = newDrive;
+        }
+    }
+    drive = newDrive;
+    drive->powerOn();
+    updateCycleCallback();
+    return true;
+}
+
+bool System::enableVirtualDrive(const std::string& path, uint8_t device) {
+    if(recorder) {
+        recorder->recordMedia(ReplayEventType::VIRTUAL_DRIVE, path, device);
+    }
+    delete virtualDrive;
+    virtualDrive = new VirtualDrive(cpu, bus, device);
+    if(!virtualDrive->attach(path)) {
+        delete virtualDrive;
+        virtualDrive = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void System::disableVirtualDrive() {
+    delete virtualDrive;
+    virtualDrive = nullptr;
+}
+
+bool System::insertCartridge(const std::string& path) {
+    if(recorder) {
+        recorder->recordMedia(ReplayEventType::CARTRIDGE, path);
+    }
+    if(!bus->loadCartridge(path.c_str())) {
+        return false;
+    }
+    reset();
+    return true;
+}
+
 void System::powerOn() {
+    if(bus->cartridge) {
+        bus->cartridge->reset();
+    }
     cpu->powerOn();
+    if(drive) {
+        drive->powerOn();
+    }
 }
 
 void System::reset() {
+    if(bus->cartridge) {
+        bus->cartridge->reset();
+    }
     cpu->reset();
+    if(drive) {
+        drive->reset();
+    }
 }
 
 void System::step() {
@@ -77,8 +148,200 @@ void System::step() {
         clockSpeed = static_cast<int>(averageClockSpeed);
         accumulatedTime = std::chrono::duration<double>::zero();
         cycles = cpu->cycles;
-        std::cout << "Clock speed: " << clockSpeed << " Hz" << std::endl;
+        if(metricsLog.is_open()) {
+            getMetrics().writeJson(metricsLog);
+            metricsLog << std::endl;
+        } else {
+            std::cout << "Clock speed: " << clockSpeed << " Hz" << std::endl;
+        }
+    }
+    if(vic->frameCount != lastFrame) {
+        lastFrame = vic->frameCount;
+        frameNanoseconds =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(now - frameStart).count();
+        frameStart = now;
     }
 
+    if(recorder) {
+        recorder->update();
+    }
+    if(rewind) {
+        rewind->update();
+    }
     cpu->executeOnce();
 }
+
+Metrics System::getMetrics() const {
+    Metrics metrics;
+    metrics.time = std::chrono::duration<double>(lastTime - startTime).count();
+    metrics.instructions = cpu->instructionCount;
+    metrics.cycles = cpu->cycles;
+    metrics.frames = vic->frameCount;
+    metrics.irqs = cpu->irqCount;
+    metrics.nmis = cpu->nmiCount;
+    metrics.bus = bus->counters;
+    metrics.clockSpeed = clockSpeed;
+    metrics.frameNanoseconds = frameNanoseconds;
+    metrics.renderNanoseconds = vic->renderNanoseconds;
+    metrics.sidNanoseconds = std::max<int64_t>(sidNanoseconds, 0);
+    return metrics;
+}
+
+void System::setMetricsTiming(bool enabled) {
+    metricsTiming = enabled;
+    vic->timeRendering = enabled;
+    updateCycleCallback();
+    if(enabled && clockNanoseconds == 0) {
+        std::chrono::nanoseconds total(0);
+        for(int i = 0; i < METRICS_CLOCK_CALIBRATION; i++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            total += std::chrono::high_resolution_clock::now() - start;
+        }
+        clockNanoseconds = total.count() / METRICS_CLOCK_CALIBRATION;
+    }
+}
+
+bool System::setMetricsLog(const std::string& path) {
+    metricsLog.close();
+    if(path.empty()) {
+        return true;
+    }
+    metricsLog.open(path, std::ios::out | std::ios::app);
+    if(!metricsLog.is_open()) {
+        std::cerr << "Failed to open file: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// the bus ticks the chips itself, the callback takes over for the true drive and SID timing
+void System::updateCycleCallback() {
+    #ifndef NO_MMIO
+    if(!drive && !metricsTiming) {
+        cpu->setCycleCallback(nullptr);
+        return;
+    }
+    cpu->setCycleCallback([this]() {
+        cia1->tick();
+        cia2->tick();
+        vic->tick();
+        if(metricsTiming && cpu->cycles % METRICS_SID_SAMPLE == 0) {
+            auto start = std::chrono::high_resolution_clock::now();
+            sid->tick();
+            auto end = std::chrono::high_resolution_clock::now();
+            sidNanoseconds += METRICS_SID_SAMPLE *
+                (std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() -
+                 clockNanoseconds);
+        } else {
+            sid->tick();
+        }
+        input->tick();
+        if(drive) {
+            drive->clock();
+        }
+    });
+    #endif
+}
+
+void System::saveState(std::vector<uint8_t>& state) const {
+    state.clear();
+    StateWriter writer(state);
+    writer.write<uint32_t>(SNAPSHOT_MAGIC);
+    writer.write<uint16_t>(SNAPSHOT_VERSION);
+    writer.write<bool>(drive);
+    writer.write<int32_t>(bus->cartridge ? bus->cartridge->getType() : -1);
+    cpu->saveState(writer);
+    bus->saveState(writer);
+    cia1->saveState(writer);
+    cia2->saveState(writer);
+    vic->saveState(writer);
+    sid->saveState(writer);
+    serialBus->saveState(writer);
+    input->saveState(writer);
+}
+
+bool System::loadState(const std::vector<uint8_t>& state) {
+    StateReader reader(state);
+    if(reader.read<uint32_t>() != SNAPSHOT_MAGIC || reader.read<uint16_t>() != SNAPSHOT_VERSION) {
+        std::cerr << "Not a snapshot of this version" << std::endl;
+        return false;
+    }
+    if(reader.read<bool>() != (drive != nullptr)) {
+        std::cerr << "Snapshot was taken with a different drive setup" << std::endl;
+        return false;
+    }
+    if(reader.read<int32_t>() != (bus->cartridge ? bus->cartridge->getType() : -1)) {
+        std::cerr << "Snapshot was taken with a different cartridge" << std::endl;
+        return false;
+    }
+    cpu->loadState(reader);
+    bus->loadState(reader);
+    cia1->loadState(reader);
+    cia2->loadState(reader);
+    vic->loadState(reader);
+    sid->loadState(reader);
+    serialBus->loadState(reader);
+    input->loadState(reader);
+    if(!reader.isValid() || !reader.atEnd()) {
+        std::cerr << "Snapshot is truncated or corrupt" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool System::runUntilReady(size_t timeout) {
+    size_t end = cpu->cycles + timeout;
+    while(cpu->PC != KERNAL_READY_LOOP) {
+        if(cpu->cycles >= end) {
+            return false;
+        }
+        cpu->executeOnce();
+    }
+    return true;
+}
+
+bool System::loadPrg(const std::string& path, bool autostart) {
+    if(recorder) {
+        recorder->recordMedia(ReplayEventType::PRG, path, autostart);
+    }
+    std::ifstream file(path, std::ios::binary | std::ios::in);
+    if(!file.is_open()) {
+        std::cerr << "Failed to open file: " << path << "\n";
+        return false;
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),
+                              std::istreambuf_iterator<char>());
+    if(data.size() < 2) {
+        std::cerr << "PRG file too short: " << path << "\n";
+        return false;
+    }
+
+    // BASIC has to be initialised before its pointers can be fixed up
+    if(!runUntilReady()) {
+        std::cerr << "KERNAL did not reach the READY prompt" << std::endl;
+        return false;
+    }
+
+    uint16_t address = data[0] | (data[1] << 8);
+    size_t length = std::min(data.size() - 2, static_cast<size_t>(0x10000 - address));
+    std::memcpy(bus->ram + address, data.data() + 2, length);
+    uint16_t end = address + length;
+    bus->ram[0xAE] = end & 0xFF;
+    bus->ram[0xAF] = end >> 8;
+
+    bool basic = address == (bus->ram[0x2B] | (bus->ram[0x2C] << 8));
+    if(basic) {
+        // variables, arrays and strings start after the program
+        for(uint16_t pointer : {0x2D, 0x2F, 0x31}) {
+            bus->ram[pointer] = end & 0xFF;
+            bus->ram[pointer + 1] = end >> 8;
+        }
+    }
+
+    if(autostart) {
+        std::string command = basic ? "RUN\r" : "SYS" + std::to_string(address) + "\r";
+        std::memcpy(bus->ram + KEYBOARD_BUFFER, command.data(), command.size());
+        bus->ram[KEYBOARD_BUFFER_LENGTH] = command.size();
+    }
+    return true;
+}
@@ -9,7 +9,7 @@
 
 int main() {
     C64Bus bus;
-    CPU cpu(&bus);
+    CPUCore<C64Bus> cpu(&bus);
 
     std::ifstream file("6502test.bin", std::ios::binary | std::ios::in);
     if(!file.is_open()) {
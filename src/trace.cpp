@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <iostream>
+#include <state.hpp>
+#include <trace.hpp>
+
+static void writeStart(StateWriter& writer, const TraceRecord& start) {
+    writer.write(start.cycle);
+    writer.write(start.pc);
+    writer.write(start.a);
+    writer.write(start.x);
+    writer.write(start.y);
+    writer.write(start.sp);
+    writer.write(start.p);
+}
+
+static void readStart(StateReader& reader, TraceRecord& start) {
+    reader.read(start.cycle);
+    reader.read(start.pc);
+    reader.read(start.a);
+    reader.read(start.x);
+    reader.read(start.y);
+    reader.read(start.sp);
+    reader.read(start.p);
+}
+
+TraceWriter::~TraceWriter() {
+    close();
+}
+
+bool TraceWriter::open(const std::string& path, const TraceOpcodes& opcodes,
+                       const TraceRecord& start) {
+    close();
+    file.open(path, std::ios::binary | std::ios::out | std::ios::trunc);
+    if(!file.is_open()) {
+        std::cerr << "Failed to open file: " << path << "\n";
+        return false;
+    }
+    this->opcodes = opcodes;
+    last = start;
+    nextPc = start.pc;
+
+    buffer.resize(TRACE_BUFFER_SIZE);
+    position = buffer.data();
+    bufferEnd = buffer.data() + buffer.size();
+
+    std::vector<uint8_t> header;
+    StateWriter writer(header);
+    writer.write<uint32_t>(TRACE_MAGIC);
+    writer.write<uint16_t>(TRACE_VERSION);
+    writer.write(opcodes);
+    writeStart(writer, start);
+    file.write(reinterpret_cast<const char*>(header.data()), header.size());
+    return file.good();
+}
+
+void TraceWriter::close() {
+    if(file.is_open()) {
+        flush();
+        file.close();
+    }
+}
+
+void TraceWriter::flush() {
+    file.write(reinterpret_cast<const char*>(buffer.data()), position - buffer.data());
+    position = buffer.data();
+}
+
+bool TraceReader::open(const std::string& path) {
+    if(!file.open(path)) {
+        return false;
+    }
+    StateReader reader(file.data(), file.size());
+    if(reader.read<uint32_t>() != TRACE_MAGIC || reader.read<uint16_t>() != TRACE_VERSION) {
+        std::cerr << "Not a trace of this version: " << path << "\n";
+        return false;
+    }
+    reader.read(opcodes);
+    readStart(reader, last);
+    if(!reader.isValid()) {
+        std::cerr << "Trace header is truncated: " << path << "\n";
+        return false;
+    }
+    nextPc = last.pc;
+    position = reader.getPosition();
+    return true;
+}
+
+bool TraceReader::next(TraceRecord& record) {
+    const uint8_t* data = file.data();
+    size_t size = file.size();
+    if(position >= size) {
+        return false;
+    }
+
+    // a record is never longer than TRACE_MAX_RECORD, only the last one can be cut off
+    uint8_t bytes[TRACE_MAX_RECORD] = {};
+    size_t available = std::min<size_t>(size - position, TRACE_MAX_RECORD);
+    std::copy(data + position, data + position + available, bytes);
+    const uint8_t* in = bytes;
+
+    record = last;
+    uint8_t flags = *in++;
+    if(flags & TRACE_PC) {
+        record.pc = in[0] | (in[1] << 8);
+        in += 2;
+    } else {
+        record.pc = nextPc;
+    }
+    record.opcode = *in++;
+    uint8_t length = opcodes.operandLengths[record.opcode];
+    record.operands[0] = length > 0 ? *in++ : 0;
+    record.operands[1] = length > 1 ? *in++ : 0;
+    if(flags & TRACE_A) record.a = *in++;
+    if(flags & TRACE_X) record.x = *in++;
+    if(flags & TRACE_Y) record.y = *in++;
+    if(flags & TRACE_SP) record.sp = *in++;
+    if(flags & TRACE_P) record.p = *in++;
+
+    uint64_t delta = 0;
+    int shift = 0;
+    uint8_t byte;
+    do {
+        if(in == bytes + TRACE_MAX_RECORD) {
+            return false;
+        }
+        byte = *in++;
+        delta |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        shift += 7;
+    } while(byte & 0x80);
+    record.cycle = last.cycle + delta;
+
+    size_t used = in - bytes;
+    if(used > available) {
+        std::cerr << "Trace is truncated" << std::endl;
+        return false;
+    }
+    position += used;
+    last = record;
+    nextPc = record.pc + 1 + length;
+    return true;
+}
@@ -0,0 +1,238 @@
+#include <via.hpp>
+
+VIA::VIA() {
+    reset();
+}
+
+VIA::~VIA() {
+}
+
+void VIA::reset() {
+    for(int i = 0; i < 0x10; i++) {
+        registers[i] = 0x00;
+    }
+    interruptFlags = 0;
+    interruptEnable = 0;
+    timer1Armed = false;
+    timer1Reload = false;
+    timer2Armed = false;
+    pb7Output = true;
+}
+
+void VIA::write(uint16_t addr, uint8_t data) {
+    addr &= 0x0F;
+    switch(addr) {
+    case VIA_PORTB:
+    case VIA_DIRECTION_REGISTER_B:
+        registers[addr] = data;
+        if(addr == VIA_PORTB) {
+            interruptFlags &= ~(VIA_INTERRUPT_CB1 | VIA_INTERRUPT_CB2);
+        }
+        portBChanged(portBPins());
+        return;
+    case VIA_PORTA:
+    case VIA_PORTA_NO_HANDSHAKE:
+    case VIA_DIRECTION_REGISTER_A:
+        if(addr == VIA_PORTA) {
+            interruptFlags &= ~(VIA_INTERRUPT_CA1 | VIA_INTERRUPT_CA2);
+        }
+        registers[addr == VIA_PORTA_NO_HANDSHAKE ? VIA_PORTA : addr] = data;
+        portAChanged(portAPins());
+        return;
+    case VIA_TIMER_1_LOW:
+    case VIA_TIMER_1_LATCH_LOW:
+        timer1Latch = (timer1Latch & 0xFF00) | data;
+        break;
+    case VIA_TIMER_1_HIGH:
+        // writing the high byte transfers the latch and starts the timer
+        timer1Latch = (timer1Latch & 0x00FF) | (data << 8);
+        timer1Counter = timer1Latch;
+        timer1Armed = true;
+        timer1Reload = false;
+        interruptFlags &= ~VIA_INTERRUPT_TIMER_1;
+        if(registers[VIA_AUXILIARY_CONTROL_REGISTER] & 0x80) {
+            pb7Output = false;
+        }
+        break;
+    case VIA_TIMER_1_LATCH_HIGH:
+        timer1Latch = (timer1Latch & 0x00FF) | (data << 8);
+        interruptFlags &= ~VIA_INTERRUPT_TIMER_1;
+        break;
+    case VIA_TIMER_2_LOW:
+        timer2LatchLow = data;
+        break;
+    case VIA_TIMER_2_HIGH:
+        timer2Counter = (data << 8) | timer2LatchLow;
+        timer2Armed = true;
+        interruptFlags &= ~VIA_INTERRUPT_TIMER_2;
+        break;
+    case VIA_SHIFT_REGISTER:
+        interruptFlags &= ~VIA_INTERRUPT_SHIFT;
+        break;
+    case VIA_INTERRUPT_FLAG_REGISTER:
+        // writing a one clears the flag
+        interruptFlags &= ~(data & 0x7F);
+        return;
+    case VIA_INTERRUPT_ENABLE_REGISTER:
+        if(data & 0x80) {
+            interruptEnable |= data & 0x7F;
+        } else {
+            interruptEnable &= ~data;
+        }
+        return;
+    default:
+        break;
+    }
+    registers[addr] = data;
+}
+
+uint8_t VIA::read(uint16_t addr) {
+    addr &= 0x0F;
+    switch(addr) {
+    case VIA_PORTB: {
+        interruptFlags &= ~(VIA_INTERRUPT_CB1 | VIA_INTERRUPT_CB2);
+        uint8_t direction = registers[VIA_DIRECTION_REGISTER_B];
+        uint8_t value = (registers[VIA_PORTB] & direction) | (portBInput() & ~direction);
+        if(registers[VIA_AUXILIARY_CONTROL_REGISTER] & 0x80) {
+            value = (value & 0x7F) | (pb7Output << 7);
+        }
+        return value;
+    }
+    case VIA_PORTA:
+    case VIA_PORTA_NO_HANDSHAKE: {
+        if(addr == VIA_PORTA) {
+            interruptFlags &= ~(VIA_INTERRUPT_CA1 | VIA_INTERRUPT_CA2);
+        }
+        uint8_t direction = registers[VIA_DIRECTION_REGISTER_A];
+        return (registers[VIA_PORTA] & direction) | (portAInput() & ~direction);
+    }
+    case VIA_TIMER_1_LOW:
+        interruptFlags &= ~VIA_INTERRUPT_TIMER_1;
+        return timer1Counter & 0xFF;
+    case VIA_TIMER_1_HIGH:
+        return timer1Counter >> 8;
+    case VIA_TIMER_1_LATCH_LOW:
+        return timer1Latch & 0xFF;
+    case VIA_TIMER_1_LATCH_HIGH:
+        return timer1Latch >> 8;
+    case VIA_TIMER_2_LOW:
+        interruptFlags &= ~VIA_INTERRUPT_TIMER_2;
+        return timer2Counter & 0xFF;
+    case VIA_TIMER_2_HIGH:
+        return timer2Counter >> 8;
+    case VIA_SHIFT_REGISTER:
+        interruptFlags &= ~VIA_INTERRUPT_SHIFT;
+        return registers[VIA_SHIFT_REGISTER];
+    case VIA_INTERRUPT_FLAG_REGISTER:
+        return interruptFlags | (irqAsserted() ? 0x80 : 0x00);
+    case VIA_INTERRUPT_ENABLE_REGISTER:
+        return interruptEnable | 0x80;
+    default:
+        return registers[addr];
+    }
+}
+
+void VIA::tickTimer1() {
+    if(timer1Reload) {
+        timer1Counter = timer1Latch;
+        timer1Reload = false;
+    } else if(timer1Counter-- == 0) {
+        if(timer1Armed) {
+            interruptFlags |= VIA_INTERRUPT_TIMER_1;
+            pb7Output = !pb7Output;
+        }
+        // ACR bit 6 selects free running mode, otherwise the timer only fires once
+        if(registers[VIA_AUXILIARY_CONTROL_REGISTER] & 0x40) {
+            timer1Reload = true;
+        } else {
+            timer1Armed = false;
+        }
+    }
+}
+
+void VIA::tick() {
+    tickTimer1();
+
+    // ACR bit 5 makes timer 2 count PB6 pulses, which are not connected here
+    if(!(registers[VIA_AUXILIARY_CONTROL_REGISTER] & 0x20)) {
+        if(timer2Counter-- == 0 && timer2Armed) {
+            interruptFlags |= VIA_INTERRUPT_TIMER_2;
+            timer2Armed = false;
+        }
+    }
+}
+
+void VIA::skip(size_t cycles) {
+    // timer 1 counts down in one step to where it fires or reloads, which it does one cycle
+    // at a time
+    for(size_t left = cycles; left;) {
+        if(timer1Reload || timer1Counter == 0) {
+            tickTimer1();
+            left--;
+            continue;
+        }
+        size_t steps = left < timer1Counter ? left : timer1Counter;
+        timer1Counter -= steps;
+        left -= steps;
+    }
+
+    // timer 2 fires once when it passes zero and keeps counting down
+    if(!(registers[VIA_AUXILIARY_CONTROL_REGISTER] & 0x20)) {
+        if(timer2Armed && cycles > timer2Counter) {
+            interruptFlags |= VIA_INTERRUPT_TIMER_2;
+            timer2Armed = false;
+        }
+        timer2Counter -= static_cast<uint16_t>(cycles);
+    }
+}
+
+void VIA::setCA1(bool level) {
+    if(level == ca1Level) return;
+    ca1Level = level;
+    // PCR bit 0 selects the active edge
+    bool positiveEdge = registers[VIA_PERIPHERAL_CONTROL_REGISTER] & 0x01;
+    if(level == positiveEdge) {
+        interruptFlags |= VIA_INTERRUPT_CA1;
+    }
+}
+
+void VIA::setCB1(bool level) {
+    if(level == cb1Level) return;
+    cb1Level = level;
+    bool positiveEdge = registers[VIA_PERIPHERAL_CONTROL_REGISTER] & 0x10;
+    if(level == positiveEdge) {
+        interruptFlags |= VIA_INTERRUPT_CB1;
+    }
+}
+
+void VIA::saveState(StateWriter& state) const {
+    state.writeBytes(registers, sizeof(registers));
+    state.write(timer1Counter);
+    state.write(timer1Latch);
+    state.write(timer1Armed);
+    state.write(timer1Reload);
+    state.write(pb7Output);
+    state.write(timer2Counter);
+    state.write(timer2LatchLow);
+    state.write(timer2Armed);
+    state.write(interruptFlags);
+    state.write(interruptEnable);
+    state.write(ca1Level);
+    state.write(cb1Level);
+}
+
+void VIA::loadState(StateReader& state) {
+    state.readBytes(registers, sizeof(registers));
+    state.read(timer1Counter);
+    state.read(timer1Latch);
+    state.read(timer1Armed);
+    state.read(timer1Reload);
+    state.read(pb7Output);
+    state.read(timer2Counter);
+    state.read(timer2LatchLow);
+    state.read(timer2Armed);
+    state.read(interruptFlags);
+    state.read(interruptEnable);
+    state.read(ca1Level);
+    state.read(cb1Level);
+}
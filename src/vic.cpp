@@ -1,6 +1,7 @@
 #include <algorithm> // for std::fill
 #include <array>
 #include <bitset>
+#include <chrono>
 #include <iostream>
 #include <vic.hpp>
 
@@ -8,12 +9,19 @@ VIC::VIC(C64Bus* bus) {
     this->bus = bus;
     // using std::fill to initialize registers
     std::fill(registers, registers + 0x2F, 0x00);
-    screen.fill(0x000000);
 }
 
 VIC::~VIC() {
 }
 
+uint8_t VIC::fetch(uint16_t addr) const {
+    return bus->ram[addr];
+}
+
+uint8_t VIC::fetchColor(uint16_t addr) const {
+    return bus->colorRam[(addr - 0xD800) & 0x3FF];
+}
+
 uint8_t VIC::read(uint16_t addr) {
     // debug output can be toggled if needed
     // std::cout << "VIC read from address: " << std::hex << addr << std::dec << std::endl;
@@ -48,7 +56,12 @@ void VIC::write(uint16_t addr, uint8_t value) {
         break;
     case 0x19: // icr: clear interrupt bits
         registers[0x19] &= ~value;
-        break;
+        checkInterrupts();
+        return;
+    case 0x1A: // interrupt enable
+        registers[0x1A] = value & 0x0F;
+        checkInterrupts();
+        return;
     case 0x20: // border color
         registers[0x20] = value & 0x0F;
         break;
@@ -66,17 +79,27 @@ void VIC::tick() {
     rasterCycle++;
     if(rasterCycle == 63) {
         rasterCycle = 0;
-        if(rasterLine < 200) {
-            renderScanline();
+        if(rasterLine < 200 && renderingEnabled) {
+            if(timeRendering) {
+                auto start = std::chrono::high_resolution_clock::now();
+                renderScanline();
+                renderNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::high_resolution_clock::now() - start).count();
+            } else {
+                renderScanline();
+            }
         }
         rasterLine++;
         if(rasterLine == 312) {
             rasterLine = 0;
-            needsRender = true;
             frameCount++;
-            if(framebufferCallback) {
-                framebufferCallback(screen);
+            if(renderingEnabled) {
+                needsRender = true;
+                if(framebufferCallback && screen) {
+                    framebufferCallback(*screen);
+                }
             }
+            renderingEnabled = requestedRendering;
         }
         handleRasterInterrupts();
     }
@@ -84,7 +107,8 @@ void VIC::tick() {
 }
 
 void VIC::handleRasterInterrupts() {
-    uint16_t valueNeeded = (registers[0x11] << 8) | registers[0x12];
+    // bit 7 of $D011 is bit 8 of the raster compare value
+    uint16_t valueNeeded = ((registers[0x11] & 0x80) << 1) | registers[0x12];
     if(rasterLine == valueNeeded) {
         registers[0x19] |= 0x01;
         checkInterrupts();
@@ -92,13 +116,19 @@ void VIC::handleRasterInterrupts() {
 }
 
 void VIC::handleDMASteal() {
-    // bool badLine = false;
-    // if(badLine) {
-    //     cpu->stallCycles(35);
-    // }
+    // on a bad line the VIC fetches the screen row in cycles 15-54 and pulls BA low three
+    // cycles before that, the CPU stops at its next read. only the cycle stepped core honours
+    // RDY, the cycle after this one is the one being decided
+    bool badLine = rasterLine >= 0x30 && rasterLine <= 0xF7 && (registers[0x11] & 0x10) &&
+                   (rasterLine & 0x07) == (registers[0x11] & 0x07);
+    cpu->setReady(!(badLine && rasterCycle >= 11 && rasterCycle <= 53));
 }
 
 void VIC::renderScanline() {
+    if(!screen) {
+        screen = std::make_unique<std::array<uint32_t, 40 * 25 * 8 * 8>>();
+    }
+    std::array<uint32_t, 40 * 25 * 8 * 8>& pixels = *screen;
     const int hScroll = registers[0x16] & 0x07;
     const int vScroll = registers[0x11] & 0x07;
     const int effectiveScanline = (rasterLine + vScroll) % 200;
@@ -117,8 +147,8 @@ void VIC::renderScanline() {
     if(!multiColorMode) {
         for(int cellX = 0; cellX < 40; cellX++) {
             const uint16_t screenAddr = screenOffset + cellX;
-            const uint8_t charCode = bus->read(screenAddr);
-            const uint8_t colorCode = bus->read(colorOffset + cellX);
+            const uint8_t charCode = fetch(screenAddr);
+            const uint8_t colorCode = fetchColor(colorOffset + cellX);
             const uint32_t fgColor = getColor(colorCode & 0x0F);
 
             uint8_t charData;
@@ -127,13 +157,13 @@ void VIC::renderScanline() {
                 if(charMemOffset == 0x1000 || charMemOffset == 0x1800) {
                     charData = bus->readCharRom(charRomAddr);
                 } else {
-                    charData = bus->read(charRomAddr + charMemOffset + bankAddress);
+                    charData = fetch(charRomAddr + charMemOffset + bankAddress);
                 }
             } else if(bitmapMode) {
-                charData = bus->read(bitmapOffset + bankAddress + baseScreenRow + cellX);
+                charData = fetch(bitmapOffset + bankAddress + baseScreenRow + cellX);
             } else {
                 const uint16_t charRomAddr = charCode * 8 + pixelRowWithinChar;
-                charData = bus->read(charRomAddr + charMemOffset + bankAddress);
+                charData = fetch(charRomAddr + charMemOffset + bankAddress);
             }
 
             const int screenX = ((cellX * 8) - hScroll + 320) % 320;
@@ -145,21 +175,21 @@ void VIC::renderScanline() {
                 for(int bit = 0; bit < 8; bit++) {
                     const bool pixelOn = ((charData >> (7 - bit)) & 0x01) != 0;
                     const int x = (screenX + bit) % 320;
-                    screen[screenBaseIndex + x] = pixelOn ? fgColor : bgColor;
+                    pixels[screenBaseIndex + x] = pixelOn ? fgColor : bgColor;
                 }
             } else {
                 for(int bit = 0; bit < 8; bit++) {
                     const bool pixelOn = ((charData >> (7 - bit)) & 0x01) != 0;
                     const int x = (screenX + bit) % 320;
-                    screen[screenBaseIndex + x] = pixelOn ? fgColor : backgroundColor;
+                    pixels[screenBaseIndex + x] = pixelOn ? fgColor : backgroundColor;
                 }
             }
         }
     } else {
         for(int cellX = 0; cellX < 20; cellX++) {
             const uint16_t screenAddr = screenOffset + cellX;
-            const uint8_t charCode = bus->read(screenAddr);
-            const uint8_t colorCode = bus->read(colorOffset + cellX);
+            const uint8_t charCode = fetch(screenAddr);
+            const uint8_t colorCode = fetchColor(colorOffset + cellX);
             const uint32_t color3 = getColor(colorCode & 0x0F);
 
             uint8_t charData;
@@ -168,13 +198,13 @@ void VIC::renderScanline() {
                 if(charMemOffset == 0x1000 || charMemOffset == 0x1800) {
                     charData = bus->readCharRom(charRomAddr);
                 } else {
-                    charData = bus->read(charRomAddr + charMemOffset + bankAddress);
+                    charData = fetch(charRomAddr + charMemOffset + bankAddress);
                 }
             } else if(bitmapMode) {
-                charData = bus->read(bitmapOffset + bankAddress + baseScreenRow + cellX);
+                charData = fetch(bitmapOffset + bankAddress + baseScreenRow + cellX);
             } else {
                 const uint16_t charRomAddr = charCode * 8 + pixelRowWithinChar;
-                charData = bus->read(charRomAddr + charMemOffset + bankAddress);
+                charData = fetch(charRomAddr + charMemOffset + bankAddress);
             }
 
             const int screenX = ((cellX * 8) - hScroll + 320) % 320;
@@ -194,8 +224,8 @@ void VIC::renderScanline() {
                 }
 
                 const int x = (screenX + bit * 2) % 320;
-                screen[screenBaseIndex + x] = color;
-                screen[screenBaseIndex + ((x + 1) % 320)] = color;
+                pixels[screenBaseIndex + x] = color;
+                pixels[screenBaseIndex + ((x + 1) % 320)] = color;
             }
         }
     }
@@ -223,11 +253,11 @@ uint32_t VIC::getColor(uint8_t colorCode) {
     return colors[colorCode & 0x0F];
 }
 
+// bit 7 of $D019 is the IRQ output, held while a latched source is enabled
 void VIC::checkInterrupts() {
-    if(registers[0x19] & registers[0x1A]) {
-        registers[0x19] |= 0x80;
-        cpu->triggerIRQ();
-    }
+    bool asserted = registers[0x19] & registers[0x1A] & 0x0F;
+    registers[0x19] = (registers[0x19] & 0x0F) | (asserted ? 0x80 : 0x00);
+    cpu->setIRQ(IRQ_VIC, asserted);
 }
 
 void VIC::setFramebufferCallback(
@@ -238,3 +268,31 @@ void VIC::setFramebufferCallback(
 void VIC::setCpu(CPU* cpu) {
     this->cpu = cpu;
 }
+
+void VIC::saveState(StateWriter& state) const {
+    state.writeBytes(registers, sizeof(registers));
+    state.write(bankAddress);
+    state.write(frameCount);
+    state.write(rasterLine);
+    state.write(rasterCycle);
+    state.write(cycleCounter);
+    state.write(bitmapMode);
+    state.write(multiColorMode);
+    state.write(charMemOffset);
+    state.write(screenMemoryOffset);
+    state.write(bitmapOffset);
+}
+
+void VIC::loadState(StateReader& state) {
+    state.readBytes(registers, sizeof(registers));
+    state.read(bankAddress);
+    state.read(frameCount);
+    state.read(rasterLine);
+    state.read(rasterCycle);
+    state.read(cycleCounter);
+    state.read(bitmapMode);
+    state.read(multiColorMode);
+    state.read(charMemOffset);
+    state.read(screenMemoryOffset);
+    state.read(bitmapOffset);
+}
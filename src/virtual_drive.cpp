@@ -0,0 +1,423 @@
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <virtual_drive.hpp>
+
+#define DIRECTORY_TRACK 18
+#define DIRECTORY_ENTRY_SIZE 32
+#define BLOCK_DATA_SIZE 254
+
+static const char* fileTypes[8] = {"DEL", "SEQ", "PRG", "USR", "REL", "???", "???", "???"};
+
+// '*' matches the rest of the name and '?' any single character
+static bool matchFilename(const std::string& pattern, const std::string& name) {
+    for(size_t i = 0; i < pattern.size(); i++) {
+        if(pattern[i] == '*') return true;
+        if(i >= name.size() || (pattern[i] != '?' && pattern[i] != name[i])) return false;
+    }
+    return pattern.size() == name.size();
+}
+
+static std::string toPetscii(const std::string& host) {
+    std::string name = host;
+    std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+    return name;
+}
+
+static std::string toHost(const std::string& petscii) {
+    std::string name = petscii;
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+    return name;
+}
+
+VirtualDrive::VirtualDrive(CPU* cpu, C64Bus* bus, uint8_t device)
+    : cpu(cpu), bus(bus), device(device) {
+    cpu->setTrap(KERNAL_LOAD_ENTRY, [this]() { return load(); });
+    cpu->setTrap(KERNAL_SAVE_ENTRY, [this]() { return save(); });
+}
+
+VirtualDrive::~VirtualDrive() {
+    cpu->clearTrap(KERNAL_LOAD_ENTRY);
+    cpu->clearTrap(KERNAL_SAVE_ENTRY);
+    detach();
+}
+
+bool VirtualDrive::attach(const std::string& path) {
+    detach();
+    if(std::filesystem::is_directory(path)) {
+        hostDirectory = path;
+        this->path = path;
+        return true;
+    }
+
+    DiskImage* image = new DiskImage();
+    if(!image->open(path)) {
+        delete image;
+        return false;
+    }
+    disk = image;
+    ownsDisk = true;
+    this->path = path;
+    return true;
+}
+
+void VirtualDrive::attachDisk(DiskImage* disk) {
+    detach();
+    this->disk = disk;
+}
+
+void VirtualDrive::detach() {
+    if(ownsDisk) {
+        delete disk;
+    }
+    disk = nullptr;
+    ownsDisk = false;
+    path.clear();
+    hostDirectory.clear();
+}
+
+bool VirtualDrive::load() {
+    // other devices and a banked out KERNAL run the normal code
+    if(bus->ram[ZP_DEVICE] != device || !(bus->dataRegister & 0x02) ||
+       (!disk && hostDirectory.empty())) {
+        return false;
+    }
+
+    bool verify = cpu->A != 0;
+    std::string name = getFilename();
+    if(name.empty()) {
+        returnFromTrap(KERNAL_ERROR_MISSING_FILENAME);
+        return true;
+    }
+
+    std::vector<uint8_t> data;
+    if(name == "$") {
+        data = buildDirectory();
+    } else if(!readFile(name, data) || data.size() < 2) {
+        returnFromTrap(KERNAL_ERROR_FILE_NOT_FOUND);
+        return true;
+    }
+
+    // secondary address 0 loads to the address in X/Y instead of the one in the file
+    uint16_t address = bus->ram[ZP_SECONDARY_ADDRESS] == 0
+                           ? bus->ram[ZP_LOAD_ADDRESS] | (bus->ram[ZP_LOAD_ADDRESS + 1] << 8)
+                           : data[0] | (data[1] << 8);
+    size_t length = std::min(data.size() - 2, static_cast<size_t>(0x10000 - address));
+
+    // end of file, bit 4 is a verify error
+    uint8_t status = 0x40;
+    if(verify) {
+        if(std::memcmp(bus->ram + address, data.data() + 2, length) != 0) {
+            status |= 0x10;
+        }
+    } else {
+        std::memcpy(bus->ram + address, data.data() + 2, length);
+    }
+
+    uint16_t end = address + length;
+    bus->ram[ZP_STATUS] = status;
+    bus->ram[ZP_END_ADDRESS] = end & 0xFF;
+    bus->ram[ZP_END_ADDRESS + 1] = end >> 8;
+    cpu->X = end & 0xFF;
+    cpu->Y = end >> 8;
+    returnFromTrap(0);
+    return true;
+}
+
+bool VirtualDrive::save() {
+    if(bus->ram[ZP_DEVICE] != device || !(bus->dataRegister & 0x02) ||
+       (!disk && hostDirectory.empty())) {
+        return false;
+    }
+
+    std::string name = getFilename();
+    if(name.empty()) {
+        returnFromTrap(KERNAL_ERROR_MISSING_FILENAME);
+        return true;
+    }
+
+    uint16_t start = bus->ram[ZP_SAVE_START] | (bus->ram[ZP_SAVE_START + 1] << 8);
+    uint16_t end = bus->ram[ZP_END_ADDRESS] | (bus->ram[ZP_END_ADDRESS + 1] << 8);
+    std::vector<uint8_t> data(2 + (end > start ? end - start : 0));
+    data[0] = start & 0xFF;
+    data[1] = start >> 8;
+    std::copy_n(bus->ram + start, data.size() - 2, data.begin() + 2);
+
+    bus->ram[ZP_STATUS] = 0;
+    returnFromTrap(writeFile(name, data) ? 0 : KERNAL_ERROR_DEVICE_NOT_PRESENT);
+    return true;
+}
+
+// emulates the RTS at the end of the KERNAL routine, carry reports an error
+void VirtualDrive::returnFromTrap(uint8_t error) {
+    if(error) {
+        cpu->P |= CARRY_FLAG;
+        cpu->A = error;
+    } else {
+        cpu->P &= ~CARRY_FLAG;
+    }
+    // the stack page is always RAM, the pulls take their two cycles
+    uint8_t low = bus->ram[0x100 | ++cpu->SP];
+    uint8_t high = bus->ram[0x100 | ++cpu->SP];
+    cpu->stepCycles(2);
+    cpu->PC = (low | high << 8) + 1;
+}
+
+std::string VirtualDrive::getFilename() {
+    uint16_t address = bus->ram[ZP_FILENAME] | (bus->ram[ZP_FILENAME + 1] << 8);
+    std::string name;
+    for(int i = 0; i < bus->ram[ZP_FILENAME_LENGTH]; i++) {
+        name += static_cast<char>(bus->read(address + i));
+    }
+    // drop the drive number and the replace prefix as in "@0:NAME"
+    size_t colon = name.find(':');
+    if(colon != std::string::npos) {
+        name = name.substr(colon + 1);
+    }
+    return name;
+}
+
+std::vector<VirtualDriveEntry> VirtualDrive::listFiles() {
+    std::vector<VirtualDriveEntry> entries;
+    if(!hostDirectory.empty()) {
+        std::error_code error;
+        for(const auto& file : std::filesystem::directory_iterator(hostDirectory, error)) {
+            std::string extension = toPetscii(file.path().extension().string());
+            if(!file.is_regular_file() || extension != ".PRG") {
+                continue;
+            }
+            uint16_t blocks = std::min<size_t>((file.file_size() + BLOCK_DATA_SIZE - 1) /
+                                                   BLOCK_DATA_SIZE,
+                                               0xFFFF);
+            entries.push_back(
+                {toPetscii(file.path().stem().string()), 0x82, blocks, file.path().string(), 0, 0});
+        }
+        std::sort(entries.begin(), entries.end(),
+                  [](const VirtualDriveEntry& a, const VirtualDriveEntry& b) {
+                      return a.name < b.name;
+                  });
+        return entries;
+    }
+
+    uint8_t sector[D64_SECTOR_SIZE];
+    uint8_t track = DIRECTORY_TRACK;
+    uint8_t sectorNumber = 1;
+    // the directory track cannot hold more than 18 directory sectors
+    for(int guard = 0; track != 0 && guard < 18; guard++) {
+        if(!disk->readSector(track, sectorNumber, sector)) {
+            break;
+        }
+        for(int i = 0; i < 8; i++) {
+            const uint8_t* entry = sector + i * DIRECTORY_ENTRY_SIZE;
+            if(entry[2] == 0) {
+                continue;
+            }
+            std::string name;
+            for(int j = 0; j < 16 && entry[5 + j] != 0xA0; j++) {
+                name += static_cast<char>(entry[5 + j]);
+            }
+            uint16_t blocks = entry[30] | (entry[31] << 8);
+            entries.push_back({name, entry[2], blocks, "", entry[3], entry[4]});
+        }
+        track = sector[0];
+        sectorNumber = sector[1];
+    }
+    return entries;
+}
+
+bool VirtualDrive::readFile(const std::string& pattern, std::vector<uint8_t>& data) {
+    for(const VirtualDriveEntry& entry : listFiles()) {
+        // only closed PRG files can be loaded
+        if(entry.type != 0x82 || !matchFilename(pattern, entry.name)) {
+            continue;
+        }
+        if(disk) {
+            return readDiskFile(entry, data);
+        }
+        std::ifstream file(entry.path, std::ios::binary | std::ios::in);
+        if(!file.is_open()) {
+            std::cerr << "Failed to open file: " << entry.path << "\n";
+            return false;
+        }
+        data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return true;
+    }
+    return false;
+}
+
+bool VirtualDrive::writeFile(const std::string& name, const std::vector<uint8_t>& data) {
+    if(disk) {
+        return writeDiskFile(name, data);
+    }
+
+    std::string path = (std::filesystem::path(hostDirectory) / (toHost(name) + ".prg")).string();
+    std::ofstream file(path, std::ios::binary | std::ios::out | std::ios::trunc);
+    if(!file.is_open()) {
+        std::cerr << "Failed to open file: " << path << "\n";
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(data.data()), data.size());
+    return file.good();
+}
+
+// the directory is a BASIC program with the block counts as line numbers
+std::vector<uint8_t> VirtualDrive::buildDirectory() {
+    std::vector<uint8_t> program = {0x01, 0x04};
+    auto addLine = [&program](uint16_t number, const std::string& text) {
+        // BASIC relinks the program after loading, the link only has to be non-zero
+        program.insert(program.end(), {0x01, 0x01, static_cast<uint8_t>(number & 0xFF),
+                                       static_cast<uint8_t>(number >> 8)});
+        program.insert(program.end(), text.begin(), text.end());
+        program.push_back(0x00);
+    };
+
+    std::string diskName = "VIRTUAL DRIVE";
+    std::string id = "00 2A";
+    size_t freeBlocks = 0;
+    uint8_t bam[D64_SECTOR_SIZE];
+    if(disk && disk->readSector(DIRECTORY_TRACK, 0, bam)) {
+        diskName.clear();
+        for(int i = 0; i < 16 && bam[0x90 + i] != 0xA0; i++) {
+            diskName += static_cast<char>(bam[0x90 + i]);
+        }
+        id = std::string(reinterpret_cast<const char*>(bam + 0xA2), 5);
+        for(int track = 1; track <= 35; track++) {
+            if(track != DIRECTORY_TRACK) {
+                freeBlocks += bam[4 + (track - 1) * 4];
+            }
+        }
+    } else if(!disk) {
+        std::error_code error;
+        freeBlocks = std::filesystem::space(hostDirectory, error).available / BLOCK_DATA_SIZE;
+    }
+
+    diskName.resize(16, ' ');
+    addLine(0, "\x12\"" + diskName + "\" " + id);
+    for(const VirtualDriveEntry& entry : listFiles()) {
+        std::string text = entry.blocks < 10 ? "   " : entry.blocks < 100 ? "  " : " ";
+        text += "\"" + entry.name + "\"";
+        text.resize(text.size() + 16 - std::min<size_t>(entry.name.size(), 16), ' ');
+        text += (entry.type & 0x80) ? " " : "*";
+        text += fileTypes[entry.type & 0x07];
+        addLine(entry.blocks, text);
+    }
+    addLine(std::min<size_t>(freeBlocks, 0xFFFF), "BLOCKS FREE.");
+    program.insert(program.end(), {0x00, 0x00});
+    return program;
+}
+
+bool VirtualDrive::readDiskFile(const VirtualDriveEntry& entry, std::vector<uint8_t>& data) {
+    uint8_t sector[D64_SECTOR_SIZE];
+    uint8_t track = entry.track;
+    uint8_t sectorNumber = entry.sector;
+    // a broken chain could loop forever
+    for(int guard = 0; track != 0; guard++) {
+        if(guard > 768 || !disk->readSector(track, sectorNumber, sector)) {
+            std::cerr << "Broken sector chain in " << entry.name << "\n";
+            return false;
+        }
+        // the last sector stores the index of its last byte instead of a sector number
+        size_t end = sector[0] == 0 ? std::max<size_t>(sector[1], 1) + 1 : D64_SECTOR_SIZE;
+        data.insert(data.end(), sector + 2, sector + end);
+        track = sector[0];
+        sectorNumber = sector[1];
+    }
+    return true;
+}
+
+bool VirtualDrive::writeDiskFile(const std::string& name, const std::vector<uint8_t>& data) {
+    for(const VirtualDriveEntry& entry : listFiles()) {
+        if(entry.name == name) {
+            std::cerr << "File exists: " << name << "\n";
+            return false;
+        }
+    }
+
+    // find a free directory entry first so a full directory leaves the disk untouched
+    uint8_t directory[D64_SECTOR_SIZE];
+    uint8_t directoryTrack = DIRECTORY_TRACK;
+    uint8_t directorySector = 1;
+    int slot = -1;
+    for(int guard = 0; directoryTrack != 0 && guard < 18 && slot < 0; guard++) {
+        if(!disk->readSector(directoryTrack, directorySector, directory)) {
+            break;
+        }
+        for(int i = 0; i < 8 && slot < 0; i++) {
+            if(directory[i * DIRECTORY_ENTRY_SIZE + 2] == 0) {
+                slot = i;
+            }
+        }
+        if(slot < 0) {
+            directoryTrack = directory[0];
+            directorySector = directory[1];
+        }
+    }
+    if(slot < 0) {
+        std::cerr << "Directory full\n";
+        return false;
+    }
+
+    uint8_t bam[D64_SECTOR_SIZE];
+    if(!disk->readSector(DIRECTORY_TRACK, 0, bam)) {
+        return false;
+    }
+    size_t blocks = std::max<size_t>((data.size() + BLOCK_DATA_SIZE - 1) / BLOCK_DATA_SIZE, 1);
+    std::vector<std::pair<uint8_t, uint8_t>> chain(blocks);
+    for(auto& [track, sector] : chain) {
+        if(!allocateSector(bam, track, sector)) {
+            std::cerr << "Disk full\n";
+            return false;
+        }
+    }
+
+    for(size_t i = 0; i < blocks; i++) {
+        uint8_t sector[D64_SECTOR_SIZE] = {};
+        size_t offset = i * BLOCK_DATA_SIZE;
+        size_t size = std::min<size_t>(data.size() - offset, BLOCK_DATA_SIZE);
+        std::memcpy(sector + 2, data.data() + offset, size);
+        if(i + 1 < blocks) {
+            sector[0] = chain[i + 1].first;
+            sector[1] = chain[i + 1].second;
+        } else {
+            sector[0] = 0;
+            sector[1] = size + 1;
+        }
+        disk->writeSector(chain[i].first, chain[i].second, sector);
+    }
+
+    uint8_t* entry = directory + slot * DIRECTORY_ENTRY_SIZE;
+    entry[2] = 0x82;
+    entry[3] = chain[0].first;
+    entry[4] = chain[0].second;
+    std::memset(entry + 5, 0xA0, 16);
+    std::memcpy(entry + 5, name.data(), std::min<size_t>(name.size(), 16));
+    entry[30] = blocks & 0xFF;
+    entry[31] = blocks >> 8;
+    disk->writeSector(directoryTrack, directorySector, directory);
+    disk->writeSector(DIRECTORY_TRACK, 0, bam);
+    return true;
+}
+
+bool VirtualDrive::allocateSector(uint8_t* bam, uint8_t& track, uint8_t& sector) {
+    // like DOS, fill the tracks closest to the directory first
+    for(int distance = 1; distance < DIRECTORY_TRACK; distance++) {
+        for(int candidate : {DIRECTORY_TRACK - distance, DIRECTORY_TRACK + distance}) {
+            if(candidate < 1 || candidate > 35) {
+                continue;
+            }
+            uint8_t* entry = bam + 4 + (candidate - 1) * 4;
+            for(int s = 0; s < DiskImage::sectorsPerTrack(candidate); s++) {
+                if(entry[1 + s / 8] & (1 << (s % 8))) {
+                    entry[1 + s / 8] &= ~(1 << (s % 8));
+                    entry[0]--;
+                    track = candidate;
+                    sector = s;
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
@@ -8,6 +8,8 @@
 #include <emscripten.h>
 #include <emscripten/bind.h>
 #include <iostream>
+#include <memory>
+#include <rewind.hpp>
 #include <sys/types.h>
 #include <system.hpp>
 #include <thread>
@@ -19,6 +21,8 @@ std::vector<uint32_t> fbDiff = {};
 std::chrono::steady_clock::time_point lastTime = std::chrono::steady_clock::now();
 
 System emulatorSystem;
+// the last minute of frames for stepBack, kept from startEmulator on
+std::unique_ptr<RewindBuffer> rewindBuffer;
 bool paused = false;
 
 extern "C" {
@@ -29,6 +33,12 @@ void reset() {
     emulatorSystem.reset();
 }
 
+// restores the previous frame, false when there is none left
+EMSCRIPTEN_KEEPALIVE
+bool stepBack() {
+    return rewindBuffer && rewindBuffer->stepBack();
+}
+
 void pause() {
     paused = true;
 }
@@ -41,10 +51,10 @@ uint8_t* getMemory() {
     return emulatorSystem.bus->ram;
 }
 
+// key codes are the values of the Key enum
 EMSCRIPTEN_KEEPALIVE
-void keyDown(const char* key) {
-    std::string keyStr(key);
-    emulatorSystem.input->setKeyPressed(keyStr, true);
+void keyDown(int key) {
+    emulatorSystem.input->keyDown(static_cast<Key>(key));
 }
 
 EMSCRIPTEN_KEEPALIVE
@@ -53,9 +63,8 @@ int getClockSpeed() {
 }
 
 EMSCRIPTEN_KEEPALIVE
-void keyUp(const char* key) {
-    std::string keyStr(key);
-    emulatorSystem.input->setKeyPressed(keyStr, false);
+void keyUp(int key) {
+    emulatorSystem.input->keyUp(static_cast<Key>(key));
 }
 
 EMSCRIPTEN_KEEPALIVE
@@ -180,6 +189,7 @@ void startEmulator() {
         std::memcpy(lastFramebuffer.data(), screen.data(), screen.size() * sizeof(uint32_t));
     });
     emulatorSystem.powerOn();
+    rewindBuffer = std::make_unique<RewindBuffer>(&emulatorSystem);
     emulatorSystem.sid->setWriteCallback([]() { EM_ASM({ sidStateChanged(); }); });
 
     while(true) {
@@ -113,6 +113,18 @@ function inputTextAsBytes(bytes) {
 
 initModule(Module);
 
+// same order as the Key enum in input.hpp
+const C64_KEYS = [
+    "STOP", "Q", "C=", "SPACE", "2", "CTRL", "<-", "1",
+    "/", "^", "=", "RSHIFT", "HOME", ";", "*", "£",
+    ",", "@", ":", ".", "-", "L", "P", "+",
+    "N", "O", "K", "M", "0", "J", "I", "9",
+    "V", "U", "H", "B", "8", "G", "Y", "7",
+    "X", "T", "F", "C", "6", "D", "R", "5",
+    "LSHIFT", "E", "S", "Z", "4", "A", "W", "3",
+    "DOWN", "F5", "F3", "F1", "F7", "RIGHT", "RETURN", "DELETE",
+];
+
 onmessage = function (e) {
     let data = e.data;
     if (data.type === "start") {
@@ -123,11 +135,11 @@ onmessage = function (e) {
             Module.ccall("startEmulator", null, [], []);
         }
     } 
-    if (data.type === "keyUp") {
-        Module.ccall("keyUp", null, ["string"], [data.key]);
+    if (data.type === "keyUp" && C64_KEYS.indexOf(data.key) >= 0) {
+        Module.ccall("keyUp", null, ["number"], [C64_KEYS.indexOf(data.key)]);
     } 
-    if (data.type === "keyDown") {
-        Module.ccall("keyDown", null, ["string"], [data.key]);
+    if (data.type === "keyDown" && C64_KEYS.indexOf(data.key) >= 0) {
+        Module.ccall("keyDown", null, ["number"], [C64_KEYS.indexOf(data.key)]);
     }
     if (data.type === "inputText") {
         inputTextAsBytes(data.bytes);
@@ -150,6 +162,9 @@ onmessage = function (e) {
     if (data.type === "reset") {
         Module.ccall("reset", null, [], []);
     }
+    if (data.type === "stepBack") {
+        Module.ccall("stepBack", "boolean", [], []);
+    }
     if (data.type === "pause") {
         paused = true;
         Module.ccall("togglePause", null, [], []);
@@ -0,0 +1,321 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <flat_bus.hpp>
+#include <functional>
+#include <string>
+#include <system.hpp>
+#include <vector>
+
+// every benchmark runs this often and reports the median, the first run also warms the caches
+#define BENCH_REPETITIONS 5
+
+#define BENCH_INSTRUCTIONS 2000000
+#define BENCH_ACCESSES 4000000
+#define BENCH_TICKS 10000000
+#define BENCH_VIC_FRAMES 50
+#define BENCH_SYSTEM_FRAMES 100
+
+#define BENCH_PROGRAM 0x0200
+
+// measures only what runs between start and stop, so setup can happen inside a benchmark
+class Timer {
+public:
+    void start() { begin = std::chrono::steady_clock::now(); }
+    void stop() { elapsed += std::chrono::steady_clock::now() - begin; }
+
+    std::chrono::steady_clock::duration elapsed{0};
+
+private:
+    std::chrono::steady_clock::time_point begin;
+};
+
+// returns the number of items it processed between start and stop
+using BenchFunction = std::function<uint64_t(Timer&)>;
+
+struct Benchmark {
+    std::string name;
+    // what an item is, for the report
+    std::string item;
+    BenchFunction run;
+};
+
+struct BenchResult {
+    std::string name;
+    std::string item;
+    uint64_t items;
+    // per item
+    double medianNanoseconds;
+    double minNanoseconds;
+    double maxNanoseconds;
+};
+
+static volatile uint8_t sink;
+
+static BenchFunction cpuBenchmark(std::vector<uint8_t> program) {
+    return [program](Timer& timer) {
+        FlatBus bus;
+        std::copy(program.begin(), program.end(), bus.ram + BENCH_PROGRAM);
+        // pointers for the indirect modes and a jump vector back to the program
+        bus.ram[0x10] = 0x00;
+        bus.ram[0x11] = 0x30;
+        bus.ram[0x12] = 0x00;
+        bus.ram[0x13] = 0x31;
+        bus.ram[0x14] = BENCH_PROGRAM & 0xFF;
+        bus.ram[0x15] = BENCH_PROGRAM >> 8;
+        CPUCore<FlatBus> cpu(&bus);
+        cpu.powerOn();
+        cpu.PC = BENCH_PROGRAM;
+        timer.start();
+        for(int i = 0; i < BENCH_INSTRUCTIONS; i++) {
+            cpu.executeOnce();
+        }
+        timer.stop();
+        return static_cast<uint64_t>(BENCH_INSTRUCTIONS);
+    };
+}
+
+// appends JMP to the start of the program
+static std::vector<uint8_t> loop(std::vector<uint8_t> program) {
+    program.insert(program.end(), {0x4C, BENCH_PROGRAM & 0xFF, BENCH_PROGRAM >> 8});
+    return program;
+}
+
+static BenchFunction busReadBenchmark(uint16_t from, uint16_t size) {
+    return [from, size](Timer& timer) {
+        System system;
+        system.powerOn();
+        C64Bus* bus = system.bus;
+        uint8_t value = 0;
+        timer.start();
+        for(int i = 0; i < BENCH_ACCESSES; i++) {
+            value ^= bus->read(from + i % size);
+        }
+        timer.stop();
+        sink = value;
+        return static_cast<uint64_t>(BENCH_ACCESSES);
+    };
+}
+
+static BenchFunction busWriteBenchmark(uint16_t from, uint16_t size) {
+    return [from, size](Timer& timer) {
+        System system;
+        system.powerOn();
+        C64Bus* bus = system.bus;
+        timer.start();
+        for(int i = 0; i < BENCH_ACCESSES; i++) {
+            bus->write(from + i % size, i);
+        }
+        timer.stop();
+        return static_cast<uint64_t>(BENCH_ACCESSES);
+    };
+}
+
+// renderScanline is reached through tick, a whole frame at a time, and the logic only run
+// shows what the ticks cost without it
+static BenchFunction vicBenchmark(uint8_t d011, uint8_t d016, uint8_t dd00, bool rendering) {
+    return [=](Timer& timer) {
+        System system;
+        system.powerOn();
+        system.runUntilReady();
+        system.bus->write(0xDD00, dd00);
+        system.bus->write(0xD011, d011);
+        system.bus->write(0xD016, d016);
+        system.vic->setRenderingEnabled(rendering);
+        timer.start();
+        for(int i = 0; i < BENCH_VIC_FRAMES * 312 * 63; i++) {
+            system.vic->tick();
+        }
+        timer.stop();
+        return static_cast<uint64_t>(BENCH_VIC_FRAMES * 200);
+    };
+}
+
+static BenchFunction sidBenchmark(bool voice) {
+    return [voice](Timer& timer) {
+        SID sid;
+        if(voice) {
+            // voice 1 playing a pulse at about 440 Hz
+            sid.write(0xD400, 0x2B);
+            sid.write(0xD401, 0x1D);
+            sid.write(0xD403, 0x08);
+            sid.write(0xD418, 0x0F);
+            sid.write(0xD404, 0x41);
+        }
+        float output = 0;
+        timer.start();
+        for(int i = 0; i < BENCH_TICKS; i++) {
+            output += sid.tick();
+        }
+        timer.stop();
+        sink = output > 0;
+        return static_cast<uint64_t>(BENCH_TICKS);
+    };
+}
+
+static BenchFunction ciaBenchmark() {
+    return [](Timer& timer) {
+        System system;
+        system.powerOn();
+        // timer A counting down continuously from $4000 with its interrupt enabled
+        system.bus->write(0xDC04, 0x00);
+        system.bus->write(0xDC05, 0x40);
+        system.bus->write(0xDC0D, 0x81);
+        system.bus->write(0xDC0E, 0x11);
+        timer.start();
+        for(int i = 0; i < BENCH_TICKS; i++) {
+            system.cia1->tick();
+        }
+        timer.stop();
+        return static_cast<uint64_t>(BENCH_TICKS);
+    };
+}
+
+static BenchFunction systemBenchmark(bool rendering) {
+    return [rendering](Timer& timer) {
+        System system;
+        system.powerOn();
+        system.runUntilReady();
+        system.vic->setRenderingEnabled(rendering);
+        uint32_t end = system.vic->frameCount + BENCH_SYSTEM_FRAMES;
+        timer.start();
+        while(system.vic->frameCount < end) {
+            system.cpu->executeOnce();
+        }
+        timer.stop();
+        return static_cast<uint64_t>(BENCH_SYSTEM_FRAMES);
+    };
+}
+
+static std::vector<Benchmark> getBenchmarks() {
+    return {
+        // LDA abs, STA abs, LDX zp, STX zp, LDY #, STY abs,X
+        {"cpu/load_store", "instruction",
+         cpuBenchmark(loop({0xAD, 0x00, 0x10, 0x8D, 0x01, 0x10, 0xA6, 0x20, 0x86, 0x21, 0xA0,
+                            0x01, 0x9D, 0x00, 0x10}))},
+        // ADC #, SBC #, AND #, ORA #, EOR zp, CMP #, CPX #, BIT zp
+        {"cpu/alu", "instruction",
+         cpuBenchmark(loop({0x69, 0x01, 0xE9, 0x02, 0x29, 0xF0, 0x09, 0x0F, 0x45, 0x20, 0xC9,
+                            0x03, 0xE0, 0x04, 0x24, 0x20}))},
+        // INC zp, DEC abs, ASL zp, ROR abs, LSR A, ROL zp,X
+        {"cpu/read_modify_write", "instruction",
+         cpuBenchmark(loop({0xE6, 0x20, 0xCE, 0x00, 0x10, 0x06, 0x21, 0x6E, 0x01, 0x10, 0x4A,
+                            0x36, 0x22}))},
+        // DEX, BNE back to DEX, taken 255 times in 256
+        {"cpu/branch", "instruction", cpuBenchmark(loop({0xCA, 0xD0, 0xFD}))},
+        // PHA, PHP, PLP, PLA, TSX, TXS
+        {"cpu/stack", "instruction", cpuBenchmark(loop({0x48, 0x08, 0x28, 0x68, 0xBA, 0x9A}))},
+        // JSR to the RTS right after the loop
+        {"cpu/jsr_rts", "instruction",
+         cpuBenchmark({0x20, (BENCH_PROGRAM + 6) & 0xFF, (BENCH_PROGRAM + 6) >> 8, 0x4C,
+                       BENCH_PROGRAM & 0xFF, BENCH_PROGRAM >> 8, 0x60})},
+        // SED, ADC #, SBC #, CLD
+        {"cpu/decimal", "instruction",
+         cpuBenchmark(loop({0xF8, 0x69, 0x19, 0xE9, 0x07, 0xD8}))},
+        // LDA (zp),Y, STA (zp,X) and JMP (abs) back to the start
+        {"cpu/indirect", "instruction", cpuBenchmark({0xB1, 0x10, 0x81, 0x12, 0x6C, 0x14, 0x00})},
+
+        {"bus/read_ram", "access", busReadBenchmark(0x0800, 0x1000)},
+        {"bus/read_basic_rom", "access", busReadBenchmark(0xA000, 0x1000)},
+        {"bus/read_kernal_rom", "access", busReadBenchmark(0xE000, 0x1000)},
+        {"bus/read_vic", "access", busReadBenchmark(0xD000, 0x2F)},
+        {"bus/read_color_ram", "access", busReadBenchmark(0xD800, 0x03E8)},
+        {"bus/read_cia", "access", busReadBenchmark(0xDC04, 0x04)},
+        {"bus/write_ram", "access", busWriteBenchmark(0x0800, 0x1000)},
+        {"bus/write_under_rom", "access", busWriteBenchmark(0xE000, 0x1000)},
+        {"bus/write_vic", "access", busWriteBenchmark(0xD020, 0x02)},
+        {"bus/write_color_ram", "access", busWriteBenchmark(0xD800, 0x03E8)},
+        {"bus/write_sid", "access", busWriteBenchmark(0xD400, 0x18)},
+
+        {"vic/text", "scanline", vicBenchmark(0x1B, 0xC8, 0x97, true)},
+        {"vic/multicolor_text", "scanline", vicBenchmark(0x1B, 0xD8, 0x97, true)},
+        // bank 1 at $4000, the character ROM is only visible in banks 0 and 2
+        {"vic/bitmap", "scanline", vicBenchmark(0x3B, 0xC8, 0x96, true)},
+        {"vic/multicolor_bitmap", "scanline", vicBenchmark(0x3B, 0xD8, 0x96, true)},
+        {"vic/logic_only", "scanline", vicBenchmark(0x1B, 0xC8, 0x97, false)},
+
+        {"sid/tick_silent", "tick", sidBenchmark(false)},
+        {"sid/tick_pulse", "tick", sidBenchmark(true)},
+        {"cia/tick_timer", "tick", ciaBenchmark()},
+
+        {"system/frame", "frame", systemBenchmark(true)},
+        {"system/frame_logic_only", "frame", systemBenchmark(false)},
+    };
+}
+
+static BenchResult run(const Benchmark& benchmark) {
+    std::vector<double> times;
+    uint64_t items = 0;
+    for(int i = 0; i < BENCH_REPETITIONS; i++) {
+        Timer timer;
+        items = benchmark.run(timer);
+        times.push_back(std::chrono::duration<double, std::nano>(timer.elapsed).count() / items);
+    }
+    std::sort(times.begin(), times.end());
+    return {benchmark.name, benchmark.item, items, times[times.size() / 2], times.front(),
+            times.back()};
+}
+
+// the layout of Google Benchmark's JSON output so the same tooling can compare runs
+static bool writeJson(const std::string& path, const std::vector<BenchResult>& results) {
+    FILE* file = fopen(path.c_str(), "w");
+    if(!file) {
+        fprintf(stderr, "Failed to open file: %s\n", path.c_str());
+        return false;
+    }
+    char date[32];
+    time_t now = time(nullptr);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+    fprintf(file, "{\n  \"context\": {\"date\": \"%s\", \"repetitions\": %d},\n", date,
+            BENCH_REPETITIONS);
+    fprintf(file, "  \"benchmarks\": [\n");
+    for(size_t i = 0; i < results.size(); i++) {
+        const BenchResult& result = results[i];
+        fprintf(file,
+                "    {\"name\": \"%s\", \"iterations\": %llu, \"real_time\": %.3f, "
+                "\"min_time\": %.3f, \"max_time\": %.3f, \"time_unit\": \"ns\", "
+                "\"items_per_second\": %.0f, \"item\": \"%s\"}%s\n",
+                result.name.c_str(), static_cast<unsigned long long>(result.items),
+                result.medianNanoseconds, result.minNanoseconds, result.maxNanoseconds,
+                1e9 / result.medianNanoseconds, result.item.c_str(),
+                i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+    return true;
+}
+
+// usage: bench [--json <file>] [filter], runs the benchmarks whose name contains the filter
+int main(int argc, char** argv) {
+    std::string json;
+    std::string filter;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json = argv[++i];
+        } else if(argv[i][0] != '-' && filter.empty()) {
+            filter = argv[i];
+        } else {
+            fprintf(stderr, "usage: %s [--json <file>] [filter]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    std::vector<BenchResult> results;
+    printf("%-28s %12s %16s\n", "benchmark", "ns/item", "items/s");
+    for(const Benchmark& benchmark : getBenchmarks()) {
+        if(benchmark.name.find(filter) == std::string::npos) {
+            continue;
+        }
+        BenchResult result = run(benchmark);
+        printf("%-28s %12.2f %16.0f %s\n", result.name.c_str(), result.medianNanoseconds,
+               1e9 / result.medianNanoseconds, result.item.c_str());
+        fflush(stdout);
+        results.push_back(result);
+    }
+    if(!json.empty() && !writeJson(json, results)) {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,267 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cpu.hpp>
+#include <flat_bus.hpp>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// where Klaus Dormann's 6502_functional_test.bin starts and where it loops once every test
+// passed, for the image assembled with the default options
+#define KLAUS_START 0x0400
+#define KLAUS_SUCCESS 0x3469
+
+// the BASIC stub of every Lorenz test is SYS 2070
+#define LORENZ_START 0x0816
+// KERNAL entry points the Lorenz tests call, the harness traps them
+#define LORENZ_CHROUT 0xFFD2
+#define LORENZ_GETIN 0xFFE4
+#define LORENZ_LOAD 0xE16F
+#define LORENZ_IRQ_ENTRY 0xFF48
+#define LORENZ_IRQ_EXIT 0xEA81
+// the suite returns to BASIC through either of these when it is done
+#define LORENZ_WARM_START 0x8000
+#define LORENZ_READY 0xA474
+
+#define DEFAULT_LIMIT 4000000000ULL
+
+static bool readFile(const std::string& path, std::vector<uint8_t>& data) {
+    std::ifstream file(path, std::ios::binary | std::ios::in);
+    if(!file.is_open()) {
+        return false;
+    }
+    data.assign(std::istreambuf_iterator<char>(file), {});
+    return true;
+}
+
+static void printSpeed(const CPU& cpu, std::chrono::steady_clock::time_point start) {
+    double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%llu instructions, %zu cycles in %.2f s, %.1f M instructions/s, %.1f MHz\n",
+           static_cast<unsigned long long>(cpu.instructionCount), cpu.cycles, seconds,
+           cpu.instructionCount / seconds / 1e6, cpu.cycles / seconds / 1e6);
+}
+
+// Runs a raw image until an instruction jumps or branches to itself, the way Klaus Dormann's
+// tests stop. Looping at the success address passes, looping anywhere else is the failed
+// test.
+static int runBinary(const std::string& path, uint16_t load, uint16_t start, uint16_t success,
+                     uint64_t limit, bool cycleStepped) {
+    std::vector<uint8_t> image;
+    if(!readFile(path, image)) {
+        fprintf(stderr, "Failed to open file: %s\n", path.c_str());
+        return 2;
+    }
+    FlatBus bus;
+    size_t size = std::min<size_t>(image.size(), 0x10000 - load);
+    std::copy(image.begin(), image.begin() + size, bus.ram + load);
+
+    CPUCore<FlatBus> cpu(&bus);
+    cpu.setCycleStepped(cycleStepped);
+    cpu.powerOn();
+    cpu.PC = start;
+    auto begin = std::chrono::steady_clock::now();
+    while(cpu.instructionCount < limit) {
+        uint16_t pc = cpu.PC;
+        cpu.executeOnce();
+        if(cpu.PC != pc) {
+            continue;
+        }
+        printSpeed(cpu, begin);
+        if(pc == success) {
+            printf("passed, looping at $%04X\n", pc);
+            return 0;
+        }
+        printf("failed, trapped at $%04X A:%02X X:%02X Y:%02X SP:%02X P:%02X\n", pc, cpu.A,
+               cpu.X, cpu.Y, cpu.SP, cpu.P);
+        return 1;
+    }
+    printSpeed(cpu, begin);
+    printf("failed, no trap after %llu instructions, last PC $%04X\n",
+           static_cast<unsigned long long>(limit), cpu.PC);
+    return 1;
+}
+
+static char fromPetscii(uint8_t c) {
+    if(c >= 0x41 && c <= 0x5A) return c + 0x20;
+    if(c >= 0xC1 && c <= 0xDA) return c - 0x80;
+    if(c == 0x0D) return '\n';
+    if(c >= 0x20 && c < 0x41) return c;
+    return 0;
+}
+
+enum class LorenzStatus { RUNNING, PASSED, FAILED };
+
+// Runs Wolfgang Lorenz's test suite without a C64: CHROUT prints, LOAD loads the next test
+// from the directory and GETIN, which a test only calls to wait for a key after an error,
+// fails. The chain passes when it returns to BASIC, reaches a test that is not in the
+// directory or has run the last test asked for.
+static int runLorenz(const std::string& directory, const std::string& first,
+                     const std::string& last, uint64_t limit, bool cycleStepped) {
+    FlatBus bus;
+    CPUCore<FlatBus> cpu(&bus);
+    cpu.setCycleStepped(cycleStepped);
+    LorenzStatus status = LorenzStatus::RUNNING;
+    std::string current;
+    int passed = 0;
+
+    auto load = [&](const std::string& name) {
+        std::vector<uint8_t> prg;
+        std::string path = directory + "/" + name;
+        if(!readFile(path, prg) && !readFile(path + ".prg", prg)) {
+            return false;
+        }
+        if(prg.size() < 2) {
+            return false;
+        }
+        uint16_t address = prg[0] | (prg[1] << 8);
+        size_t size = std::min<size_t>(prg.size() - 2, 0x10000 - address);
+        std::copy(prg.begin() + 2, prg.begin() + 2 + size, bus.ram + address);
+        current = name;
+        return true;
+    };
+
+    if(!load(first)) {
+        fprintf(stderr, "Failed to open file: %s/%s\n", directory.c_str(), first.c_str());
+        return 2;
+    }
+
+    // just enough of the zero page, the vectors and the KERNAL for the tests
+    bus.ram[0x0002] = 0x00;
+    bus.ram[0xA002] = 0x00;
+    bus.ram[0xA003] = LORENZ_WARM_START >> 8;
+    // a return address to $8000 for the RTS at the end of the suite
+    bus.ram[0x01FE] = 0xFF;
+    bus.ram[0x01FF] = 0x7F;
+    // PHA, TXA, PHA, TYA, PHA, TSX, LDA $0104,X, AND #$10, BEQ +3, JMP ($0316), JMP ($0314)
+    static const uint8_t irqEntry[] = {0x48, 0x8A, 0x48, 0x98, 0x48, 0xBA, 0xBD,
+                                       0x04, 0x01, 0x29, 0x10, 0xF0, 0x03, 0x6C,
+                                       0x16, 0x03, 0x6C, 0x14, 0x03};
+    std::copy(std::begin(irqEntry), std::end(irqEntry), bus.ram + LORENZ_IRQ_ENTRY);
+    // PLA, TAY, PLA, TAX, PLA, RTI
+    static const uint8_t irqExit[] = {0x68, 0xA8, 0x68, 0xAA, 0x68, 0x40};
+    std::copy(std::begin(irqExit), std::end(irqExit), bus.ram + LORENZ_IRQ_EXIT);
+    bus.writeWord(0x0314, LORENZ_IRQ_EXIT);
+    bus.writeWord(0x0316, LORENZ_IRQ_EXIT);
+    bus.writeWord(0xFFFE, LORENZ_IRQ_ENTRY);
+    bus.ram[LORENZ_CHROUT] = 0x60;
+    bus.ram[LORENZ_GETIN] = 0x60;
+
+    cpu.setTrap(LORENZ_CHROUT, [&]() {
+        char c = fromPetscii(cpu.A);
+        if(c) {
+            putchar(c);
+        }
+        return false;
+    });
+    cpu.setTrap(LORENZ_GETIN, [&]() {
+        status = LorenzStatus::FAILED;
+        cpu.A = 3;
+        return false;
+    });
+    cpu.setTrap(LORENZ_LOAD, [&]() {
+        passed++;
+        std::string name;
+        uint16_t pointer = bus.readWord(0xBB);
+        for(uint8_t i = 0; i < bus.ram[0xB7]; i++) {
+            name += fromPetscii(bus.ram[(pointer + i) & 0xFFFF]);
+        }
+        if(current == last || !load(name)) {
+            status = LorenzStatus::PASSED;
+            return true;
+        }
+        cpu.PC = LORENZ_START;
+        return true;
+    });
+    auto exit = [&]() {
+        passed++;
+        status = LorenzStatus::PASSED;
+        return true;
+    };
+    cpu.setTrap(LORENZ_WARM_START, exit);
+    cpu.setTrap(LORENZ_READY, exit);
+
+    cpu.powerOn();
+    cpu.PC = LORENZ_START;
+    auto begin = std::chrono::steady_clock::now();
+    while(status == LorenzStatus::RUNNING && cpu.instructionCount < limit) {
+        cpu.executeOnce();
+    }
+    printf("\n");
+    printSpeed(cpu, begin);
+    if(status == LorenzStatus::PASSED) {
+        printf("passed, %d tests up to %s\n", passed, current.c_str());
+        return 0;
+    }
+    if(status == LorenzStatus::FAILED) {
+        printf("failed in %s after %d passed tests\n", current.c_str(), passed);
+    } else {
+        printf("failed, %s still running after %llu instructions\n", current.c_str(),
+               static_cast<unsigned long long>(limit));
+    }
+    return 1;
+}
+
+static int usage(const char* program) {
+    fprintf(stderr,
+            "usage: %s --bin <image> [--load <addr>] [--start <addr>] [--success <addr>]\n"
+            "       %s --lorenz <directory> [--first <test>] [--last <test>]\n"
+            "       both take --limit <instructions> and --cycle-stepped, addresses in hex\n",
+            program, program);
+    return 2;
+}
+
+// usage: conformance --bin 6502_functional_test.bin or conformance --lorenz <directory>, exits
+// with 0 when the suite passed
+int main(int argc, char** argv) {
+    std::string binary;
+    std::string directory;
+    uint16_t load = 0x0000;
+    uint16_t start = KLAUS_START;
+    uint16_t success = KLAUS_SUCCESS;
+    std::string first = "start";
+    std::string last;
+    uint64_t limit = DEFAULT_LIMIT;
+    bool cycleStepped = false;
+    for(int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        if(option == "--cycle-stepped") {
+            cycleStepped = true;
+            continue;
+        }
+        if(i + 1 >= argc) {
+            return usage(argv[0]);
+        }
+        const char* value = argv[++i];
+        if(option == "--bin") {
+            binary = value;
+        } else if(option == "--lorenz") {
+            directory = value;
+        } else if(option == "--load") {
+            load = strtoul(value, nullptr, 16);
+        } else if(option == "--start") {
+            start = strtoul(value, nullptr, 16);
+        } else if(option == "--success") {
+            success = strtoul(value, nullptr, 16);
+        } else if(option == "--first") {
+            first = value;
+        } else if(option == "--last") {
+            last = value;
+        } else if(option == "--limit") {
+            limit = strtoull(value, nullptr, 10);
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    if(!binary.empty() == !directory.empty()) {
+        return usage(argv[0]);
+    }
+    if(!binary.empty()) {
+        return runBinary(binary, load, start, success, limit, cycleStepped);
+    }
+    return runLorenz(directory, first, last, limit, cycleStepped);
+}
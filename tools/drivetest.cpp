@@ -0,0 +1,261 @@
+#include <cstdio>
+#include <cstring>
+#include <drive1541.hpp>
+#include <serial_bus.hpp>
+#include <string>
+#include <system.hpp>
+#include <vector>
+
+// how long the drive runs before its interrupt counts are checked
+#define DRIVETEST_CYCLES 200000
+// the VIA2 timer 1 period the test ROM sets up, plus the reload cycle
+#define DRIVETEST_TIMER_PERIOD 0x1001
+
+// long enough for the drive to go idle and skip a stretch that is no whole number of timer
+// periods
+#define DRIVETEST_IDLE_CYCLES (DRIVE_IDLE_CYCLES + 300001)
+
+// drive RAM the test ROM counts its interrupts in
+#define DRIVETEST_TIMER_IRQS 0x00
+#define DRIVETEST_ATN_IRQS 0x01
+
+// The repository only has the $C000 half of the 1541 DOS, so this ROM stands in for it and
+// runs the drive CPU, both VIAs, the IRQ wiring and the IEC port without a disk:
+//   $C000 reset: VIA1 drives DATA, CLK and ATN acknowledge, VIA2 timer 1 runs free with its
+//         interrupt on and VIA1 interrupts on ATN through CA1, then waits in a loop
+//   $C034 IRQ: counts VIA2 timer interrupts and ATN edges, answers ATN by setting the
+//         acknowledge and pulling DATA
+static const uint8_t testProgram[] = {
+    0x78,             // SEI
+    0xA2, 0xFF,       // LDX #$FF
+    0x9A,             // TXS
+    0xA9, 0x1A,       // LDA #$1A
+    0x8D, 0x02, 0x18, // STA $1802
+    0xA9, 0x00,       // LDA #$00
+    0x8D, 0x00, 0x18, // STA $1800
+    0x85, 0x00,       // STA $00
+    0x85, 0x01,       // STA $01
+    0xA9, 0x40,       // LDA #$40
+    0x8D, 0x0B, 0x1C, // STA $1C0B
+    0xA9, 0x00,       // LDA #$00
+    0x8D, 0x04, 0x1C, // STA $1C04
+    0xA9, 0x10,       // LDA #$10
+    0x8D, 0x05, 0x1C, // STA $1C05
+    0xA9, 0xC0,       // LDA #$C0
+    0x8D, 0x0E, 0x1C, // STA $1C0E
+    0xA9, 0x01,       // LDA #$01
+    0x8D, 0x0C, 0x18, // STA $180C
+    0xA9, 0x82,       // LDA #$82
+    0x8D, 0x0E, 0x18, // STA $180E
+    0x58,             // CLI
+    0x4C, 0x31, 0xC0, // JMP $C031
+    0x48,             // $C034 PHA
+    0xAD, 0x0D, 0x1C, // LDA $1C0D
+    0x10, 0x05,       // BPL $C03F
+    0xAD, 0x04, 0x1C, // LDA $1C04
+    0xE6, 0x00,       // INC $00
+    0xAD, 0x0D, 0x18, // LDA $180D
+    0x10, 0x0A,       // BPL $C04E
+    0xAD, 0x01, 0x18, // LDA $1801
+    0xE6, 0x01,       // INC $01
+    0xA9, 0x12,       // LDA #$12
+    0x8D, 0x00, 0x18, // STA $1800
+    0x68,             // PLA
+    0x40,             // RTI
+};
+
+static int fail(const char* message) {
+    printf("failed, %s\n", message);
+    return 1;
+}
+
+static bool startTestRom(SerialBus& bus, Drive1541& drive) {
+    uint8_t rom[0x4000] = {};
+    memcpy(rom, testProgram, sizeof(testProgram));
+    // NMI, reset and IRQ vectors
+    const uint8_t vectors[] = {0x31, 0xC0, 0x00, 0xC0, 0x34, 0xC0};
+    memcpy(rom + 0x3FFA, vectors, sizeof(vectors));
+
+    bus.devices.push_back(&drive);
+    if(!drive.loadRom(rom, sizeof(rom))) {
+        return false;
+    }
+    drive.powerOn();
+    return true;
+}
+
+static std::vector<uint8_t> getTimerState(VIA* via) {
+    std::vector<uint8_t> state;
+    StateWriter writer(state);
+    via->saveState(writer);
+    return state;
+}
+
+// skipping has to leave the timers where ticking them would, in every mode they count in
+static int runSkip() {
+    const uint8_t modes[] = {0x00, 0x40, 0x20};
+    const size_t spans[] = {1, 2, 5, 0x1001, 0x1002, 0x10000, 300001};
+    for(uint8_t mode : modes) {
+        for(size_t span : spans) {
+            VIA ticked;
+            ticked.write(VIA_AUXILIARY_CONTROL_REGISTER, mode);
+            ticked.write(VIA_TIMER_1_LOW, 0x00);
+            ticked.write(VIA_TIMER_1_HIGH, 0x10);
+            ticked.write(VIA_TIMER_2_LOW, 0x34);
+            ticked.write(VIA_TIMER_2_HIGH, 0x12);
+            VIA skipped = ticked;
+            for(size_t i = 0; i < span; i++) {
+                ticked.tick();
+            }
+            skipped.skip(span);
+            if(getTimerState(&ticked) != getTimerState(&skipped)) {
+                printf("ACR $%02X, %zu cycles\n", mode, span);
+                return fail("skipping the VIA timers does not match ticking them");
+            }
+        }
+    }
+    return 0;
+}
+
+// a drive that went idle has to wake with its VIA2 timer in the same phase as one that ran
+// all along, and keep taking the timer interrupt
+static int runIdle() {
+    SerialBus idleBus;
+    Drive1541 idle(&idleBus);
+    SerialBus busyBus;
+    Drive1541 busy(&busyBus);
+    if(!startTestRom(idleBus, idle) || !startTestRom(busyBus, busy)) {
+        return fail("the test ROM was not accepted");
+    }
+    for(size_t i = 0; i < DRIVETEST_IDLE_CYCLES; i++) {
+        idle.clock();
+        // bus activity keeps the other drive awake
+        if(i % 100000 == 0) {
+            busy.tick();
+        }
+        busy.clock();
+    }
+    if(idle.isActive() || !busy.isActive()) {
+        return fail("the drive did not go idle");
+    }
+
+    idle.tick();
+    idle.clock();
+    busy.clock();
+    // the CPUs stop at different cycles after an instruction, so the timers are compared at
+    // the cycle the woken drive is at. The interrupt flags differ until it has run its handler.
+    if(idle.cpu->cycles < busy.cpu->cycles) {
+        return fail("the woken drive is behind");
+    }
+    VIA reference = *busy.via2;
+    for(size_t i = busy.cpu->cycles; i < idle.cpu->cycles; i++) {
+        reference.tick();
+    }
+    for(uint16_t timer : {VIA_TIMER_1_HIGH, VIA_TIMER_1_LOW, VIA_TIMER_2_HIGH, VIA_TIMER_2_LOW}) {
+        if(idle.via2->read(timer) != reference.read(timer)) {
+            return fail("the VIA2 timers lost their phase while the drive was idle");
+        }
+    }
+    uint8_t timerIrqs = idle.driveBus->ram[DRIVETEST_TIMER_IRQS];
+    for(int i = 0; i < 3 * DRIVETEST_TIMER_PERIOD; i++) {
+        idle.clock();
+    }
+    if(static_cast<uint8_t>(idle.driveBus->ram[DRIVETEST_TIMER_IRQS] - timerIrqs) < 2) {
+        return fail("the timer interrupt did not resume after the drive woke");
+    }
+    printf("%llu drive instructions while idle, %llu while busy\n",
+           static_cast<unsigned long long>(idle.cpu->instructionCount),
+           static_cast<unsigned long long>(busy.cpu->instructionCount));
+    return 0;
+}
+
+static int runTestRom() {
+    SerialBus bus;
+    Drive1541 drive(&bus);
+    if(!startTestRom(bus, drive)) {
+        return fail("the test ROM was not accepted");
+    }
+    for(int i = 0; i < DRIVETEST_CYCLES; i++) {
+        drive.clock();
+    }
+
+    uint8_t timerIrqs = drive.driveBus->ram[DRIVETEST_TIMER_IRQS];
+    printf("%llu drive instructions, %d timer interrupts\n",
+           static_cast<unsigned long long>(drive.cpu->instructionCount), timerIrqs);
+    if(timerIrqs < DRIVETEST_CYCLES / DRIVETEST_TIMER_PERIOD - 1) {
+        return fail("VIA2 timer 1 did not interrupt the drive CPU");
+    }
+    if(bus.Read(false).dataLine) {
+        return fail("DATA is pulled before ATN");
+    }
+
+    // the C64 pulls ATN, the acknowledge circuit pulls DATA before DOS has answered
+    bus.CIAWrite({false, false, true});
+    if(!bus.Read(false).dataLine) {
+        return fail("the ATN acknowledge circuit does not pull DATA");
+    }
+    for(int i = 0; i < 1000; i++) {
+        drive.clock();
+    }
+    if(drive.driveBus->ram[DRIVETEST_ATN_IRQS] != 1) {
+        return fail("ATN did not interrupt the drive CPU through VIA1 CA1");
+    }
+    // released ATN, DATA stays pulled by the drive's own output
+    bus.CIAWrite({false, false, false});
+    if(!bus.Read(false).dataLine) {
+        return fail("DATA out on VIA1 port B does not reach the bus");
+    }
+    if(int result = runSkip()) {
+        return result;
+    }
+    if(int result = runIdle()) {
+        return result;
+    }
+    printf("passed\n");
+    return 0;
+}
+
+// boots a C64 with the real DOS and checks the drive came out of reset and set up its IEC port
+static int runDos(const std::string& rom, const std::string& upperRom) {
+    System system;
+    system.setRenderingEnabled(false);
+    if(!system.enableTrueDrive(rom, upperRom)) {
+        return 2;
+    }
+    system.powerOn();
+    if(!system.runUntilReady()) {
+        return fail("the C64 did not reach READY with the drive on the bus");
+    }
+    CPU* cpu = system.drive->cpu;
+    printf("%llu drive instructions, drive PC $%04X\n",
+           static_cast<unsigned long long>(cpu->instructionCount), cpu->PC);
+    if(cpu->PC < 0xC000) {
+        return fail("the drive CPU is not running DOS");
+    }
+    if(system.drive->driveBus->read(0x1802) != 0x1A) {
+        return fail("DOS did not set up the IEC port on VIA1");
+    }
+    printf("passed\n");
+    return 0;
+}
+
+// usage: drivetest, or drivetest --rom <1541 rom> [--upper <$E000 half>] to boot the real DOS
+int main(int argc, char** argv) {
+    std::string rom;
+    std::string upperRom;
+    for(int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        if(option == "--rom") {
+            rom = argv[i + 1];
+        } else if(option == "--upper") {
+            upperRom = argv[i + 1];
+        } else {
+            fprintf(stderr, "usage: %s [--rom <1541 rom> [--upper <$E000 half>]]\n", argv[0]);
+            return 2;
+        }
+    }
+    if(rom.empty()) {
+        return runTestRom();
+    }
+    return runDos(rom, upperRom);
+}
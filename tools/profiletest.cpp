@@ -0,0 +1,160 @@
+#include <cpu.hpp>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <flat_bus.hpp>
+#include <fstream>
+#include <iterator>
+#include <profiler.hpp>
+#include <string>
+#include <vector>
+
+#define PROFILETEST_STACKS "profiletest.folded"
+
+#define PROFILETEST_MAIN 0x0200
+#define PROFILETEST_END 0x0207
+#define PROFILETEST_OUTER 0x0210
+#define PROFILETEST_INNER 0x0220
+#define PROFILETEST_IRQ 0x0300
+#define PROFILETEST_HANDLER 0x0320
+
+// main calls $0210, which calls $0220 twice, then clears I and is interrupted around $0205.
+// The IRQ handler at $0300 calls $0320 and returns with RTI.
+static const uint8_t mainProgram[] = {
+    0x20, 0x10, 0x02, // $0200 JSR $0210
+    0x58,             // CLI
+    0xEA,             // NOP
+    0xEA,             // $0205 NOP, IRQ
+    0xEA,             // NOP
+    0x4C, 0x07, 0x02, // $0207 JMP $0207
+};
+static const uint8_t outerProgram[] = {
+    0x20, 0x20, 0x02, // $0210 JSR $0220
+    0x20, 0x20, 0x02, // JSR $0220
+    0x60,             // RTS
+};
+static const uint8_t innerProgram[] = {
+    0xEA, // $0220 NOP
+    0xEA, // NOP
+    0x60, // RTS
+};
+static const uint8_t irqProgram[] = {
+    0x20, 0x20, 0x03, // $0300 JSR $0320
+    0x40,             // RTI
+};
+static const uint8_t handlerProgram[] = {
+    0xEA, // $0320 NOP
+    0x60, // RTS
+};
+
+// the instruction core takes an interrupt in the three pushes and RTI in four cycles, the
+// cycle stepped core in 7 and 6 like the real CPU
+struct CoreTiming {
+    uint64_t interrupt;
+    uint64_t rti;
+};
+
+struct ExpectedRoutine {
+    uint16_t routine;
+    uint64_t calls;
+    uint64_t exclusive;
+    uint64_t inclusive;
+};
+
+static int fail(const char* message) {
+    printf("failed, %s\n", message);
+    return 1;
+}
+
+static int runTest(bool cycleStepped) {
+    const CoreTiming timing = cycleStepped ? CoreTiming{7, 6} : CoreTiming{3, 4};
+    const uint64_t irqExclusive = timing.interrupt + 6 + timing.rti;
+    // most inclusive first, the order getRoutines sorts them in
+    const ExpectedRoutine expectedRoutines[] = {
+        // JSR 6 twice and RTS 6
+        {PROFILETEST_OUTER, 1, 18, 38},
+        // the interrupt, JSR 6 and RTI
+        {PROFILETEST_IRQ, 1, irqExclusive, irqExclusive + 8},
+        // NOP 2 twice and RTS 6 per call
+        {PROFILETEST_INNER, 2, 20, 20},
+        // NOP 2 and RTS 6
+        {PROFILETEST_HANDLER, 1, 8, 8},
+    };
+    // main spends JSR 6, CLI 2 and three NOPs
+    const std::string expectedStacks = "main 14\n"
+                                       "main;$0210 18\n"
+                                       "main;$0210;$0220 20\n"
+                                       "IRQ;$0300 " + std::to_string(irqExclusive) + "\n"
+                                       "IRQ;$0300;$0320 8\n";
+
+    FlatBus bus;
+    memcpy(bus.ram + PROFILETEST_MAIN, mainProgram, sizeof(mainProgram));
+    memcpy(bus.ram + PROFILETEST_OUTER, outerProgram, sizeof(outerProgram));
+    memcpy(bus.ram + PROFILETEST_INNER, innerProgram, sizeof(innerProgram));
+    memcpy(bus.ram + PROFILETEST_IRQ, irqProgram, sizeof(irqProgram));
+    memcpy(bus.ram + PROFILETEST_HANDLER, handlerProgram, sizeof(handlerProgram));
+    bus.ram[0xFFFC] = PROFILETEST_MAIN & 0xFF;
+    bus.ram[0xFFFD] = PROFILETEST_MAIN >> 8;
+    bus.ram[0xFFFE] = PROFILETEST_IRQ & 0xFF;
+    bus.ram[0xFFFF] = PROFILETEST_IRQ >> 8;
+
+    CPUCore<FlatBus> cpu(&bus);
+    cpu.setCycleStepped(cycleStepped);
+    cpu.powerOn();
+    Profiler profiler;
+    cpu.setProfiler(&profiler);
+    // IRQ is held from $0205 until the CPU takes it
+    bool irq = false;
+    for(int i = 0; i < 100 && cpu.PC != PROFILETEST_END; i++) {
+        irq = (irq || cpu.PC == 0x0205) && !cpu.irqCount;
+        cpu.setIRQ(1, irq);
+        cpu.executeOnce();
+    }
+    if(cpu.PC != PROFILETEST_END || cpu.irqCount != 1) {
+        return fail("the program did not run through the interrupt");
+    }
+
+    std::vector<ProfileRoutine> routines = profiler.getRoutines();
+    const size_t count = sizeof(expectedRoutines) / sizeof(expectedRoutines[0]);
+    if(routines.size() != count) {
+        return fail("wrong number of routines");
+    }
+    for(size_t i = 0; i < count; i++) {
+        const ProfileRoutine& routine = routines[i];
+        const ExpectedRoutine& expected = expectedRoutines[i];
+        printf("$%04X %llu calls, %llu exclusive, %llu inclusive\n", routine.routine,
+               static_cast<unsigned long long>(routine.calls),
+               static_cast<unsigned long long>(routine.exclusive),
+               static_cast<unsigned long long>(routine.inclusive));
+        if(routine.routine != expected.routine || routine.calls != expected.calls ||
+           routine.exclusive != expected.exclusive || routine.inclusive != expected.inclusive) {
+            return fail("the routine cycles are off");
+        }
+    }
+    if(profiler.getInterruptCycles() != expectedRoutines[1].inclusive) {
+        return fail("the interrupt cycles are off");
+    }
+    if(profiler.getCycles(PROFILETEST_INNER) != 4) {
+        return fail("the cycles per PC are off");
+    }
+
+    if(!profiler.writeCollapsedStacks(PROFILETEST_STACKS)) {
+        return fail("could not write the collapsed stacks");
+    }
+    std::ifstream file(PROFILETEST_STACKS);
+    std::string stacks((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if(stacks != expectedStacks) {
+        printf("%s", stacks.c_str());
+        return fail("the collapsed stacks are off");
+    }
+    printf("passed\n");
+    return 0;
+}
+
+// usage: profiletest [--cycle-stepped], runs in the current directory and removes its file again
+int main(int argc, char** argv) {
+    bool cycleStepped = argc > 1 && std::string(argv[1]) == "--cycle-stepped";
+    int result = runTest(cycleStepped);
+    std::filesystem::remove(PROFILETEST_STACKS);
+    return result;
+}
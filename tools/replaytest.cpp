@@ -0,0 +1,172 @@
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <replay.hpp>
+#include <string>
+#include <system.hpp>
+#include <vector>
+
+#define REPLAYTEST_CRT "replaytest.crt"
+#define REPLAYTEST_DRIVE "replaytest_drive"
+#define REPLAYTEST_REPLAY "replaytest.c64r"
+
+#define REPLAYTEST_FRAME_CYCLES (312 * 63)
+// short so several keyframes are taken after the cartridge goes in
+#define REPLAYTEST_KEYFRAME_FRAMES 10
+#define REPLAYTEST_FRAMES_BEFORE 15
+#define REPLAYTEST_FRAMES_AFTER 50
+
+// an 8K cartridge that starts from CBM80 and counts in $02/$03, showing it in the border
+static const uint8_t cartridgeProgram[] = {
+    0x09, 0x80,                   // cold start $8009
+    0x09, 0x80,                   // warm start $8009
+    0xC3, 0xC2, 0xCD, 0x38, 0x30, // CBM80
+    0xE6, 0x02,                   // $8009 INC $02
+    0xD0, 0x02,                   // BNE $800F
+    0xE6, 0x03,                   // INC $03
+    0xA5, 0x02,                   // $800F LDA $02
+    0x8D, 0x20, 0xD0,             // STA $D020
+    0x4C, 0x09, 0x80,             // JMP $8009
+};
+
+static void writeLong(std::vector<uint8_t>& data, size_t offset, uint32_t value) {
+    data[offset] = value >> 24;
+    data[offset + 1] = value >> 16;
+    data[offset + 2] = value >> 8;
+    data[offset + 3] = value;
+}
+
+static bool writeCartridge(uint8_t fill) {
+    std::vector<uint8_t> crt(0x40 + CRT_CHIP_HEADER_LENGTH + CARTRIDGE_BANK_SIZE, fill);
+    memcpy(crt.data(), CRT_HEADER_SIGNATURE, 16);
+    writeLong(crt, 0x10, 0x40);
+    // version 1.0, normal cartridge, EXROM low and GAME high for 8K at $8000
+    crt[0x14] = 0x01;
+    crt[0x15] = 0x00;
+    crt[0x16] = 0x00;
+    crt[0x17] = CRT_NORMAL;
+    crt[0x18] = 0;
+    crt[0x19] = 1;
+    memset(crt.data() + 0x1A, 0, 0x40 - 0x1A);
+
+    uint8_t* chip = crt.data() + 0x40;
+    memcpy(chip, CRT_CHIP_SIGNATURE, 4);
+    writeLong(crt, 0x44, CRT_CHIP_HEADER_LENGTH + CARTRIDGE_BANK_SIZE);
+    // ROM, bank 0, at $8000, 8K
+    const uint8_t chipHeader[] = {0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x20, 0x00};
+    memcpy(chip + 8, chipHeader, sizeof(chipHeader));
+    memcpy(chip + CRT_CHIP_HEADER_LENGTH, cartridgeProgram, sizeof(cartridgeProgram));
+
+    std::ofstream file(REPLAYTEST_CRT, std::ios::binary | std::ios::out | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(crt.data()), crt.size());
+    return file.good();
+}
+
+static void run(System& system, ReplayRecorder& recorder, size_t frames) {
+    size_t end = system.cpu->cycles + frames * REPLAYTEST_FRAME_CYCLES;
+    while(system.cpu->cycles < end) {
+        recorder.update();
+        system.cpu->executeOnce();
+    }
+}
+
+static int fail(const char* message) {
+    printf("failed, %s\n", message);
+    return 1;
+}
+
+// records a session that enables a virtual drive and inserts a cartridge, then seeks the
+// replay to keyframes after and before the insertion on another machine
+static int runTest() {
+    if(!writeCartridge(0xFF)) {
+        return fail("could not write the cartridge");
+    }
+    std::filesystem::create_directories(REPLAYTEST_DRIVE);
+
+    std::vector<uint8_t> expected;
+    {
+        System recording;
+        recording.setRenderingEnabled(false);
+        recording.powerOn();
+        if(!recording.runUntilReady()) {
+            return fail("the C64 did not reach READY");
+        }
+        ReplayRecorder recorder(&recording, REPLAYTEST_KEYFRAME_FRAMES);
+        run(recording, recorder, REPLAYTEST_FRAMES_BEFORE);
+        if(!recording.enableVirtualDrive(REPLAYTEST_DRIVE) ||
+           !recording.insertCartridge(REPLAYTEST_CRT)) {
+            return fail("could not put the media in");
+        }
+        run(recording, recorder, REPLAYTEST_FRAMES_AFTER);
+        if(recording.bus->ram[0x03] == 0) {
+            return fail("the cartridge did not start");
+        }
+        if(!recorder.save(REPLAYTEST_REPLAY)) {
+            return fail("could not save the replay");
+        }
+        recording.saveState(expected);
+    }
+
+    Replay replay;
+    if(!replay.load(REPLAYTEST_REPLAY)) {
+        return fail("could not load the replay");
+    }
+    const ReplayKeyframe& last = replay.keyframes.back();
+    if(last.nextEvent == 0 || replay.keyframes.front().nextEvent != 0) {
+        return fail("no keyframe after the media events");
+    }
+    printf("%zu keyframes, %zu events\n", replay.keyframes.size(), replay.events.size());
+
+    std::vector<uint8_t> state;
+    {
+        System playback;
+        playback.setRenderingEnabled(false);
+        ReplayPlayer player(&playback, replay);
+        if(!player.seek(replay.endCycle)) {
+            return fail("seeking past a keyframe after the cartridge went in");
+        }
+        playback.saveState(state);
+        if(state != expected || !playback.virtualDrive) {
+            return fail("the replay ended on a different machine");
+        }
+
+        if(!player.seek(replay.keyframes.front().cycle + 1)) {
+            return fail("seeking back before the cartridge went in");
+        }
+        if(playback.bus->cartridge || playback.virtualDrive) {
+            return fail("the media stayed in when seeking back");
+        }
+        if(!player.seek(replay.endCycle)) {
+            return fail("seeking forward again");
+        }
+        playback.saveState(state);
+        if(state != expected) {
+            return fail("the replay ended on a different machine the second time");
+        }
+    }
+
+    // the replay has to notice when the cartridge is not the one it was recorded with
+    if(!writeCartridge(0xEA)) {
+        return fail("could not write the cartridge");
+    }
+    {
+        System playback;
+        playback.setRenderingEnabled(false);
+        ReplayPlayer player(&playback, replay);
+        if(player.seek(replay.endCycle)) {
+            return fail("a changed cartridge was not caught");
+        }
+    }
+    printf("passed\n");
+    return 0;
+}
+
+// usage: replaytest, runs in the current directory and removes its files again
+int main() {
+    int result = runTest();
+    std::filesystem::remove(REPLAYTEST_CRT);
+    std::filesystem::remove(REPLAYTEST_REPLAY);
+    std::filesystem::remove_all(REPLAYTEST_DRIVE);
+    return result;
+}
@@ -0,0 +1,229 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <lz4.hpp>
+#include <rewind.hpp>
+#include <string>
+#include <system.hpp>
+#include <vector>
+
+// short keyframe intervals so stepping back crosses several keyframes
+#define REWINDTEST_KEYFRAME_FRAMES 8
+#define REWINDTEST_FRAMES 30
+#define REWINDTEST_STEPS 20
+// the frame the text goes into the keyboard queue, which changes the snapshot size
+#define REWINDTEST_TYPE_FRAME 12
+#define REWINDTEST_CAPACITY 16
+// frames run with the default intervals to check the memory a minute of rewind takes
+#define REWINDTEST_SIZE_FRAMES 500
+#define REWINDTEST_MINUTE_BYTES (8 * 1024 * 1024)
+
+static int fail(const char* message) {
+    printf("failed, %s\n", message);
+    return 1;
+}
+
+static bool roundTrip(const std::vector<uint8_t>& input, size_t* compressedSize = nullptr) {
+    std::vector<uint8_t> compressed;
+    lz4::compress(input.data(), input.size(), compressed);
+    std::vector<uint8_t> output(input.size());
+    if(!lz4::decompress(compressed.data(), compressed.size(), output.data(), output.size())) {
+        return false;
+    }
+    if(compressedSize) {
+        *compressedSize = compressed.size();
+    }
+    return output == input;
+}
+
+static bool rejects(const std::vector<uint8_t>& block, size_t size) {
+    std::vector<uint8_t> output(size + 1);
+    return !lz4::decompress(block.data(), block.size(), output.data(), size);
+}
+
+static int testLz4() {
+    std::vector<uint8_t> data(70000);
+    uint32_t seed = 1;
+    for(uint8_t& byte : data) {
+        seed = seed * 1103515245 + 12345;
+        byte = seed >> 16;
+    }
+    if(!roundTrip(data) || !roundTrip({}) || !roundTrip({1, 2, 3})) {
+        return fail("random and short blocks do not round trip");
+    }
+
+    // runs of one byte and of short patterns are matches that overlap the bytes they write,
+    // a long run of literals needs extra length bytes
+    std::vector<uint8_t> overlapping(20000, 0);
+    for(size_t i = 5000; i < 10000; i++) {
+        overlapping[i] = "abc"[i % 3];
+    }
+    for(size_t i = 10000; i < 15000; i++) {
+        overlapping[i] = "abcdefgh"[i % 8] ^ (i / 8 % 2);
+    }
+    std::copy(data.begin(), data.begin() + 1000, overlapping.begin() + 19000);
+    size_t compressedSize;
+    if(!roundTrip(overlapping, &compressedSize)) {
+        return fail("overlapping matches do not round trip");
+    }
+    if(compressedSize > 2000) {
+        return fail("runs do not compress");
+    }
+
+    std::vector<uint8_t> block;
+    std::vector<uint8_t> zeros(1000, 0);
+    lz4::compress(zeros.data(), zeros.size(), block);
+    // the first sequence is one literal and a match at offset 1
+    if(block.size() < 4 || block[2] != 1 || block[3] != 0) {
+        return fail("unexpected block for a run of zeros");
+    }
+    std::vector<uint8_t> badOffset = block;
+    badOffset[2] = 0;
+    std::vector<uint8_t> farOffset = block;
+    farOffset[2] = 2;
+    std::vector<uint8_t> truncated(block.begin(), block.begin() + 3);
+    std::vector<uint8_t> endless = {0xF0, 255, 255};
+    if(!rejects(badOffset, zeros.size()) || !rejects(farOffset, zeros.size()) ||
+       !rejects(truncated, zeros.size()) || !rejects(block, zeros.size() - 1) ||
+       !rejects(block, zeros.size() + 1) || !rejects(endless, zeros.size())) {
+        return fail("a corrupt block was accepted");
+    }
+    printf("lz4 passed, %zu bytes of runs in %zu\n", overlapping.size(), compressedSize);
+    return 0;
+}
+
+static bool ready(System& system) {
+    system.setRenderingEnabled(false);
+    system.powerOn();
+    return system.runUntilReady();
+}
+
+// runs frames while the buffer captures them, keeping the snapshot of every frame it takes
+static void run(System& system, RewindBuffer* rewind, size_t frames,
+                std::vector<std::vector<uint8_t>>* snapshots) {
+    uint32_t end = system.vic->frameCount + frames;
+    uint32_t frame = system.vic->frameCount;
+    while(system.vic->frameCount != end) {
+        if(rewind) {
+            rewind->update();
+        }
+        if(snapshots && system.vic->frameCount != frame) {
+            frame = system.vic->frameCount;
+            snapshots->emplace_back();
+            system.saveState(snapshots->back());
+            if(snapshots->size() == REWINDTEST_TYPE_FRAME) {
+                system.input->writeString("PRINT 1\n");
+            }
+        }
+        system.cpu->executeOnce();
+    }
+}
+
+static int testStepBack() {
+    System system;
+    if(!ready(system)) {
+        return fail("the C64 did not reach READY");
+    }
+    RewindBuffer rewind(&system, REWIND_FRAMES, REWINDTEST_KEYFRAME_FRAMES);
+    std::vector<std::vector<uint8_t>> snapshots;
+    run(system, &rewind, REWINDTEST_FRAMES, &snapshots);
+    if(rewind.getFrameCount() != snapshots.size()) {
+        return fail("the buffer did not capture every frame");
+    }
+
+    std::vector<uint8_t> state;
+    for(size_t i = 1; i <= REWINDTEST_STEPS; i++) {
+        if(!rewind.stepBack()) {
+            return fail("could not step back");
+        }
+        system.saveState(state);
+        if(state != snapshots[snapshots.size() - i]) {
+            printf("step %zu\n", i);
+            return fail("stepping back did not restore the snapshot of that frame");
+        }
+    }
+
+    // the machine runs on from the restored frame the way it did the first time
+    size_t frame = snapshots.size() - REWINDTEST_STEPS;
+    run(system, &rewind, 1, nullptr);
+    system.saveState(state);
+    if(state != snapshots[frame + 1]) {
+        return fail("the machine did not run on the same way after stepping back");
+    }
+
+    while(rewind.stepBack()) {
+    }
+    system.saveState(state);
+    if(state != snapshots.front()) {
+        return fail("stepping back to the oldest frame");
+    }
+    printf("step back passed, %zu frames\n", snapshots.size());
+    return 0;
+}
+
+static int testCapacity() {
+    System system;
+    if(!ready(system)) {
+        return fail("the C64 did not reach READY");
+    }
+    RewindBuffer rewind(&system, REWINDTEST_CAPACITY, REWINDTEST_KEYFRAME_FRAMES);
+    std::vector<std::vector<uint8_t>> snapshots;
+    run(system, &rewind, REWINDTEST_FRAMES, &snapshots);
+    // the oldest frames go a keyframe interval at a time
+    size_t kept = rewind.getFrameCount();
+    if(kept > REWINDTEST_CAPACITY || kept <= REWINDTEST_CAPACITY - REWINDTEST_KEYFRAME_FRAMES) {
+        return fail("the buffer holds the wrong number of frames");
+    }
+    std::vector<uint8_t> state;
+    for(size_t i = 0; i < kept; i++) {
+        if(!rewind.stepBack()) {
+            return fail("could not step back through the kept frames");
+        }
+    }
+    system.saveState(state);
+    if(rewind.stepBack() || state != snapshots[snapshots.size() - kept]) {
+        return fail("the oldest kept frame is wrong");
+    }
+    printf("capacity passed, %zu of %zu frames kept\n", kept, snapshots.size());
+    return 0;
+}
+
+// the memory a minute takes at the default intervals, from a stretch at the READY prompt
+static int testSize() {
+    System system;
+    if(!ready(system)) {
+        return fail("the C64 did not reach READY");
+    }
+    auto start = std::chrono::steady_clock::now();
+    run(system, nullptr, REWINDTEST_SIZE_FRAMES, nullptr);
+    std::chrono::duration<double> plain = std::chrono::steady_clock::now() - start;
+    RewindBuffer rewind(&system);
+    start = std::chrono::steady_clock::now();
+    run(system, &rewind, REWINDTEST_SIZE_FRAMES, nullptr);
+    std::chrono::duration<double> capturing = std::chrono::steady_clock::now() - start;
+
+    // timing is only reported, it depends too much on the host to check
+    size_t minute = rewind.getMemoryUsage() * REWIND_FRAMES / rewind.getFrameCount();
+    printf("%zu bytes for %zu frames, %zu KB for a minute, capturing adds %.3f ms per frame\n",
+           rewind.getMemoryUsage(), rewind.getFrameCount(), minute / 1024,
+           (capturing - plain).count() * 1000 / REWINDTEST_SIZE_FRAMES);
+    if(minute > REWINDTEST_MINUTE_BYTES) {
+        return fail("a minute of rewind takes too much memory");
+    }
+    printf("size passed\n");
+    return 0;
+}
+
+// usage: rewindtest
+int main() {
+    if(int result = testLz4()) {
+        return result;
+    }
+    if(int result = testStepBack()) {
+        return result;
+    }
+    if(int result = testCapacity()) {
+        return result;
+    }
+    return testSize();
+}
@@ -0,0 +1,453 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cpu.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mapped_file.hpp>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// failing cases printed per opcode
+#define FAILURES_SHOWN 2
+
+struct BusAccess {
+    uint16_t addr;
+    uint8_t value;
+    bool write;
+
+    bool operator==(const BusAccess& other) const {
+        return addr == other.addr && value == other.value && write == other.write;
+    }
+};
+
+struct CpuState {
+    uint16_t pc = 0;
+    uint8_t s = 0;
+    uint8_t a = 0;
+    uint8_t x = 0;
+    uint8_t y = 0;
+    uint8_t p = 0;
+    std::vector<std::pair<uint16_t, uint8_t>> ram;
+};
+
+struct TestCase {
+    std::string name;
+    CpuState initial;
+    CpuState final;
+    std::vector<BusAccess> cycles;
+};
+
+struct OpcodeResult {
+    bool found = false;
+    size_t cases = 0;
+    // wrong registers or memory afterwards, including exceptions from unknown opcodes
+    size_t stateFailures = 0;
+    size_t cycleFailures = 0;
+    // right number of cycles but different accesses, dummy reads and writes mostly
+    size_t busFailures = 0;
+    std::vector<std::string> failures;
+};
+
+// flat RAM that records every access in order
+class RecordingBus final : public Bus {
+public:
+    void write(uint16_t addr, uint8_t data) override {
+        ram[addr] = data;
+        accesses.push_back({addr, data, true});
+    }
+    uint8_t read(uint16_t addr) override {
+        accesses.push_back({addr, ram[addr], false});
+        return ram[addr];
+    }
+    uint8_t peek(uint16_t addr) override { return ram[addr]; }
+
+    uint8_t ram[0x10000] = {};
+    std::vector<BusAccess> accesses;
+};
+
+// Reads the test vector files, an array of cases with "name", "initial", "final" and
+// "cycles", and skips anything else.
+class JsonReader {
+public:
+    JsonReader(const uint8_t* data, size_t size) : position(data), end(data + size) {}
+
+    bool readCases(std::vector<TestCase>& cases) {
+        try {
+            expect('[');
+            if(!consume(']')) {
+                do {
+                    cases.emplace_back();
+                    readCase(cases.back());
+                } while(consume(','));
+                expect(']');
+            }
+            return true;
+        } catch(const std::runtime_error& error) {
+            fprintf(stderr, "%s\n", error.what());
+            return false;
+        }
+    }
+
+private:
+    void readCase(TestCase& test) {
+        expect('{');
+        do {
+            std::string key = readString();
+            expect(':');
+            if(key == "name") {
+                test.name = readString();
+            } else if(key == "initial") {
+                readState(test.initial);
+            } else if(key == "final") {
+                readState(test.final);
+            } else if(key == "cycles") {
+                expect('[');
+                if(!consume(']')) {
+                    do {
+                        expect('[');
+                        BusAccess access;
+                        access.addr = readNumber();
+                        expect(',');
+                        access.value = readNumber();
+                        expect(',');
+                        access.write = readString() == "write";
+                        expect(']');
+                        test.cycles.push_back(access);
+                    } while(consume(','));
+                    expect(']');
+                }
+            } else {
+                skipValue();
+            }
+        } while(consume(','));
+        expect('}');
+    }
+
+    void readState(CpuState& state) {
+        expect('{');
+        do {
+            std::string key = readString();
+            expect(':');
+            if(key == "pc") state.pc = readNumber();
+            else if(key == "s") state.s = readNumber();
+            else if(key == "a") state.a = readNumber();
+            else if(key == "x") state.x = readNumber();
+            else if(key == "y") state.y = readNumber();
+            else if(key == "p") state.p = readNumber();
+            else if(key == "ram") {
+                expect('[');
+                if(!consume(']')) {
+                    do {
+                        expect('[');
+                        uint16_t addr = readNumber();
+                        expect(',');
+                        uint8_t value = readNumber();
+                        expect(']');
+                        state.ram.push_back({addr, value});
+                    } while(consume(','));
+                    expect(']');
+                }
+            } else {
+                skipValue();
+            }
+        } while(consume(','));
+        expect('}');
+    }
+
+    void skipWhitespace() {
+        while(position < end && (*position == ' ' || *position == '\n' || *position == '\r' ||
+                                 *position == '\t')) {
+            position++;
+        }
+    }
+
+    bool consume(char c) {
+        skipWhitespace();
+        if(position < end && *position == c) {
+            position++;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(char c) {
+        if(!consume(c)) {
+            throw std::runtime_error(std::string("JSON: expected ") + c);
+        }
+    }
+
+    std::string readString() {
+        expect('"');
+        std::string value;
+        while(position < end && *position != '"') {
+            if(*position == '\\' && position + 1 < end) {
+                position++;
+            }
+            value += *position++;
+        }
+        expect('"');
+        return value;
+    }
+
+    uint32_t readNumber() {
+        skipWhitespace();
+        if(position == end || *position < '0' || *position > '9') {
+            throw std::runtime_error("JSON: expected a number");
+        }
+        uint32_t value = 0;
+        while(position < end && *position >= '0' && *position <= '9') {
+            value = value * 10 + (*position++ - '0');
+        }
+        return value;
+    }
+
+    void skipValue() {
+        skipWhitespace();
+        if(position == end) {
+            throw std::runtime_error("JSON: unexpected end");
+        }
+        if(*position == '"') {
+            readString();
+        } else if(*position == '[' || *position == '{') {
+            char close = *position == '[' ? ']' : '}';
+            position++;
+            if(!consume(close)) {
+                do {
+                    if(close == '}') {
+                        readString();
+                        expect(':');
+                    }
+                    skipValue();
+                } while(consume(','));
+                expect(close);
+            }
+        } else {
+            // numbers, true, false and null
+            while(position < end && *position != ',' && *position != ']' && *position != '}') {
+                position++;
+            }
+        }
+    }
+
+    const uint8_t* position;
+    const uint8_t* end;
+};
+
+static std::string describe(const char* what, const TestCase& test, uint32_t expected,
+                            uint32_t actual) {
+    char line[128];
+    snprintf(line, sizeof(line), "\"%s\": %s expected %u, got %u", test.name.c_str(), what,
+             expected, actual);
+    return line;
+}
+
+// false when the CPU threw, which it does for every case of an opcode it does not know
+static bool runCase(CPU& cpu, RecordingBus& bus, const TestCase& test, OpcodeResult& result) {
+    for(const auto& [addr, value] : test.initial.ram) {
+        bus.ram[addr] = value;
+    }
+    cpu.PC = test.initial.pc;
+    cpu.SP = test.initial.s;
+    cpu.A = test.initial.a;
+    cpu.X = test.initial.x;
+    cpu.Y = test.initial.y;
+    cpu.P = test.initial.p;
+    bus.accesses.clear();
+    size_t start = cpu.cycles;
+
+    try {
+        cpu.executeOnce();
+    } catch(const std::exception& error) {
+        result.failures.push_back("\"" + test.name + "\": " + error.what());
+        return false;
+    }
+
+    const CpuState& final = test.final;
+    std::string failure;
+    if(cpu.PC != final.pc) failure = describe("PC", test, final.pc, cpu.PC);
+        else if(cpu.SP != final.s) failure = describe("S", test, final.s, cpu.SP);
+        else if(cpu.A != final.a) failure = describe("A", test, final.a, cpu.A);
+        else if(cpu.X != final.x) failure = describe("X", test, final.x, cpu.X);
+        else if(cpu.Y != final.y) failure = describe("Y", test, final.y, cpu.Y);
+    else if(cpu.P != final.p) failure = describe("P", test, final.p, cpu.P);
+    for(const auto& [addr, value] : final.ram) {
+        if(failure.empty() && bus.ram[addr] != value) {
+            char what[16];
+            snprintf(what, sizeof(what), "$%04X", addr);
+            failure = describe(what, test, value, bus.ram[addr]);
+        }
+    }
+
+    if(!failure.empty()) {
+        result.stateFailures++;
+    } else if(cpu.cycles - start != test.cycles.size()) {
+        result.cycleFailures++;
+        failure = describe("cycles", test, test.cycles.size(), cpu.cycles - start);
+    } else if(bus.accesses != test.cycles) {
+        result.busFailures++;
+        size_t cycle = std::mismatch(bus.accesses.begin(), bus.accesses.end(),
+                                     test.cycles.begin()).first - bus.accesses.begin();
+        const BusAccess& expected = test.cycles[cycle];
+        const BusAccess& actual = bus.accesses[cycle];
+        char line[160];
+        snprintf(line, sizeof(line),
+                 "\"%s\": cycle %zu expected %s $%04X=$%02X, got %s $%04X=$%02X",
+                 test.name.c_str(), cycle + 1, expected.write ? "write" : "read", expected.addr,
+                 expected.value, actual.write ? "write" : "read", actual.addr, actual.value);
+        failure = line;
+    }
+    if(!failure.empty() && result.failures.size() < FAILURES_SHOWN) {
+        result.failures.push_back(failure);
+    }
+
+    // the next case must not see this one's memory
+    for(const auto& [addr, value] : final.ram) {
+        bus.ram[addr] = 0;
+    }
+    for(const auto& [addr, value] : test.initial.ram) {
+        bus.ram[addr] = 0;
+    }
+    return true;
+}
+
+static void runOpcode(const std::string& directory, int opcode, bool cycleStepped,
+                      OpcodeResult& result) {
+    char name[8];
+    snprintf(name, sizeof(name), "%02x.json", opcode);
+    // opcodes without a file are left out
+    std::string path = directory + "/" + name;
+    if(!std::ifstream(path).good()) {
+        return;
+    }
+    MappedFile file;
+    if(!file.open(path)) {
+        return;
+    }
+    std::vector<TestCase> cases;
+    JsonReader reader(file.data(), file.size());
+    if(!reader.readCases(cases)) {
+        result.found = true;
+        result.stateFailures = 1;
+        result.failures.push_back(std::string(name) + " is not a test vector file");
+        return;
+    }
+    result.found = true;
+
+    RecordingBus* bus = new RecordingBus();
+    CPU* cpu = new CPUCore<Bus>(bus);
+    cpu->setCycleStepped(cycleStepped);
+    result.cases = cases.size();
+    for(const TestCase& test : cases) {
+        if(!runCase(*cpu, *bus, test, result)) {
+            result.stateFailures = cases.size();
+            break;
+        }
+    }
+    delete cpu;
+    delete bus;
+}
+
+static int usage(const char* program) {
+    fprintf(stderr, "usage: %s <directory> [--jobs <n>] [--bus] [--cycle-stepped] [opcode ...]\n", program);
+    return 2;
+}
+
+// usage: singlestep <directory of 00.json to ff.json> [--jobs n] [--bus] [--cycle-stepped]
+// [opcode ...], opcodes in hex. Registers and memory have to match. The cycle count has to
+// match too with --cycle-stepped, the instruction core is off on some opcodes like BRK, RTI
+// and read-modify-write, and with --bus the order and values of the bus accesses as well.
+int main(int argc, char** argv) {
+    if(argc < 2) {
+        return usage(argv[0]);
+    }
+    std::string directory = argv[1];
+    unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+    bool checkBus = false;
+    bool cycleStepped = false;
+    std::vector<int> opcodes;
+    for(int i = 2; i < argc; i++) {
+        if(strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            jobs = std::max(1, atoi(argv[++i]));
+        } else if(strcmp(argv[i], "--bus") == 0) {
+            checkBus = true;
+        } else if(strcmp(argv[i], "--cycle-stepped") == 0) {
+            cycleStepped = true;
+        } else if(argv[i][0] != '-') {
+            opcodes.push_back(strtoul(argv[i], nullptr, 16) & 0xFF);
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    bool checkCycles = cycleStepped || checkBus;
+    if(opcodes.empty()) {
+        for(int opcode = 0; opcode < 256; opcode++) {
+            opcodes.push_back(opcode);
+        }
+    }
+
+    // each worker takes the next opcode, a file of cases is the unit of work
+    std::vector<OpcodeResult> results(opcodes.size());
+    std::atomic<size_t> next(0);
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for(unsigned i = 0; i < jobs; i++) {
+        workers.emplace_back([&]() {
+            for(size_t index = next++; index < opcodes.size(); index = next++) {
+                runOpcode(directory, opcodes[index], cycleStepped, results[index]);
+            }
+        });
+    }
+    for(std::thread& worker : workers) {
+        worker.join();
+    }
+    double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    size_t files = 0;
+    size_t cases = 0;
+    size_t failedOpcodes = 0;
+    size_t stateFailures = 0;
+    size_t cycleFailures = 0;
+    size_t busFailures = 0;
+    for(size_t i = 0; i < opcodes.size(); i++) {
+        const OpcodeResult& result = results[i];
+        if(!result.found) {
+            continue;
+        }
+        files++;
+        cases += result.cases;
+        stateFailures += result.stateFailures;
+        cycleFailures += result.cycleFailures;
+        busFailures += result.busFailures;
+        bool failed = result.stateFailures || (checkCycles && result.cycleFailures) ||
+                      (checkBus && result.busFailures);
+        if(!failed) {
+            continue;
+        }
+        failedOpcodes++;
+        printf("%02X %-3s %zu cases: %zu state, %zu cycle count, %zu bus pattern failures\n",
+               opcodes[i], CPU::getInstructionName(opcodes[i]), result.cases,
+               result.stateFailures, result.cycleFailures, result.busFailures);
+        for(const std::string& failure : result.failures) {
+            printf("    %s\n", failure.c_str());
+        }
+    }
+    if(files == 0) {
+        fprintf(stderr, "No test vector files in %s\n", directory.c_str());
+        return 2;
+    }
+
+    printf("%zu opcodes, %zu cases in %.2f s on %u threads, %.0f cases/s\n", files, cases,
+           seconds, jobs, cases / seconds);
+    const char* required = checkBus      ? ""
+                           : checkCycles ? " (bus patterns not required)"
+                                         : " (cycle counts and bus patterns not required)";
+    printf("%zu opcodes failed: %zu state, %zu cycle count, %zu bus pattern failures%s\n",
+           failedOpcodes, stateFailures, cycleFailures, busFailures, required);
+    return failedOpcodes ? 1 : 0;
+}
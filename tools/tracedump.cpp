@@ -0,0 +1,102 @@
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <trace.hpp>
+
+// lines printed before the first difference of two traces
+#define DIFF_CONTEXT 8
+
+static std::string format(const TraceReader& reader, const TraceRecord& record) {
+    char bytes[12];
+    uint8_t length = reader.getOperandLength(record.opcode);
+    if(length == 0) {
+        snprintf(bytes, sizeof(bytes), "%02X      ", record.opcode);
+    } else if(length == 1) {
+        snprintf(bytes, sizeof(bytes), "%02X %02X   ", record.opcode, record.operands[0]);
+    } else {
+        snprintf(bytes, sizeof(bytes), "%02X %02X %02X", record.opcode, record.operands[0],
+                 record.operands[1]);
+    }
+
+    char line[96];
+    snprintf(line, sizeof(line), "%12" PRIu64 "  %04X  %s  %.3s  A:%02X X:%02X Y:%02X SP:%02X P:%02X",
+             record.cycle, record.pc, bytes, reader.getName(record.opcode), record.a, record.x,
+             record.y, record.sp, record.p);
+    return line;
+}
+
+static bool equal(const TraceRecord& a, const TraceRecord& b) {
+    return a.cycle == b.cycle && a.pc == b.pc && a.opcode == b.opcode &&
+           a.operands[0] == b.operands[0] && a.operands[1] == b.operands[1] && a.a == b.a &&
+           a.x == b.x && a.y == b.y && a.sp == b.sp && a.p == b.p;
+}
+
+static int dump(const char* path, uint16_t from, uint16_t to) {
+    TraceReader reader;
+    if(!reader.open(path)) {
+        return 1;
+    }
+    TraceRecord record;
+    while(reader.next(record)) {
+        if(record.pc >= from && record.pc <= to) {
+            puts(format(reader, record).c_str());
+        }
+    }
+    return 0;
+}
+
+static int diff(const char* pathA, const char* pathB) {
+    TraceReader readerA;
+    TraceReader readerB;
+    if(!readerA.open(pathA) || !readerB.open(pathB)) {
+        return 2;
+    }
+
+    std::deque<std::string> context;
+    TraceRecord a;
+    TraceRecord b;
+    bool hasA;
+    bool hasB;
+    size_t index = 0;
+    while(true) {
+        hasA = readerA.next(a);
+        hasB = readerB.next(b);
+        if(!hasA && !hasB) {
+            printf("traces are identical, %zu instructions\n", index);
+            return 0;
+        }
+        if(hasA != hasB || !equal(a, b)) {
+            break;
+        }
+        context.push_back(format(readerA, a));
+        if(context.size() > DIFF_CONTEXT) {
+            context.pop_front();
+        }
+        index++;
+    }
+
+    printf("traces differ at instruction %zu\n", index);
+    for(const std::string& line : context) {
+        printf("  %s\n", line.c_str());
+    }
+    printf("- %s\n", hasA ? format(readerA, a).c_str() : "end of trace");
+    printf("+ %s\n", hasB ? format(readerB, b).c_str() : "end of trace");
+    return 1;
+}
+
+// usage: tracedump <trace> [first PC] [last PC], PCs in hex, or tracedump --diff <a> <b>
+int main(int argc, char** argv) {
+    if(argc == 4 && strcmp(argv[1], "--diff") == 0) {
+        return diff(argv[2], argv[3]);
+    }
+    if(argc < 2 || argc == 3 || argc > 4) {
+        fprintf(stderr, "usage: %s <trace> [first PC] [last PC]\n", argv[0]);
+        fprintf(stderr, "       %s --diff <trace> <trace>\n", argv[0]);
+        return 2;
+    }
+    uint16_t from = argc > 2 ? strtoul(argv[2], nullptr, 16) : 0x0000;
+    uint16_t to = argc > 3 ? strtoul(argv[3], nullptr, 16) : 0xFFFF;
+    return dump(argv[1], from, to);
+}